@@ -549,6 +549,10 @@ var (
 		mkField("ReloadModifiedDocuments", Bool, true,
 			"if true, a document will be reloaded automatically whenever it's changed "+
 				"(currently doesn't work for documents shown in the ebook UI)").setExpert().setVersion("2.5"),
+		mkField("MemoryMapLargeFiles", Bool, false,
+			"if true, large PDF documents are memory-mapped which makes loading them faster. "+
+				"Other programs can't replace or truncate such documents while they're open "+
+				"(e.g. when recompiling a LaTeX document)").setExpert().setVersion("3.3"),
 		mkField("FullPathInTitle", Bool, false,
 			"if true, we show the full path to a file in the title bar").setExpert().setVersion("3.0"),
 		//the below prefs don't apply to EbookUI (so far)
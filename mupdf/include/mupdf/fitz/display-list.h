@@ -117,4 +117,14 @@ fz_image *fz_new_image_from_display_list(fz_context *ctx, float w, float h, fz_d
 */
 int fz_display_list_is_empty(fz_context *ctx, const fz_display_list *list);
 
+/**
+	sumatrapdf: Estimate the memory used by a display list (not
+	counting shared resources like images and fonts).
+
+	list: The list to measure.
+
+	Returns the size in bytes.
+*/
+size_t fz_display_list_size(fz_context *ctx, const fz_display_list *list);
+
 #endif
@@ -374,6 +374,15 @@ void fz_filter_store(fz_context *ctx, fz_store_filter_fn *fn, void *arg, const f
 */
 void fz_debug_store(fz_context *ctx, fz_output *out);
 
+/**
+	Enable/disable looking up keys which can't be hashed only among
+	the items with the same type of value (enabled by default).
+	When disabled, such lookups walk through the whole store.
+
+	Affects all contexts sharing the store of ctx.
+*/
+void fz_set_store_partitions(fz_context *ctx, int enable);
+
 /**
 	Increment the defer reap count.
 
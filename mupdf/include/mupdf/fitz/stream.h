@@ -43,6 +43,18 @@ fz_stream *fz_open_file(fz_context *ctx, const char *filename);
 	to _wfopen().
 */
 fz_stream *fz_open_file_w(fz_context *ctx, const wchar_t *filename);
+
+/**
+	Open the named file as a stream reading directly from a read-only
+	memory mapping of the whole file, so that seeking is free and no
+	data is copied.
+
+	Falls back to fz_open_file_w if the file can't be mapped (e.g. if
+	there's not enough address space for it).
+
+	This function is only available when compiling for Win32.
+*/
+fz_stream *fz_open_file_mapped_w(fz_context *ctx, const wchar_t *filename);
 #endif /* _WIN32 */
 
 /**
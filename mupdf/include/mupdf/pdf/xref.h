@@ -139,6 +139,12 @@ int pdf_xref_obj_is_unsaved_signature(pdf_document *doc, pdf_obj *obj);
 void pdf_repair_xref(fz_context *ctx, pdf_document *doc);
 void pdf_repair_obj_stms(fz_context *ctx, pdf_document *doc);
 
+/*
+	Enable/disable keeping the decompressed content of object streams
+	in the store (enabled by default).
+*/
+void pdf_set_obj_stm_cache(int enable);
+
 /*
 	Ensure that the current populating xref has a single subsection
 	that covers the entire range.
@@ -1475,6 +1475,14 @@ int fz_display_list_is_empty(fz_context *ctx, const fz_display_list *list)
 	return !list || list->len == 0;
 }
 
+/* sumatrapdf: estimate memory used by a display list so that we can budget caching them */
+size_t fz_display_list_size(fz_context *ctx, const fz_display_list *list)
+{
+	if (!list)
+		return 0;
+	return sizeof(*list) + list->max * sizeof(fz_display_node);
+}
+
 void
 fz_run_display_list(fz_context *ctx, fz_display_list *list, fz_device *dev, fz_matrix top_ctm, fz_rect scissor, fz_cookie *cookie)
 {
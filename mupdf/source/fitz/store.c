@@ -12,10 +12,36 @@ typedef struct fz_item
 	size_t size;
 	struct fz_item *next;
 	struct fz_item *prev;
+	struct fz_item *pnext;
+	struct fz_item *pprev;
+	int part;
 	fz_store *store;
 	const fz_store_type *type;
 } fz_item;
 
+/* Every item in the store is also kept in one of STORE_PARTITIONS
+ * partitions, chosen by the type of its value (i.e. its drop function).
+ * Each partition has its own list ordered by usage, so that looking up
+ * a key which can't be hashed only walks the items which could possibly
+ * match instead of the whole store. */
+#define STORE_PARTITION_BITS 4
+#define STORE_PARTITIONS (1 << STORE_PARTITION_BITS)
+
+typedef struct
+{
+	fz_item *head;
+	fz_item *tail;
+	int len;
+	size_t size;
+} fz_store_partition;
+
+static int
+partition_for_drop(fz_store_drop_fn *drop)
+{
+	uint32_t h = (uint32_t)((uintptr_t)drop >> 4) * 2654435761U;
+	return (int)(h >> (32 - STORE_PARTITION_BITS));
+}
+
 /* Every entry in fz_store is protected by the alloc lock */
 struct fz_store
 {
@@ -30,6 +56,12 @@ struct fz_store
 	 * entries (those whose keys are indirect objects). */
 	fz_hash_table *hash;
 
+	/* The same items, partitioned by the type of their value. */
+	fz_store_partition parts[STORE_PARTITIONS];
+	/* Whether keys which can't be hashed are only looked up in
+	 * their partition (see fz_set_store_partitions). */
+	int use_partitions;
+
 	/* We keep track of the size of the store, and keep it below max. */
 	size_t max;
 	size_t size;
@@ -60,9 +92,50 @@ fz_new_store_context(fz_context *ctx, size_t max)
 	store->max = max;
 	store->defer_reap_count = 0;
 	store->needs_reaping = 0;
+	store->use_partitions = 1;
 	ctx->store = store;
 }
 
+void
+fz_set_store_partitions(fz_context *ctx, int enable)
+{
+	fz_store *store = ctx->store;
+
+	if (!store)
+		return;
+
+	fz_lock(ctx, FZ_LOCK_ALLOC);
+	store->use_partitions = enable;
+	fz_unlock(ctx, FZ_LOCK_ALLOC);
+}
+
+/* Unlink an item from the LRU list and from its partition. */
+static void
+unlink_item(fz_store *store, fz_item *item)
+{
+	fz_store_partition *part = &store->parts[item->part];
+
+	if (item->next)
+		item->next->prev = item->prev;
+	else
+		store->tail = item->prev;
+	if (item->prev)
+		item->prev->next = item->next;
+	else
+		store->head = item->next;
+
+	if (item->pnext)
+		item->pnext->pprev = item->pprev;
+	else
+		part->tail = item->pprev;
+	if (item->pprev)
+		item->pprev->pnext = item->pnext;
+	else
+		part->head = item->pnext;
+	part->len--;
+	part->size -= item->size;
+}
+
 void *
 fz_keep_storable(fz_context *ctx, const fz_storable *sc)
 {
@@ -112,15 +185,8 @@ do_reap(fz_context *ctx)
 		/* We have to drop it */
 		store->size -= item->size;
 
-		/* Unlink from the linked list */
-		if (item->next)
-			item->next->prev = item->prev;
-		else
-			store->tail = item->prev;
-		if (item->prev)
-			item->prev->next = item->next;
-		else
-			store->head = item->next;
+		/* Unlink from the linked lists */
+		unlink_item(store, item);
 
 		/* Remove from the hash table */
 		if (item->type->make_hash_key)
@@ -257,15 +323,8 @@ evict(fz_context *ctx, fz_item *item)
 	int drop;
 
 	store->size -= item->size;
-	/* Unlink from the linked list */
-	if (item->next)
-		item->next->prev = item->prev;
-	else
-		store->tail = item->prev;
-	if (item->prev)
-		item->prev->next = item->next;
-	else
-		store->head = item->next;
+	/* Unlink from the linked lists */
+	unlink_item(store, item);
 
 	/* Drop a reference to the value (freeing if required) */
 	if (item->val->refs > 0)
@@ -329,15 +388,8 @@ ensure_space(fz_context *ctx, size_t tofree)
 
 		store->size -= item->size;
 
-		/* Unlink from the linked list */
-		if (item->next)
-			item->next->prev = item->prev;
-		else
-			store->tail = item->prev;
-		if (item->prev)
-			item->prev->next = item->next;
-		else
-			store->head = item->next;
+		/* Unlink from the linked lists */
+		unlink_item(store, item);
 
 		/* Remove from the hash table */
 		if (item->type->make_hash_key)
@@ -389,17 +441,12 @@ ensure_space(fz_context *ctx, size_t tofree)
 static void
 touch(fz_store *store, fz_item *item)
 {
+	fz_store_partition *part = &store->parts[item->part];
+
 	if (item->next != item)
 	{
-		/* Already in the list - unlink it */
-		if (item->next)
-			item->next->prev = item->prev;
-		else
-			store->tail = item->prev;
-		if (item->prev)
-			item->prev->next = item->next;
-		else
-			store->head = item->next;
+		/* Already in the lists - unlink it */
+		unlink_item(store, item);
 	}
 	/* Now relink it at the start of the LRU chain */
 	item->next = store->head;
@@ -409,6 +456,17 @@ touch(fz_store *store, fz_item *item)
 		store->tail = item;
 	store->head = item;
 	item->prev = NULL;
+
+	/* And at the start of its partition's chain */
+	item->pnext = part->head;
+	if (item->pnext)
+		item->pnext->pprev = item;
+	else
+		part->tail = item;
+	part->head = item;
+	item->pprev = NULL;
+	part->len++;
+	part->size += item->size;
 }
 
 void *
@@ -451,6 +509,7 @@ fz_store_item(fz_context *ctx, void *key, void *val_, size_t itemsize, const fz_
 	item->size = itemsize;
 	item->next = item;
 	item->prev = item;
+	item->part = partition_for_drop(val->drop);
 	item->type = type;
 
 	/* If we can index it fast, put it into the hash table. This serves
@@ -577,6 +636,16 @@ fz_find_item(fz_context *ctx, fz_store_drop_fn *drop, void *key, const fz_store_
 		/* We can find objects keyed on indirected objects quickly */
 		item = fz_hash_find(ctx, store->hash, &hash);
 	}
+	else if (store->use_partitions)
+	{
+		/* Others we have to hunt for slowly, but only among the
+		 * items with the same type of value */
+		for (item = store->parts[partition_for_drop(drop)].head; item; item = item->pnext)
+		{
+			if (item->val->drop == drop && !type->cmp_key(ctx, item->key, key))
+				break;
+		}
+	}
 	else
 	{
 		/* Others we have to hunt for slowly */
@@ -632,8 +701,9 @@ fz_remove_item(fz_context *ctx, fz_store_drop_fn *drop, void *key, const fz_stor
 	}
 	else
 	{
-		/* Others we have to hunt for slowly */
-		for (item = store->head; item; item = item->next)
+		/* Others we have to hunt for slowly, but only among the
+		 * items with the same type of value */
+		for (item = store->parts[partition_for_drop(drop)].head; item; item = item->pnext)
 			if (item->val->drop == drop && !type->cmp_key(ctx, item->key, key))
 				break;
 	}
@@ -644,14 +714,8 @@ fz_remove_item(fz_context *ctx, fz_store_drop_fn *drop, void *key, const fz_stor
 		 * such items by setting item->next == item. */
 		if (item->next != item)
 		{
-			if (item->next)
-				item->next->prev = item->prev;
-			else
-				store->tail = item->prev;
-			if (item->prev)
-				item->prev->next = item->next;
-			else
-				store->head = item->next;
+			store->size -= item->size;
+			unlink_item(store, item);
 		}
 		if (item->val->refs > 0)
 			(void)Memento_dropRef(item->val);
@@ -727,6 +791,7 @@ fz_debug_store_locked(fz_context *ctx, fz_output *out)
 	char buf[256];
 	fz_store *store = ctx->store;
 	size_t list_total = 0;
+	int i;
 
 	fz_write_printf(ctx, out, "STORE\t-- resource store contents --\n");
 
@@ -751,6 +816,10 @@ fz_debug_store_locked(fz_context *ctx, fz_output *out)
 		}
 	}
 
+	fz_write_printf(ctx, out, "STORE\t-- resource store partitions --\n");
+	for (i = 0; i < STORE_PARTITIONS; i++)
+		fz_write_printf(ctx, out, "STORE\tpartition[%d] items=%d size=%zu\n", i, store->parts[i].len, store->parts[i].size);
+
 	fz_write_printf(ctx, out, "STORE\t-- resource store hash contents --\n");
 	fz_hash_for_each(ctx, store->hash, out, fz_debug_store_item);
 	fz_write_printf(ctx, out, "STORE\t-- end --\n");
@@ -1007,15 +1076,8 @@ void fz_filter_store(fz_context *ctx, fz_store_filter_fn *fn, void *arg, const f
 		/* We have to drop it */
 		store->size -= item->size;
 
-		/* Unlink from the linked list */
-		if (item->next)
-			item->next->prev = item->prev;
-		else
-			store->tail = item->prev;
-		if (item->prev)
-			item->prev->next = item->next;
-		else
-			store->head = item->next;
+		/* Unlink from the linked lists */
+		unlink_item(store, item);
 
 		/* Remove from the hash table */
 		if (item->type->make_hash_key)
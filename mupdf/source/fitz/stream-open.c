@@ -8,6 +8,9 @@
 #include <string.h>
 #include <errno.h>
 #include <stdio.h>
+#ifdef _WIN32
+#include <windows.h>
+#endif
 
 int
 fz_file_exists(fz_context *ctx, const char *path)
@@ -201,7 +204,7 @@ static void seek_buffer(fz_context *ctx, fz_stream *stm, int64_t offset, int whe
 		offset = 0;
 	if (offset > stm->pos)
 		offset = stm->pos;
-	stm->rp += (int)(offset - pos);
+	stm->rp += (ptrdiff_t)(offset - pos);
 }
 
 static void drop_buffer(fz_context *ctx, void *state_)
@@ -242,3 +245,71 @@ fz_open_memory(fz_context *ctx, const unsigned char *data, size_t len)
 
 	return stm;
 }
+
+#ifdef _WIN32
+/* Memory mapped file stream */
+
+typedef struct
+{
+	HANDLE file;
+	HANDLE mapping;
+	unsigned char *data;
+} fz_mapped_file_stream;
+
+static void drop_mapped_file(fz_context *ctx, void *state_)
+{
+	fz_mapped_file_stream *state = state_;
+	UnmapViewOfFile(state->data);
+	CloseHandle(state->mapping);
+	CloseHandle(state->file);
+	fz_free(ctx, state);
+}
+
+fz_stream *
+fz_open_file_mapped_w(fz_context *ctx, const wchar_t *name)
+{
+	fz_mapped_file_stream *state = NULL;
+	fz_stream *stm;
+	HANDLE file, mapping = NULL;
+	unsigned char *data = NULL;
+	LARGE_INTEGER size;
+
+	file = CreateFileW(name, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file != INVALID_HANDLE_VALUE && GetFileSizeEx(file, &size) && size.QuadPart > 0 && (uint64_t)size.QuadPart <= SIZE_MAX)
+		mapping = CreateFileMappingW(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (mapping)
+		data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if (!data)
+	{
+		/* e.g. there's not enough contiguous address space for the whole file */
+		if (mapping)
+			CloseHandle(mapping);
+		if (file != INVALID_HANDLE_VALUE)
+			CloseHandle(file);
+		return fz_open_file_w(ctx, name);
+	}
+
+	fz_try(ctx)
+		state = fz_malloc_struct(ctx, fz_mapped_file_stream);
+	fz_catch(ctx)
+	{
+		UnmapViewOfFile(data);
+		CloseHandle(mapping);
+		CloseHandle(file);
+		fz_rethrow(ctx);
+	}
+	state->file = file;
+	state->mapping = mapping;
+	state->data = data;
+
+	stm = fz_new_stream(ctx, state, next_buffer, drop_mapped_file);
+	stm->seek = seek_buffer;
+
+	stm->rp = data;
+	stm->wp = data + size.QuadPart;
+
+	stm->pos = (int64_t)size.QuadPart;
+
+	return stm;
+}
+#endif
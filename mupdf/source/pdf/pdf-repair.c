@@ -14,6 +14,45 @@ struct entry
 	int stm_len;
 };
 
+/* Advance file to just after the next "endstream" keyword (or to EOF).
+ * Streams are searched block by block with memchr instead of byte by
+ * byte so that repairing files with large image streams and indirect
+ * (or wrong) stream lengths doesn't take forever. */
+static void skip_to_endstream(fz_context *ctx, fz_stream *file, pdf_lexbuf *buf)
+{
+	unsigned char *p;
+	int64_t ofs;
+
+	while (fz_available(ctx, file, 64 << 10) > 0)
+	{
+		p = memchr(file->rp, 'e', file->wp - file->rp);
+		if (!p)
+		{
+			file->rp = file->wp;
+			continue;
+		}
+		if (file->wp - p >= 9)
+		{
+			file->rp = p + 1;
+			if (memcmp(p, "endstream", 9) == 0)
+			{
+				file->rp = p + 9;
+				return;
+			}
+			continue;
+		}
+
+		/* the candidate crosses the end of the buffered block */
+		file->rp = p;
+		ofs = fz_tell(ctx, file);
+		if (fz_read(ctx, file, (unsigned char *)buf->scratch, 9) < 9)
+			return;
+		if (memcmp(buf->scratch, "endstream", 9) == 0)
+			return;
+		fz_seek(ctx, file, ofs + 1, SEEK_SET);
+	}
+}
+
 static void add_root(fz_context *ctx, pdf_obj *obj, pdf_obj ***roots, int *num_roots, int *max_roots)
 {
 	if (*num_roots == *max_roots)
@@ -159,16 +198,7 @@ pdf_repair_obj(fz_context *ctx, pdf_document *doc, pdf_lexbuf *buf, int64_t *stm
 			fz_seek(ctx, file, *stmofsp, 0);
 		}
 
-		(void)fz_read(ctx, file, (unsigned char *) buf->scratch, 9);
-
-		while (memcmp(buf->scratch, "endstream", 9) != 0)
-		{
-			c = fz_read_byte(ctx, file);
-			if (c == EOF)
-				break;
-			memmove(&buf->scratch[0], &buf->scratch[1], 8);
-			buf->scratch[8] = c;
-		}
+		skip_to_endstream(ctx, file, buf);
 
 		if (stmlenp)
 			*stmlenp = fz_tell(ctx, file) - *stmofsp - 9;
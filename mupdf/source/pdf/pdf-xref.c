@@ -1631,27 +1631,78 @@ pdf_keep_document(fz_context *ctx, pdf_document *doc)
  * compressed object streams
  */
 
-static pdf_xref_entry *
-pdf_load_obj_stm(fz_context *ctx, pdf_document *doc, int num, pdf_lexbuf *buf, int target)
+/*
+	The decompressed content of an object stream together with the
+	object numbers and offsets from its header. These are kept in the
+	store (keyed by the object stream's reference) so that objects
+	that are dropped from the xref again (see pdf_clear_xref_to_mark)
+	can be re-parsed without inflating and lexing the stream again.
+*/
+typedef struct
 {
-	fz_stream *stm = NULL;
+	fz_storable storable;
+	fz_buffer *buf;
+	int64_t first;
+	int count;
+	int *numbuf;
+	int64_t *ofsbuf;
+} pdf_obj_stm;
+
+static int pdf_obj_stm_cache_enabled = 1;
+
+void
+pdf_set_obj_stm_cache(int enable)
+{
+	pdf_obj_stm_cache_enabled = enable;
+}
+
+static void
+pdf_drop_obj_stm_imp(fz_context *ctx, fz_storable *stm_)
+{
+	pdf_obj_stm *stm = (pdf_obj_stm *)stm_;
+
+	fz_drop_buffer(ctx, stm->buf);
+	fz_free(ctx, stm->numbuf);
+	fz_free(ctx, stm->ofsbuf);
+	fz_free(ctx, stm);
+}
+
+static void
+pdf_drop_obj_stm(fz_context *ctx, pdf_obj_stm *stm)
+{
+	fz_drop_storable(ctx, &stm->storable);
+}
+
+static pdf_obj_stm *
+pdf_load_obj_stm_data(fz_context *ctx, pdf_document *doc, int num, pdf_lexbuf *buf)
+{
+	pdf_obj_stm *stm = NULL;
 	pdf_obj *objstm = NULL;
-	int *numbuf = NULL;
-	int64_t *ofsbuf = NULL;
+	pdf_obj *ref = NULL;
+	fz_stream *file = NULL;
 
-	pdf_obj *obj;
 	int64_t first;
 	int count;
 	int i;
 	pdf_token tok;
-	pdf_xref_entry *ret_entry = NULL;
 	int xref_len;
 	int found;
 
-	fz_var(numbuf);
-	fz_var(ofsbuf);
-	fz_var(objstm);
 	fz_var(stm);
+	fz_var(objstm);
+	fz_var(ref);
+	fz_var(file);
+
+	if (pdf_obj_stm_cache_enabled)
+	{
+		ref = pdf_new_indirect(ctx, doc, num, 0);
+		stm = pdf_find_item(ctx, pdf_drop_obj_stm_imp, ref);
+		if (stm)
+		{
+			pdf_drop_obj(ctx, ref);
+			return stm;
+		}
+	}
 
 	fz_try(ctx)
 	{
@@ -1663,6 +1714,7 @@ pdf_load_obj_stm(fz_context *ctx, pdf_document *doc, int num, pdf_lexbuf *buf, i
 	fz_catch(ctx)
 	{
 		pdf_drop_obj(ctx, objstm);
+		pdf_drop_obj(ctx, ref);
 		fz_rethrow(ctx);
 	}
 
@@ -1680,43 +1732,103 @@ pdf_load_obj_stm(fz_context *ctx, pdf_document *doc, int num, pdf_lexbuf *buf, i
 				|| first + count - 1 > PDF_MAX_OBJECT_NUMBER)
 			fz_throw(ctx, FZ_ERROR_GENERIC, "object stream object numbers are out of range");
 
-		numbuf = fz_calloc(ctx, count, sizeof(*numbuf));
-		ofsbuf = fz_calloc(ctx, count, sizeof(*ofsbuf));
+		stm = fz_malloc_struct(ctx, pdf_obj_stm);
+		FZ_INIT_STORABLE(stm, 1, pdf_drop_obj_stm_imp);
+		stm->first = first;
+		stm->numbuf = fz_calloc(ctx, count, sizeof(*stm->numbuf));
+		stm->ofsbuf = fz_calloc(ctx, count, sizeof(*stm->ofsbuf));
+		stm->buf = pdf_load_stream_number(ctx, doc, num);
 
 		xref_len = pdf_xref_len(ctx, doc);
 
 		found = 0;
 
-		stm = pdf_open_stream_number(ctx, doc, num);
+		file = fz_open_buffer(ctx, stm->buf);
 		for (i = 0; i < count; i++)
 		{
-			tok = pdf_lex(ctx, stm, buf);
+			tok = pdf_lex(ctx, file, buf);
 			if (tok != PDF_TOK_INT)
 				fz_throw(ctx, FZ_ERROR_GENERIC, "corrupt object stream (%d 0 R)", num);
-			numbuf[found] = buf->i;
+			stm->numbuf[found] = buf->i;
 
-			tok = pdf_lex(ctx, stm, buf);
+			tok = pdf_lex(ctx, file, buf);
 			if (tok != PDF_TOK_INT)
 				fz_throw(ctx, FZ_ERROR_GENERIC, "corrupt object stream (%d 0 R)", num);
-			ofsbuf[found] = buf->i;
+			stm->ofsbuf[found] = buf->i;
 
-			if (numbuf[found] <= 0 || numbuf[found] >= xref_len)
+			if (stm->numbuf[found] <= 0 || stm->numbuf[found] >= xref_len)
 				fz_warn(ctx, "object stream object out of range, skipping");
 			else
 				found++;
 		}
+		stm->count = found;
+
+		if (ref)
+			pdf_store_item(ctx, ref, stm, sizeof(*stm) + fz_buffer_storage(ctx, stm->buf, NULL) + count * (sizeof(*stm->numbuf) + sizeof(*stm->ofsbuf)));
+	}
+	fz_always(ctx)
+	{
+		fz_drop_stream(ctx, file);
+		pdf_unmark_obj(ctx, objstm);
+		pdf_drop_obj(ctx, objstm);
+		pdf_drop_obj(ctx, ref);
+	}
+	fz_catch(ctx)
+	{
+		if (stm)
+			pdf_drop_obj_stm(ctx, stm);
+		fz_rethrow(ctx);
+	}
+
+	return stm;
+}
+
+static pdf_xref_entry *
+pdf_load_obj_stm(fz_context *ctx, pdf_document *doc, int num, pdf_lexbuf *buf, int target)
+{
+	pdf_obj_stm *objstm;
+	fz_stream *stm = NULL;
+
+	pdf_obj *obj;
+	int i;
+	pdf_xref_entry *ret_entry = NULL;
+	int xref_len;
+
+	fz_var(stm);
+
+	objstm = pdf_load_obj_stm_data(ctx, doc, num, buf);
 
-		for (i = 0; i < found; i++)
+	fz_try(ctx)
+	{
+		stm = fz_open_buffer(ctx, objstm->buf);
+		xref_len = pdf_xref_len(ctx, doc);
+
+		for (i = 0; i < objstm->count; i++)
 		{
 			pdf_xref_entry *entry;
 
-			fz_seek(ctx, stm, first + ofsbuf[i], SEEK_SET);
+			if (objstm->numbuf[i] >= xref_len)
+				continue;
+
+			entry = pdf_get_xref_entry(ctx, doc, objstm->numbuf[i]);
+
+			/* Objects that are still in the xref (e.g. when re-loading
+			 * an object stream after pdf_clear_xref_to_mark) don't need
+			 * to be parsed again. */
+			if (entry->type == 'o' && entry->ofs == num && entry->obj)
+			{
+				if (objstm->numbuf[i] == target)
+					ret_entry = entry;
+				continue;
+			}
+
+			fz_seek(ctx, stm, objstm->first + objstm->ofsbuf[i], SEEK_SET);
 
 			obj = pdf_parse_stm_obj(ctx, doc, stm, buf);
 
-			entry = pdf_get_xref_entry(ctx, doc, numbuf[i]);
+			entry = pdf_get_xref_entry(ctx, doc, objstm->numbuf[i]);
 
-			pdf_set_obj_parent(ctx, obj, numbuf[i]);
+			pdf_set_obj_parent(ctx, obj, objstm->numbuf[i]);
 
 			if (entry->type == 'o' && entry->ofs == num)
 			{
@@ -1729,7 +1841,7 @@ pdf_load_obj_stm(fz_context *ctx, pdf_document *doc, int num, pdf_lexbuf *buf, i
 				if (entry->obj)
 				{
 					if (pdf_objcmp(ctx, entry->obj, obj))
-						fz_warn(ctx, "Encountered new definition for object %d - keeping the original one", numbuf[i]);
+						fz_warn(ctx, "Encountered new definition for object %d - keeping the original one", objstm->numbuf[i]);
 					pdf_drop_obj(ctx, obj);
 				}
 				else
@@ -1738,7 +1850,7 @@ pdf_load_obj_stm(fz_context *ctx, pdf_document *doc, int num, pdf_lexbuf *buf, i
 					fz_drop_buffer(ctx, entry->stm_buf);
 					entry->stm_buf = NULL;
 				}
-				if (numbuf[i] == target)
+				if (objstm->numbuf[i] == target)
 					ret_entry = entry;
 			}
 			else
@@ -1750,10 +1862,7 @@ pdf_load_obj_stm(fz_context *ctx, pdf_document *doc, int num, pdf_lexbuf *buf, i
 	fz_always(ctx)
 	{
 		fz_drop_stream(ctx, stm);
-		fz_free(ctx, ofsbuf);
-		fz_free(ctx, numbuf);
-		pdf_unmark_obj(ctx, objstm);
-		pdf_drop_obj(ctx, objstm);
+		pdf_drop_obj_stm(ctx, objstm);
 	}
 	fz_catch(ctx)
 	{
@@ -452,6 +452,7 @@ function sumatrapdf_files()
     "TableOfContents.*",
     "Tabs.*",
     "Tester.*",
+    "TextIndex.*",
     "TextSearch.*",
     "TextSelection.*",
     "Theme.*",
@@ -503,6 +504,7 @@ function utils_files()
     "GuessFileType.*",
     "FileUtil.*",
     "FileWatcher.*",
+    "FindSubstring.*",
     "FzImgReader.*",
     "GdiPlusUtil.*",
     "HtmlWindow.*",
@@ -889,6 +891,7 @@ function test_util_files()
     "Dict.*",
     "Dpi.*",
     "FileUtil.*",
+    "FindSubstring.*",
     "GeomUtil.*",
     "HtmlParserLookup.*",
     "HtmlPrettyPrint.*",
@@ -929,6 +932,9 @@ function engine_dump_files()
   files_in_dir("src", {
     "EngineDump.cpp",
     "SumatraConfig.*",
+    "TextIndex.*",
+    "TextSearch.*",
+    "TextSelection.*",
     "mui/MiniMui.*",
     "mui/TextRender.*"
   })
@@ -950,6 +956,7 @@ function pdf_preview_files()
     "EngineBase.*",
     "EngineFzUtil.*",
     "EnginePdf.*",
+    "EnginePdfCache.*",
     "EngineXps.*",
     "ChmDoc.*",
     "EbookDoc.*",
@@ -979,6 +986,7 @@ function pdf_filter_files()
     "EngineBase.*",
     "EngineFzUtil.*",
     "EnginePdf.*",
+    "EnginePdfCache.*",
     "EngineXps.*"
   })
 
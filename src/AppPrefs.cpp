@@ -12,6 +12,7 @@
 #include "Annotation.h"
 #include "EngineBase.h"
 #include "EngineEbook.h"
+#include "EnginePdf.h"
 
 #include "SumatraConfig.h"
 #include "DisplayMode.h"
@@ -129,6 +130,7 @@ bool Load() {
     // TODO: verify that all states have a non-nullptr file path?
     gFileHistory.UpdateStatesSource(gprefs->fileStates);
     SetDefaultEbookFont(gprefs->ebookUI.fontName, gprefs->ebookUI.fontSize);
+    SetMapLargeFiles(gprefs->memoryMapLargeFiles);
 
     if (!file::Exists(path.Get())) {
         Save();
@@ -24,6 +24,12 @@ struct ControllerCallback {
     virtual void RequestRendering(int pageNo) = 0;
     virtual void CleanUp(DisplayModel* dm) = 0;
     virtual void RenderThumbnail(DisplayModel* dm, Size size, const onBitmapRenderedCb&) = 0;
+    // tell the UI that the sizes of pages startPageNo to endPageNo have been
+    // determined (called from a background thread, see EngineBase::LoadMediaboxesAsync)
+    virtual void PageSizesChanged(DisplayModel* dm, int startPageNo, int endPageNo) = 0;
+    // tell the UI that all pages have been laid out and thus the page count is
+    // final (called from a background thread, see EngineBase::LayoutPagesAsync)
+    virtual void PagesLaidOut(DisplayModel* dm) = 0;
     // ChmModel //
     // tell the UI to move focus back to the main window
     // (if always == false, then focus is only moved if it's inside
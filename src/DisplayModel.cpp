@@ -338,6 +338,16 @@ PageInfo* DisplayModel::GetPageInfo(int pageNo) const {
     return &(pagesInfo[pageNo - 1]);
 }
 
+Rect DisplayModel::PageOnScreen(int pageNo) const {
+    PageInfo* pageInfo = GetPageInfo(pageNo);
+    if (!pageInfo) {
+        return Rect();
+    }
+    Rect r = pageInfo->pos;
+    r.Offset(-visibleOffset.x, -visibleOffset.y);
+    return r;
+}
+
 // Call this before the first Relayout
 void DisplayModel::SetInitialViewSettings(DisplayMode newDisplayMode, int newStartPage, Size viewPort, int screenDPI) {
     totalViewPortSize = viewPort;
@@ -373,13 +383,29 @@ void DisplayModel::SetInitialViewSettings(DisplayMode newDisplayMode, int newSta
     }
     displayR2L = (layout & Layout_R2L) != 0;
     BuildPagesInfo();
+
+    // for documents with many pages, some page sizes are only estimated
+    // at first and get corrected as they're determined in the background
+    engine->LoadMediaboxesAsync([this](int startPageNo, int endPageNo) {
+        // called on a background thread
+        cb->PageSizesChanged(this, startPageNo, endPageNo);
+    });
+    // similarly, the page count might only be estimated at first
+    engine->LayoutPagesAsync([this] {
+        // called on a background thread
+        cb->PagesLaidOut(this);
+    });
 }
 
 void DisplayModel::BuildPagesInfo() {
     CrashIf(pagesInfo);
-    int pageCount = PageCount();
-    pagesInfo = AllocArray<PageInfo>(pageCount);
+    pagesInfo = AllocArray<PageInfo>(PageCount());
+    InitPagesInfo(1);
+}
 
+// initializes the PageInfo of pages startPageNo to PageCount()
+void DisplayModel::InitPagesInfo(int startPageNo) {
+    int pageCount = PageCount();
     RectF defaultRect;
     float fileDPI = engine->GetFileDPI();
     if (0 == GetMeasurementSystem()) {
@@ -394,9 +420,9 @@ void DisplayModel::BuildPagesInfo() {
         newStartPage--;
     }
 
-    for (int pageNo = 1; pageNo <= pageCount; pageNo++) {
+    for (int pageNo = startPageNo; pageNo <= pageCount; pageNo++) {
         PageInfo* pageInfo = GetPageInfo(pageNo);
-        pageInfo->page = engine->PageMediabox(pageNo);
+        pageInfo->page = engine->PageMediaboxEstimate(pageNo);
         // layout pages with an empty mediabox as A4 size (resp. letter size)
         if (pageInfo->page.IsEmpty()) {
             pageInfo->page = defaultRect;
@@ -411,6 +437,166 @@ void DisplayModel::BuildPagesInfo() {
     }
 }
 
+// updates the sizes of pages startPageNo to endPageNo after the
+// engine has determined them (see SetInitialViewSettings)
+void DisplayModel::UpdatePageSizes(int startPageNo, int endPageNo) {
+    bool changed = false;
+    for (int pageNo = startPageNo; pageNo <= endPageNo; pageNo++) {
+        PageInfo* pageInfo = GetPageInfo(pageNo);
+        RectF mediabox = engine->PageMediaboxEstimate(pageNo);
+        if (!pageInfo || mediabox.IsEmpty() || mediabox == pageInfo->page) {
+            continue;
+        }
+        pageInfo->page = mediabox;
+        changed = true;
+    }
+    if (!changed) {
+        return;
+    }
+
+    ScrollState ss = GetScrollState();
+    if (!RelayoutPages(startPageNo, endPageNo)) {
+        Relayout(zoomVirtual, rotation);
+    }
+    SetScrollState(ss);
+}
+
+// returns the index of the row containing pageNo
+static int FindRowOfPage(Vec<PageRow>& rows, int pageNo) {
+    int lo = 0;
+    int hi = rows.isize() - 1;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (rows.at(mid).lastPageNo < pageNo) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+/* lays out the rows containing pages startPageNo to endPageNo again after
+   their sizes have changed and moves the rows below accordingly. Returns false
+   if a full Relayout() is needed instead, because the zoom level, the column
+   widths or the need for scroll bars might change.
+   Column widths only ever grow here, they shrink again on the next Relayout() */
+bool DisplayModel::RelayoutPages(int startPageNo, int endPageNo) {
+    DisplayMode mode = GetDisplayMode();
+    if (!IsContinuous(mode) || ZOOM_FIT_CONTENT == zoomVirtual || pageRows.size() == 0) {
+        return false;
+    }
+    // pages not filling the view port are centered vertically
+    if (canvasSize.dy <= viewPort.dy) {
+        return false;
+    }
+
+    int firstRow = FindRowOfPage(pageRows, startPageNo);
+    int lastRow = FindRowOfPage(pageRows, endPageNo);
+    bool isFitZoom = ZOOM_FIT_WIDTH == zoomVirtual || ZOOM_FIT_PAGE == zoomVirtual;
+    Vec<Rect> newPos;
+    Vec<float> newZoom;
+    int dyChange = 0;
+    for (int rowIdx = firstRow; rowIdx <= lastRow; rowIdx++) {
+        PageRow& row = pageRows.at(rowIdx);
+        int rowDy = 0;
+        for (int pageNo = row.firstPageNo; pageNo <= row.lastPageNo; pageNo++) {
+            float zoom = GetZoomReal(pageNo);
+            if (isFitZoom) {
+                zoom = ZoomRealFromVirtualForPage(zoomVirtual, pageNo);
+                // zoomReal is the smallest zoom level of all pages
+                if (zoom < zoomReal) {
+                    return false;
+                }
+            }
+            int column = pageNo - row.firstPageNo;
+            if (IsBookView(mode) && row.firstPageNo == 1) {
+                column++;
+            }
+            SizeF pageSize = PageSizeAfterRotation(pageNo);
+            Rect pos;
+            // don't add the full 0.5 for rounding to account for precision errors
+            pos.dx = (int)(pageSize.dx * zoom + 0.499);
+            pos.dy = (int)(pageSize.dy * zoom + 0.499);
+            if (column >= dimof(layoutColumnDx) || pos.dx > layoutColumnDx[column]) {
+                return false;
+            }
+            rowDy = std::max(rowDy, pos.dy);
+            newPos.Append(pos);
+            newZoom.Append(zoom);
+        }
+        dyChange += rowDy - row.dy;
+    }
+    if (canvasSize.dy + dyChange <= viewPort.dy) {
+        return false;
+    }
+
+    int currPosY = pageRows.at(firstRow).y;
+    int idx = 0;
+    for (int rowIdx = firstRow; rowIdx <= lastRow; rowIdx++) {
+        PageRow& row = pageRows.at(rowIdx);
+        row.y = currPosY;
+        row.dy = 0;
+        for (int pageNo = row.firstPageNo; pageNo <= row.lastPageNo; pageNo++) {
+            int column = pageNo - row.firstPageNo;
+            if (IsBookView(mode) && row.firstPageNo == 1) {
+                column++;
+            }
+            PageInfo* pageInfo = GetPageInfo(pageNo);
+            pageInfo->zoomReal = newZoom.at(idx);
+            Rect pos = newPos.at(idx++);
+            pos.x = PagePosX(pageNo, column, pos.dx);
+            pos.y = currPosY;
+            pageInfo->pos = pos;
+            row.dy = std::max(row.dy, pos.dy);
+        }
+        currPosY += row.dy + pageSpacing.dy;
+    }
+    for (int rowIdx = lastRow + 1; rowIdx < pageRows.isize(); rowIdx++) {
+        PageRow& row = pageRows.at(rowIdx);
+        row.y += dyChange;
+        for (int pageNo = row.firstPageNo; pageNo <= row.lastPageNo; pageNo++) {
+            GetPageInfo(pageNo)->pos.y += dyChange;
+        }
+    }
+    canvasSize.dy += dyChange;
+    return true;
+}
+
+// adjusts the pages to the actual page count after the engine has laid
+// out all pages (see SetInitialViewSettings). Rendering for this
+// DisplayModel must have been cancelled before (cf. ControllerCallback::PagesLaidOut)
+void DisplayModel::UpdatePageCount() {
+    int prevPageCount = PageCount();
+    ScrollState ss = GetScrollState();
+    // text extraction must not continue with the estimated page count
+    textCache->StopExtraction();
+    if (!engine->UpdatePageCount()) {
+        return;
+    }
+    textCache->UpdatePageCount();
+    textSelection->Reset();
+    textSearch->UpdatePageCount();
+
+    int pageCount = PageCount();
+    PageInfo* newPagesInfo = AllocArray<PageInfo>(pageCount);
+    memcpy(newPagesInfo, pagesInfo, std::min(prevPageCount, pageCount) * sizeof(PageInfo));
+    free(pagesInfo);
+    pagesInfo = newPagesInfo;
+    if (pageCount > prevPageCount) {
+        InitPagesInfo(prevPageCount + 1);
+    }
+    if (!ValidPageNo(startPage)) {
+        startPage = pageCount;
+    }
+    if (!ValidPageNo(ss.page)) {
+        ss = ScrollState(pageCount, -1, -1);
+    }
+
+    Relayout(zoomVirtual, rotation);
+    SetScrollState(ss);
+}
+
 // TODO: a better name e.g. ShouldShow() to better distinguish between
 // before-layout info and after-layout visibility checks
 bool DisplayModel::PageShown(int pageNo) const {
@@ -540,9 +726,26 @@ int DisplayModel::FirstVisiblePageNo() const {
         return INVALID_PAGE_NO;
     }
 
-    for (int pageNo = 1; pageNo <= PageCount(); ++pageNo) {
+    for (int pageNo = visibleFirstPageNo; pageNo <= visibleLastPageNo; ++pageNo) {
         PageInfo* pageInfo = GetPageInfo(pageNo);
-        if (pageInfo->visibleRatio > 0.0) {
+        if (pageInfo && pageInfo->visibleRatio > 0.0) {
+            return pageNo;
+        }
+    }
+
+    /* If no pages are visible */
+    return INVALID_PAGE_NO;
+}
+
+int DisplayModel::LastVisiblePageNo() const {
+    CrashIf(!pagesInfo);
+    if (!pagesInfo) {
+        return INVALID_PAGE_NO;
+    }
+
+    for (int pageNo = visibleLastPageNo; pageNo >= visibleFirstPageNo; --pageNo) {
+        PageInfo* pageInfo = GetPageInfo(pageNo);
+        if (pageInfo && pageInfo->visibleRatio > 0.0) {
             return pageNo;
         }
     }
@@ -566,9 +769,9 @@ int DisplayModel::CurrentPageNo() const {
     int mostVisiblePage = INVALID_PAGE_NO;
     float ratio = 0;
 
-    for (int pageNo = 1; pageNo <= PageCount(); pageNo++) {
+    for (int pageNo = visibleFirstPageNo; pageNo <= visibleLastPageNo; pageNo++) {
         PageInfo* pageInfo = GetPageInfo(pageNo);
-        if (pageInfo->visibleRatio > ratio) {
+        if (pageInfo && pageInfo->visibleRatio > ratio) {
             mostVisiblePage = pageNo;
             ratio = pageInfo->visibleRatio;
         }
@@ -649,6 +852,35 @@ float DisplayModel::GetZoomReal(int pageNo) const {
     return std::min(zoomCurr, zoomNext);
 }
 
+/* x position of a page of width dx in the given column of a row
+   for the horizontal layout calculated in the last Relayout() */
+int DisplayModel::PagePosX(int pageNo, int column, int dx) const {
+    DisplayMode mode = GetDisplayMode();
+    int columns = ColumnsFromDisplayMode(mode);
+    int pageOffX = layoutOffX + windowMargin.left;
+    if (column > 0) {
+        pageOffX += layoutColumnDx[0] + pageSpacing.dx;
+    }
+    int x;
+    // center pages in a single column but right/left align them when using two columns
+    if (1 == columns) {
+        x = pageOffX + (layoutColumnDx[0] - dx) / 2;
+    } else if (0 == column) {
+        x = pageOffX + layoutColumnDx[0] - dx;
+    } else {
+        x = pageOffX;
+    }
+    // center the cover page over the first two spots in non-continuous mode
+    if (IsBookView(mode) && pageNo == 1 && !IsContinuous(mode)) {
+        x = layoutOffX + windowMargin.left + (layoutColumnDx[0] + pageSpacing.dx + layoutColumnDx[1] - dx) / 2;
+    }
+    // mirror the page layout when displaying a Right-to-Left document
+    if (displayR2L && columns > 1) {
+        x = layoutCanvasDx - x - dx;
+    }
+    return x;
+}
+
 /* Given zoom and rotation, calculate the position of each page on a
    large sheet that is continous view. Needs to be recalculated when:
      * zoom changes
@@ -668,6 +900,7 @@ void DisplayModel::Relayout(float newZoomVirtual, int newRotation) {
     viewPort = Rect(viewPort.TL(), totalViewPortSize);
 
 RestartLayout:
+    pageRows.Reset();
     int currPosY = windowMargin.top;
     float currZoomReal = zoomReal;
     CalcZoomReal(newZoomVirtual);
@@ -701,6 +934,12 @@ RestartLayout:
             rowMaxPageDy = pos.dy;
         }
         pos.y = currPosY;
+        if (0 == pageInARow) {
+            PageRow row;
+            row.firstPageNo = pageNo;
+            row.y = currPosY;
+            pageRows.Append(row);
+        }
 
         // restart the layout if we detect we need to show scrollbars, skip if
         //   scrollbars are being hidden or if `needVScroll` has already been
@@ -731,6 +970,9 @@ RestartLayout:
         }
 
         pageInfo->pos = pos;
+        PageRow& row = pageRows.Last();
+        row.lastPageNo = pageNo;
+        row.dy = rowMaxPageDy;
 
         pageInARow++;
         CrashIf(pageInARow > columns);
@@ -783,8 +1025,11 @@ RestartLayout:
     }
 
     CrashIf(offX < 0);
+    layoutColumnDx[0] = columnMaxWidth[0];
+    layoutColumnDx[1] = columnMaxWidth[1];
+    layoutOffX = offX;
+    layoutCanvasDx = canvasDx;
     pageInARow = 0;
-    int pageOffX = offX + windowMargin.left;
     for (int pageNo = 1; pageNo <= PageCount(); ++pageNo) {
         PageInfo* pageInfo = GetPageInfo(pageNo);
         if (!pageInfo->shown) {
@@ -793,36 +1038,14 @@ RestartLayout:
         }
         // leave first spot empty in cover page mode
         if (IsBookView(GetDisplayMode()) && pageNo == 1) {
-            CrashIf(pageInARow >= dimof(columnMaxWidth));
-            pageOffX += columnMaxWidth[pageInARow] + pageSpacing.dx;
             ++pageInARow;
         }
         CrashIf(pageInARow >= dimof(columnMaxWidth));
-        // center pages in a single column but right/left align them when using two columns
-        if (1 == columns) {
-            pageInfo->pos.x = pageOffX + (columnMaxWidth[0] - pageInfo->pos.dx) / 2;
-        } else if (0 == pageInARow) {
-            pageInfo->pos.x = pageOffX + columnMaxWidth[0] - pageInfo->pos.dx;
-        } else {
-            pageInfo->pos.x = pageOffX;
-        }
-        // center the cover page over the first two spots in non-continuous mode
-        if (IsBookView(GetDisplayMode()) && pageNo == 1 && !IsContinuous(GetDisplayMode())) {
-            pageInfo->pos.x = offX + windowMargin.left +
-                              (columnMaxWidth[0] + pageSpacing.dx + columnMaxWidth[1] - pageInfo->pos.dx) / 2;
-        }
-        // mirror the page layout when displaying a Right-to-Left document
-        if (displayR2L && columns > 1) {
-            pageInfo->pos.x = canvasDx - pageInfo->pos.x - pageInfo->pos.dx;
-        }
+        pageInfo->pos.x = PagePosX(pageNo, pageInARow, pageInfo->pos.dx);
+        CrashIf(pageInfo->pos.x < 0);
 
-        CrashIf(pageInARow >= dimof(columnMaxWidth));
-        pageOffX += columnMaxWidth[pageInARow] + pageSpacing.dx;
         ++pageInARow;
-        CrashIf(!(pageOffX >= 0 && pageInfo->pos.x >= 0));
-
         if (pageInARow == columns) {
-            pageOffX = offX + windowMargin.left;
             pageInARow = 0;
         }
     }
@@ -845,6 +1068,9 @@ RestartLayout:
             }
             pageInfo->pos.y += offY;
         }
+        for (PageRow& row : pageRows) {
+            row.y += offY;
+        }
     }
 
     canvasSize = Size(std::max(canvasDx, viewPort.dx), std::max(canvasDy, viewPort.dy));
@@ -874,34 +1100,74 @@ void DisplayModel::ChangeStartPage(int newStartPage) {
     Relayout(zoomVirtual, rotation);
 }
 
+/* Returns the index of the first row of pages which ends below y
+   (resp. pageRows.size() if there's none) */
+int DisplayModel::FindPageRow(int y) const {
+    int lo = 0;
+    int hi = (int)pageRows.size();
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        PageRow& row = pageRows.at(mid);
+        if (row.y + row.dy <= y) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+void DisplayModel::ResetVisibleParts() {
+    for (int pageNo = visibleFirstPageNo; pageNo <= visibleLastPageNo; ++pageNo) {
+        PageInfo* pageInfo = GetPageInfo(pageNo);
+        if (pageInfo) {
+            pageInfo->visibleRatio = 0.0;
+        }
+    }
+    visibleFirstPageNo = 0;
+    visibleLastPageNo = 0;
+}
+
 /* Given positions of each page in a large sheet that is continous view and
    coordinates of a current view into that large sheet, calculate which
    parts of each page is visible on the screen.
-   Needs to be recalucated after scrolling the view. */
+   Needs to be recalucated after scrolling the view.
+   Only the rows of pages overlapping the view port are looked at. */
 void DisplayModel::RecalcVisibleParts() {
     CrashIf(!pagesInfo);
     if (!pagesInfo) {
         return;
     }
 
-    for (int pageNo = 1; pageNo <= PageCount(); ++pageNo) {
-        PageInfo* pageInfo = GetPageInfo(pageNo);
-        if (!pageInfo->shown) {
-            CrashIf(0.0 != pageInfo->visibleRatio);
-            continue;
-        }
+    ResetVisibleParts();
+    visibleOffset = viewPort.TL();
+    visiblePartsVersion++;
 
-        Rect pageRect = pageInfo->pos;
-        Rect visiblePart = pageRect.Intersect(viewPort);
+    for (int rowIdx = FindPageRow(viewPort.y); rowIdx < (int)pageRows.size(); rowIdx++) {
+        PageRow& row = pageRows.at(rowIdx);
+        if (row.y >= viewPort.y + viewPort.dy) {
+            break;
+        }
+        for (int pageNo = row.firstPageNo; pageNo <= row.lastPageNo; ++pageNo) {
+            PageInfo* pageInfo = GetPageInfo(pageNo);
+            if (!pageInfo->shown) {
+                CrashIf(0.0 != pageInfo->visibleRatio);
+                continue;
+            }
 
-        pageInfo->visibleRatio = 0.0;
-        if (!visiblePart.IsEmpty()) {
+            Rect pageRect = pageInfo->pos;
+            Rect visiblePart = pageRect.Intersect(viewPort);
+            if (visiblePart.IsEmpty()) {
+                continue;
+            }
             CrashIf(pageRect.dx <= 0 || pageRect.dy <= 0);
             // calculate with floating point precision to prevent an integer overflow
             pageInfo->visibleRatio = 1.0f * visiblePart.dx * visiblePart.dy / ((float)pageRect.dx * pageRect.dy);
+            if (0 == visibleFirstPageNo) {
+                visibleFirstPageNo = pageNo;
+            }
+            visibleLastPageNo = pageNo;
         }
-        pageInfo->pageOnScreen = pageRect;
-        pageInfo->pageOnScreen.Offset(-viewPort.x, -viewPort.y);
     }
 }
 
@@ -911,14 +1177,19 @@ int DisplayModel::GetPageNoByPoint(Point pt) {
         return -1;
     }
 
-    for (int pageNo = 1; pageNo <= PageCount(); ++pageNo) {
+    int rowIdx = FindPageRow(pt.y + visibleOffset.y);
+    if (rowIdx >= (int)pageRows.size()) {
+        return -1;
+    }
+    PageRow& row = pageRows.at(rowIdx);
+    for (int pageNo = row.firstPageNo; pageNo <= row.lastPageNo; ++pageNo) {
         PageInfo* pageInfo = GetPageInfo(pageNo);
         CrashIf(!(0.0 == pageInfo->visibleRatio || pageInfo->shown));
         if (!pageInfo->shown) {
             continue;
         }
 
-        if (pageInfo->pageOnScreen.Contains(pt)) {
+        if (PageOnScreen(pageNo).Contains(pt)) {
             return pageNo;
         }
     }
@@ -934,22 +1205,30 @@ int DisplayModel::GetPageNextToPoint(Point pt) {
     unsigned int maxDist = UINT_MAX;
     int closest = startPage;
 
-    for (int pageNo = 1; pageNo <= PageCount(); ++pageNo) {
-        PageInfo* pageInfo = GetPageInfo(pageNo);
-        CrashIf(0.0 != pageInfo->visibleRatio && !pageInfo->shown);
-        if (!pageInfo->shown) {
-            continue;
-        }
+    // the closest page is in the row at (or next to) pt or in a row
+    // right above or below it
+    int rowIdx = FindPageRow(pt.y + visibleOffset.y);
+    int firstRowIdx = std::max(rowIdx - 1, 0);
+    int lastRowIdx = std::min(rowIdx + 1, (int)pageRows.size() - 1);
+    for (int i = firstRowIdx; i <= lastRowIdx; i++) {
+        PageRow& row = pageRows.at(i);
+        for (int pageNo = row.firstPageNo; pageNo <= row.lastPageNo; ++pageNo) {
+            PageInfo* pageInfo = GetPageInfo(pageNo);
+            CrashIf(0.0 != pageInfo->visibleRatio && !pageInfo->shown);
+            if (!pageInfo->shown) {
+                continue;
+            }
 
-        if (pageInfo->pageOnScreen.Contains(pt)) {
-            return pageNo;
-        }
+            Rect r = PageOnScreen(pageNo);
+            if (r.Contains(pt)) {
+                return pageNo;
+            }
 
-        Rect r = pageInfo->pageOnScreen;
-        unsigned int dist = distSq(pt.x - r.x - r.dx / 2, pt.y - r.y - r.dy / 2);
-        if (dist < maxDist) {
-            closest = pageNo;
-            maxDist = dist;
+            unsigned int dist = distSq(pt.x - r.x - r.dx / 2, pt.y - r.y - r.dy / 2);
+            if (dist < maxDist) {
+                closest = pageNo;
+                maxDist = dist;
+            }
         }
     }
 
@@ -970,7 +1249,7 @@ Point DisplayModel::CvtToScreen(int pageNo, PointF pt) {
     }
     PointF p = engine->Transform(pt, pageNo, zoom, rotation);
     // don't add the full 0.5 for rounding to account for precision errors
-    Rect r = pageInfo->pageOnScreen;
+    Rect r = PageOnScreen(pageNo);
     p.x += 0.499 + r.x;
     p.y += 0.499 + r.y;
 
@@ -995,7 +1274,7 @@ PointF DisplayModel::CvtFromScreen(Point pt, int pageNo) {
     }
 
     // don't add the full 0.5 for rounding to account for precision errors
-    Rect r = pageInfo->pageOnScreen;
+    Rect r = PageOnScreen(pageNo);
     PointF p = PointF(pt.x - 0.499 - r.x, pt.y - 0.499 - r.y);
     float zoom = pageInfo->zoomReal;
     // TODO: must be a better way
@@ -1064,19 +1343,8 @@ bool DisplayModel::IsOverText(Point pt) {
 }
 
 void DisplayModel::RenderVisibleParts() {
-    int firstVisiblePage = 0;
-    int lastVisiblePage = 0;
-
-    for (int pageNo = 1; pageNo <= PageCount(); ++pageNo) {
-        PageInfo* pageInfo = GetPageInfo(pageNo);
-        if (pageInfo->visibleRatio > 0.0) {
-            CrashIf(!pageInfo->shown);
-            if (0 == firstVisiblePage) {
-                firstVisiblePage = pageNo;
-            }
-            lastVisiblePage = pageNo;
-        }
-    }
+    int firstVisiblePage = visibleFirstPageNo;
+    int lastVisiblePage = visibleLastPageNo;
     // no page is visible if e.g. the window is resized
     // vertically until only the title bar remains visible
     if (0 == firstVisiblePage) {
@@ -1195,9 +1463,9 @@ void DisplayModel::GoToPage(int pageNo, int scrollY, bool addNavPt, int scrollX)
     } else if (ZOOM_FIT_CONTENT == zoomVirtual) {
         // make sure that CalcZoomReal uses the correct page to calculate
         // the zoom level for (visibility will be recalculated below anyway)
-        for (int i = PageCount(); i > 0; i--) {
-            GetPageInfo(i)->visibleRatio = (i == pageNo ? 1.0f : 0);
-        }
+        ResetVisibleParts();
+        GetPageInfo(pageNo)->visibleRatio = 1.0f;
+        visibleFirstPageNo = visibleLastPageNo = pageNo;
         Relayout(zoomVirtual, rotation);
     }
     // lf("DisplayModel::GoToPage(pageNo=%d, scrollY=%d)", pageNo, scrollY);
@@ -1350,10 +1618,10 @@ bool DisplayModel::GoToPrevPage(int scrollY) {
         top = GetContentStart(currPageNo);
     }
 
-    PageInfo* pageInfo = GetPageInfo(currPageNo);
-    if (zoomVirtual == ZOOM_FIT_CONTENT && -pageInfo->pageOnScreen.y <= top.y) {
+    Rect pageOnScreen = PageOnScreen(currPageNo);
+    if (zoomVirtual == ZOOM_FIT_CONTENT && -pageOnScreen.y <= top.y) {
         scrollY = 0; // continue, even though the current page isn't fully visible
-    } else if (std::max(-pageInfo->pageOnScreen.y, 0) > scrollY && IsContinuous(GetDisplayMode())) {
+    } else if (std::max(-pageOnScreen.y, 0) > scrollY && IsContinuous(GetDisplayMode())) {
         /* the current page isn't fully visible, so show it first */
         GoToPage(currPageNo, scrollY);
         return true;
@@ -1366,7 +1634,7 @@ bool DisplayModel::GoToPrevPage(int scrollY) {
 
     // scroll to the bottom of the page
     if (-1 == scrollY) {
-        scrollY = GetPageInfo(firstPageInNewRow)->pageOnScreen.dy;
+        scrollY = PageOnScreen(firstPageInNewRow).dy;
     }
 
     GoToPage(firstPageInNewRow, scrollY);
@@ -1677,7 +1945,7 @@ bool DisplayModel::ShowResultRectToScreen(TextSel* res) {
         return false;
     }
 
-    PageInfo* pageInfo = GetPageInfo(res->pages[0]);
+    Rect pageOnScreen = PageOnScreen(res->pages[0]);
     int sx = 0, sy = 0;
 
     // vertically, we try to position the search result between 40%
@@ -1695,10 +1963,10 @@ bool DisplayModel::ShowResultRectToScreen(TextSel* res) {
     // center of the screen, but don't scroll further than page
     // boundaries, so that as much context as possible remains visible
     if (extremes.x < 0) {
-        sx = std::max(extremes.x + extremes.dx / 2 - viewPort.dx / 2, pageInfo->pageOnScreen.x);
+        sx = std::max(extremes.x + extremes.dx / 2 - viewPort.dx / 2, pageOnScreen.x);
     } else if (extremes.x + extremes.dx >= viewPort.dx) {
         sx = std::min(extremes.x + extremes.dx / 2 - viewPort.dx / 2,
-                      pageInfo->pageOnScreen.x + pageInfo->pageOnScreen.dx - viewPort.dx);
+                      pageOnScreen.x + pageOnScreen.dx - viewPort.dx);
     }
 
     if (sx != 0) {
@@ -1718,22 +1986,23 @@ ScrollState DisplayModel::GetScrollState() {
     }
 
     PageInfo* pageInfo = GetPageInfo(state.page);
+    Rect pageOnScreen = PageOnScreen(state.page);
     // Shortcut: don't calculate precise positions, if the
     // page wasn't scrolled right/down at all
-    if (!pageInfo || pageInfo->pageOnScreen.x > 0 && pageInfo->pageOnScreen.y > 0) {
+    if (!pageInfo || pageOnScreen.x > 0 && pageOnScreen.y > 0) {
         return state;
     }
 
     Rect screen(Point(), viewPort.Size());
-    Rect pageVis = pageInfo->pageOnScreen.Intersect(screen);
+    Rect pageVis = pageOnScreen.Intersect(screen);
     state.page = GetPageNextToPoint(pageVis.TL());
     PointF ptD = CvtFromScreen(pageVis.TL(), state.page);
 
     // Remember to show the margin, if it's currently visible
-    if (pageInfo->pageOnScreen.x <= 0) {
+    if (pageOnScreen.x <= 0) {
         state.x = ptD.x;
     }
-    if (pageInfo->pageOnScreen.y <= 0) {
+    if (pageOnScreen.y <= 0) {
         state.y = ptD.y;
     }
 
@@ -1836,7 +2105,8 @@ bool DisplayModel::ShouldCacheRendering(int pageNo) {
     // them for every UI update (WM_PAINT) can cause notable lags, and also
     // for smaller images which are scaled up
     PageInfo* info = GetPageInfo(pageNo);
-    return info->page.dx * info->page.dy > 1024 * 1024 || info->pageOnScreen.dx * info->pageOnScreen.dy > 1024 * 1024;
+    Rect pageOnScreen = PageOnScreen(pageNo);
+    return info->page.dx * info->page.dy > 1024 * 1024 || pageOnScreen.dx * pageOnScreen.dy > 1024 * 1024;
 }
 
 void DisplayModel::ScrollToLink(PageDestination* dest) {
@@ -1860,8 +2130,7 @@ void DisplayModel::ScrollToLink(PageDestination* dest) {
             scroll.x = -1;
         }
         if (DEST_USE_DEFAULT == rect.y) {
-            PageInfo* pageInfo = GetPageInfo(CurrentPageNo());
-            scroll.y = -(pageInfo->pageOnScreen.y - windowMargin.top);
+            scroll.y = -(PageOnScreen(CurrentPageNo()).y - windowMargin.top);
         }
     } else if (rect.dx != DEST_USE_DEFAULT && rect.dy != DEST_USE_DEFAULT) {
         // PDF: /FitR left bottom right top
@@ -24,14 +24,23 @@ struct PageInfo {
 
     /* data that changes due to scrolling. Calculated in DisplayModel::RecalcVisibleParts() */
     float visibleRatio; /* (0.0 = invisible, 1.0 = fully visible) */
-    /* position of page relative to visible view port: pos.Offset(-viewPort.x, -viewPort.y) */
-    Rect pageOnScreen{};
 
     // when zoomVirtual in DisplayMode is ZOOM_FIT_PAGE, ZOOM_FIT_WIDTH
     // or ZOOM_FIT_CONTENT, this is per-page zoom level
     float zoomReal;
 };
 
+/* A row of shown pages laid out next to each other. Rows are sorted by y
+   so that pages can be looked up by position with a binary search.
+   Calculated in DisplayModel::Relayout() */
+struct PageRow {
+    int firstPageNo = 0;
+    int lastPageNo = 0;
+    /* vertical extent of the row within total area */
+    int y = 0;
+    int dy = 0;
+};
+
 /* The current scroll state (needed for saving/restoring the scroll position) */
 /* coordinates are in user space units (per page) */
 struct ScrollState {
@@ -126,6 +135,8 @@ struct DisplayModel : public Controller {
     TextSearch* textSearch{nullptr};
 
     PageInfo* GetPageInfo(int pageNo) const;
+    /* position of page relative to visible view port: pos.Offset(-viewPort.x, -viewPort.y) */
+    Rect PageOnScreen(int pageNo) const;
 
     /* current rotation selected by user */
     int GetRotation() const;
@@ -143,6 +154,7 @@ struct DisplayModel : public Controller {
     bool PageVisible(int pageNo) const;
     bool PageVisibleNearby(int pageNo) const;
     int FirstVisiblePageNo() const;
+    int LastVisiblePageNo() const;
     bool FirstBookPageVisible() const;
     bool LastBookPageVisible() const;
 
@@ -183,15 +195,25 @@ struct DisplayModel : public Controller {
 
     /* allow resizing a window without triggering a new rendering (needed for window destruction) */
     bool dontRenderFlag = false;
+    /* incremented whenever RecalcVisibleParts() has been called, so that
+       RenderCache knows when to update its copy of the visible parts */
+    int visiblePartsVersion = 0;
 
     bool GetPresentationMode() const;
 
     void BuildPagesInfo();
+    void InitPagesInfo(int startPageNo);
+    void UpdatePageSizes(int startPageNo, int endPageNo);
+    bool RelayoutPages(int startPageNo, int endPageNo);
+    int PagePosX(int pageNo, int column, int dx) const;
+    void UpdatePageCount();
     float ZoomRealFromVirtualForPage(float zoomVirtual, int pageNo) const;
     SizeF PageSizeAfterRotation(int pageNo, bool fitToContent = false) const;
     void ChangeStartPage(int startPage);
     Point GetContentStart(int pageNo);
+    int FindPageRow(int y) const;
     void RecalcVisibleParts();
+    void ResetVisibleParts();
     void RenderVisibleParts();
     void AddNavPoint();
     RectF GetContentBox(int pageNo);
@@ -204,6 +226,18 @@ struct DisplayModel : public Controller {
 
     /* an array of PageInfo, len of array is pageCount */
     PageInfo* pagesInfo{nullptr};
+    /* rows of shown pages, calculated in Relayout() */
+    Vec<PageRow> pageRows;
+    /* horizontal layout as calculated in Relayout() (see PagePosX()) */
+    int layoutColumnDx[2]{0, 0};
+    int layoutOffX{0};
+    int layoutCanvasDx{0};
+    /* only pages visibleFirstPageNo to visibleLastPageNo can have a
+       visibleRatio > 0 (0 if no page is visible) */
+    int visibleFirstPageNo{0};
+    int visibleLastPageNo{0};
+    /* viewPort.TL() at the time of the last RecalcVisibleParts() */
+    Point visibleOffset;
 
     DisplayMode displayMode{DisplayMode::Automatic};
     /* In non-continuous mode is the first page from a file that we're
@@ -155,6 +155,27 @@ void EpubFormatter::HandleTagImg(HtmlToken* t) {
     }
 }
 
+// each document of the spine is a chapter which EpubDoc starts with
+// a <pagebreak page_path="..."> (where CSS style rules are reset)
+HtmlFormatterFactory EpubFormatter::GetChapters(Vec<int>& chapterStarts) {
+    const char* start = (const char*)htmlStr.data();
+    const char* end = start + htmlStr.size();
+    const char* tag = "<pagebreak page_path=";
+    size_t tagLen = str::Len(tag);
+
+    chapterStarts.Append((int)currReparseIdx);
+    const char* s = start + currReparseIdx + 1;
+    while (s < end && (s = (const char*)memchr(s, '<', end - s)) != nullptr) {
+        if ((size_t)(end - s) >= tagLen && str::EqN(s, tag, tagLen)) {
+            chapterStarts.Append((int)(s - start));
+        }
+        s++;
+    }
+
+    EpubDoc* doc = epubDoc;
+    return [doc](HtmlFormatterArgs* args) -> HtmlFormatter* { return new EpubFormatter(args, doc); };
+}
+
 void EpubFormatter::HandleTagPagebreak(HtmlToken* t) {
     AttrInfo* attr = t->GetAttrByName("page_path");
     if (!attr || pagePath) {
@@ -28,6 +28,7 @@ class EpubFormatter : public HtmlFormatter {
     void HandleTagLink(HtmlToken* t) override;
     void HandleHtmlTag(HtmlToken* t) override;
     bool IgnoreText() override;
+    HtmlFormatterFactory GetChapters(Vec<int>& chapterStarts) override;
 
     void HandleTagSvgImage(HtmlToken* t);
 
@@ -467,10 +467,26 @@ int EngineBase::PageCount() const {
     return pageCount;
 }
 
+bool EngineBase::LayoutPagesAsync([[maybe_unused]] const PagesLaidOutCb& onLaidOut) {
+    return false;
+}
+
+bool EngineBase::UpdatePageCount() {
+    return false;
+}
+
 RectF EngineBase::PageContentBox(int pageNo, [[maybe_unused]] RenderTarget target) {
     return PageMediabox(pageNo);
 }
 
+RectF EngineBase::PageMediaboxEstimate(int pageNo) {
+    return PageMediabox(pageNo);
+}
+
+bool EngineBase::LoadMediaboxesAsync([[maybe_unused]] const MediaboxesLoadedCb& onLoaded) {
+    return false;
+}
+
 bool EngineBase::SaveFileAsPDF([[maybe_unused]] const char* pdfFileName, [[maybe_unused]] bool includeUserAnnots) {
     return false;
 }
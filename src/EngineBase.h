@@ -292,6 +292,11 @@ struct RenderPageArgs {
                    RenderTarget target = RenderTarget::View, AbortCookie** cookie_out = nullptr);
 };
 
+// called with a range of pages whose mediabox has been determined
+typedef std::function<void(int startPageNo, int endPageNo)> MediaboxesLoadedCb;
+// called once all pages of a document have been laid out
+typedef std::function<void()> PagesLaidOutCb;
+
 class EngineBase {
   public:
     Kind kind = nullptr;
@@ -317,9 +322,25 @@ class EngineBase {
 
     // number of pages the loaded document contains
     int PageCount() const;
+    // engines which lay out pages in the background (e.g. for ebooks) only
+    // estimate PageCount() until they're done. onLaidOut is called (from a
+    // background thread) once they are, after which UpdatePageCount() should
+    // be called. returns false if PageCount() is already exact
+    virtual bool LayoutPagesAsync(const PagesLaidOutCb& onLaidOut);
+    // waits for all pages to be laid out and makes PageCount() return
+    // the actual number of pages. returns true if it has changed
+    virtual bool UpdatePageCount();
 
     // the box containing the visible page content (usually RectF(0, 0, pageWidth, pageHeight))
     virtual RectF PageMediabox(int pageNo) = 0;
+    // a quick estimate of PageMediabox for engines which only determine
+    // mediaboxes on demand (e.g. for documents with very many pages)
+    virtual RectF PageMediaboxEstimate(int pageNo);
+    // determines the mediaboxes of all pages for which PageMediaboxEstimate is
+    // only an estimate on a background thread. onLoaded is called (from that
+    // thread) for every range of pages whose mediabox might differ from the
+    // estimate. returns false if all mediaboxes are already known
+    virtual bool LoadMediaboxesAsync(const MediaboxesLoadedCb& onLoaded);
     // the box inside PageMediabox that actually contains any relevant content
     // (used for auto-cropping in Fit Content mode, can be PageMediabox)
     virtual RectF PageContentBox(int pageNo, RenderTarget target = RenderTarget::View);
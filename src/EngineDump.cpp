@@ -13,10 +13,14 @@
 #include "wingui/TreeModel.h"
 
 #include "Annotation.h"
+#include "AppTools.h"
 #include "EngineBase.h"
 #include "EngineDjVu.h"
 #include "EngineCreate.h"
 #include "PdfCreator.h"
+#include "ProgressUpdateUI.h"
+#include "TextSelection.h"
+#include "TextSearch.h"
 
 #define Out(msg, ...) printf(msg, __VA_ARGS__)
 
@@ -347,7 +351,33 @@ void DumpThumbnail(EngineBase* engine) {
     delete bmp;
 }
 
-void DumpData(EngineBase* engine, bool fullDump) {
+// needed by TextIndex.cpp but EngineDump never caches extracted text on disk
+WCHAR* AppGenDataFilename([[maybe_unused]] const WCHAR* fileName) {
+    return nullptr;
+}
+
+void DumpSearchResults(EngineBase* engine, const WCHAR* searchText) {
+    DocumentTextCache textCache(engine);
+    TextSearch search(engine, &textCache);
+
+    AutoFree text(Escape(searchText));
+    Out("\t<Search Text=\"%s\">\n", text.Get());
+    int nHits = search.FindAll(searchText, [](TextSearchHit* hit) {
+        Out("\t\t<Hit Start=\"%d:%d\" End=\"%d:%d\">\n", hit->startPage, hit->startGlyph, hit->endPage,
+            hit->endGlyph);
+        TextSel* sel = hit->sel;
+        for (int i = 0; i < sel->len; i++) {
+            Rect r = sel->rects[i];
+            Out("\t\t\t<Rect Page=\"%d\" Rect=\"%d %d %d %d\" />\n", sel->pages[i], r.x, r.y, r.dx, r.dy);
+        }
+        Out1("\t\t</Hit>\n");
+        return true;
+    });
+    Out("\t\t<HitCount Value=\"%d\" />\n", nHits);
+    Out1("\t</Search>\n");
+}
+
+void DumpData(EngineBase* engine, bool fullDump, const WCHAR* searchText) {
     Out1(UTF8_BOM);
     Out1("<?xml version=\"1.0\"?>\n");
     Out1("<EngineDump>\n");
@@ -359,6 +389,9 @@ void DumpData(EngineBase* engine, bool fullDump) {
     if (fullDump) {
         DumpThumbnail(engine);
     }
+    if (searchText) {
+        DumpSearchResults(engine, searchText);
+    }
     Out1("</EngineDump>\n");
 }
 
@@ -478,7 +511,7 @@ int main([[maybe_unused]] int argc, [[maybe_unused]] char** argv) {
     ParseCmdLine(GetCommandLine(), argList);
     if (argList.size() < 2) {
     Usage:
-        ErrOut("%s [-pwd <password>][-quick][-render <path-%%d.tga>] <filename>",
+        ErrOut("%s [-pwd <password>][-quick][-render <path-%%d.tga>][-search <text>] <filename>",
                path::GetBaseNameNoFree(argList.at(0)));
         return 2;
     }
@@ -488,6 +521,7 @@ int main([[maybe_unused]] int argc, [[maybe_unused]] char** argv) {
     bool fullDump = true;
     WCHAR* renderPath = nullptr;
     float renderZoom = 1.f;
+    WCHAR* searchText = nullptr;
     bool loadOnly = false, silent = false;
     int breakAlloc = 0;
 
@@ -504,6 +538,9 @@ int main([[maybe_unused]] int argc, [[maybe_unused]] char** argv) {
                 i++;
             }
             renderPath = argList.at(++i);
+        } else if (str::Eq(argList.at(i), L"-search") && i + 1 < argList.size() && !searchText) {
+            // reports all matches (case insensitive) for headless testing of TextSearch
+            searchText = argList.at(++i);
         } else if (str::Eq(argList.at(i), L"-loadonly")) {
             // -loadonly and -silent are only meant for profiling
             loadOnly = true;
@@ -567,8 +604,10 @@ int main([[maybe_unused]] int argc, [[maybe_unused]] char** argv) {
         ErrOut("Error: Couldn't create an engine for %s!", path::GetBaseNameNoFree(filePath));
         return 1;
     }
+    // dump all pages of documents which are laid out in the background
+    engine->UpdatePageCount();
     if (!loadOnly) {
-        DumpData(engine, fullDump);
+        DumpData(engine, fullDump, searchText);
     }
     if (renderPath) {
         RenderDocument(engine, renderPath, renderZoom, silent);
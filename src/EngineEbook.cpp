@@ -57,6 +57,10 @@ void SetDefaultEbookFont(const WCHAR* name, float size) {
     gDefaultFontSize = size * 0.8f;
 }
 
+// number of pages laid out before a document is shown, the remaining
+// ones are laid out in the background (see EngineEbook::StartLayout)
+#define PAGES_TO_LAY_OUT_FIRST 32
+
 /* common classes for EPUB, FictionBook2, Mobi, PalmDOC, CHM, HTML and TXT engines */
 
 struct PageAnchor {
@@ -104,6 +108,9 @@ class EngineEbook : public EngineBase {
 
     bool BenchLoadPage(int pageNo) override;
 
+    bool LayoutPagesAsync(const PagesLaidOutCb& onLaidOut) override;
+    bool UpdatePageCount() override;
+
   protected:
     Vec<HtmlPage*>* pages = nullptr;
     Vec<PageAnchor> anchors;
@@ -118,8 +125,31 @@ class EngineEbook : public EngineBase {
     RectF pageRect;
     float pageBorder;
 
+    // set while pages are laid out in the background, until then
+    // pageCount is only an estimate (see StartLayout)
+    // isLayingOut is protected by pagesAccess (see IsLayingOut)
+    bool isLayingOut = false;
+    // set through InterlockedExchange (read from the layout thread)
+    LONG stopLayout = 0;
+    HtmlFormatter* formatter = nullptr;
+    bool skipEmptyPages = false;
+    HANDLE layoutThread = nullptr;
+    CONDITION_VARIABLE pageLaidOut;
+    PagesLaidOutCb pagesLaidOutCb;
+    // drawn for pages beyond the end of the document
+    // (if pageCount has been overestimated)
+    Vec<DrawInstr> blankPage;
+
     void GetTransform(Matrix& m, float zoom, int rotation);
+    bool StartLayout(HtmlFormatter* formatter, size_t htmlLen, bool skipEmptyPages);
+    void StopLayout();
+    static DWORD WINAPI LayoutThread(LPVOID data);
+    void WaitForPage(int pageNo);
+    void WaitForLayout();
+    bool IsLayingOut();
+    void AddPageAnchors(int pageNo);
     bool ExtractPageAnchors();
+    PageDestination* FindNamedDest(const WCHAR* name, bool allowBaseDest);
     WCHAR* ExtractFontList();
 
     virtual PageElement* CreatePageLink(DrawInstr* link, Rect rect, int pageNo);
@@ -176,9 +206,11 @@ EngineEbook::EngineEbook() {
     pageBorder = 0.4f * GetFileDPI();
     preferredLayout = Layout_Book;
     InitializeCriticalSection(&pagesAccess);
+    InitializeConditionVariable(&pageLaidOut);
 }
 
 EngineEbook::~EngineEbook() {
+    StopLayout();
     EnterCriticalSection(&pagesAccess);
 
     if (pages) {
@@ -231,35 +263,162 @@ void EngineEbook::GetTransform(Matrix& m, float zoom, int rotation) {
     GetBaseTransform(m, ToGdipRectF(pageRect), zoom, rotation);
 }
 
+// note: make sure to call WaitForPage(pageNo) before entering pagesAccess
 Vec<DrawInstr>* EngineEbook::GetHtmlPage(int pageNo) {
     CrashIf(pageNo < 1 || PageCount() < pageNo);
     if (pageNo < 1 || PageCount() < pageNo) {
         return nullptr;
     }
+    if ((size_t)pageNo > pages->size()) {
+        CrashIf(isLayingOut);
+        return &blankPage;
+    }
     return &pages->at(pageNo - 1)->instructions;
 }
 
-bool EngineEbook::ExtractPageAnchors() {
+// lays out the first few pages and estimates the number of pages from how
+// much of the document they cover. The remaining pages are laid out in the
+// background, until then the pages are made available as they're laid out.
+// formatter is owned by the engine afterwards
+bool EngineEbook::StartLayout(HtmlFormatter* formatter, size_t htmlLen, bool skipEmptyPages) {
+    pages = new Vec<HtmlPage*>();
+    HtmlPage* pd = nullptr;
+    for (int i = 0; i < PAGES_TO_LAY_OUT_FIRST; i++) {
+        pd = formatter->Next(skipEmptyPages);
+        if (!pd) {
+            break;
+        }
+        pages->Append(pd);
+        AddPageAnchors((int)pages->size());
+    }
+    pageCount = (int)pages->size();
+    if (!pd) {
+        delete formatter;
+        return pageCount > 0;
+    }
+
+    int reparseIdx = pages->Last()->reparseIdx;
+    if (reparseIdx > 0 && htmlLen > (size_t)reparseIdx) {
+        pageCount = (int)ceil((double)pageCount * htmlLen / reparseIdx);
+    }
+    pageCount = std::max(pageCount, (int)pages->size() + 1);
+
+    this->formatter = formatter;
+    this->skipEmptyPages = skipEmptyPages;
+    isLayingOut = true;
+    layoutThread = CreateThread(nullptr, 0, LayoutThread, this, 0, nullptr);
+    if (!layoutThread) {
+        // lay out the remaining pages right away
+        LayoutThread(this);
+        pageCount = (int)pages->size();
+    }
+    return true;
+}
+
+DWORD WINAPI EngineEbook::LayoutThread(LPVOID data) {
+    EngineEbook* e = (EngineEbook*)data;
+    while (InterlockedAdd(&e->stopLayout, 0) == 0) {
+        HtmlPage* pd = e->formatter->Next(e->skipEmptyPages);
+        if (!pd) {
+            break;
+        }
+        ScopedCritSec scope(&e->pagesAccess);
+        e->pages->Append(pd);
+        e->AddPageAnchors((int)e->pages->size());
+        WakeAllConditionVariable(&e->pageLaidOut);
+    }
+    delete e->formatter;
+    e->formatter = nullptr;
+
+    PagesLaidOutCb onLaidOut;
+    {
+        ScopedCritSec scope(&e->pagesAccess);
+        e->isLayingOut = false;
+        onLaidOut = e->pagesLaidOutCb;
+        WakeAllConditionVariable(&e->pageLaidOut);
+    }
+    if (onLaidOut && InterlockedAdd(&e->stopLayout, 0) == 0) {
+        onLaidOut();
+    }
+    return 0;
+}
+
+// must be called from the destructors of derived engines
+// (before deleting anything the formatter might access)
+void EngineEbook::StopLayout() {
+    if (!layoutThread) {
+        return;
+    }
+    InterlockedExchange(&stopLayout, 1);
+    WaitForSingleObject(layoutThread, INFINITE);
+    CloseHandle(layoutThread);
+    layoutThread = nullptr;
+}
+
+void EngineEbook::WaitForPage(int pageNo) {
+    ScopedCritSec scope(&pagesAccess);
+    while (isLayingOut && pages->size() < (size_t)pageNo) {
+        SleepConditionVariableCS(&pageLaidOut, &pagesAccess, INFINITE);
+    }
+}
+
+void EngineEbook::WaitForLayout() {
+    WaitForPage(INT_MAX);
+}
+
+bool EngineEbook::IsLayingOut() {
     ScopedCritSec scope(&pagesAccess);
+    return isLayingOut;
+}
 
-    DrawInstr* baseAnchor = nullptr;
-    for (int pageNo = 1; pageNo <= pageCount; pageNo++) {
-        Vec<DrawInstr>* pageInstrs = GetHtmlPage(pageNo);
-        if (!pageInstrs) {
+bool EngineEbook::LayoutPagesAsync(const PagesLaidOutCb& onLaidOut) {
+    {
+        ScopedCritSec scope(&pagesAccess);
+        if (isLayingOut) {
+            pagesLaidOutCb = onLaidOut;
+            return true;
+        }
+        if (!layoutThread || (size_t)pageCount == pages->size()) {
             return false;
         }
+    }
+    // the layout has completed since FinishLoading
+    onLaidOut();
+    return true;
+}
 
-        for (size_t k = 0; k < pageInstrs->size(); k++) {
-            DrawInstr* i = &pageInstrs->at(k);
-            if (DrawInstrType::Anchor != i->type) {
-                continue;
-            }
-            anchors.Append(PageAnchor(i, pageNo));
-            if (k < 2 && str::StartsWith(i->str.s + i->str.len, "\" page_marker />")) {
-                baseAnchor = i;
-            }
+bool EngineEbook::UpdatePageCount() {
+    WaitForLayout();
+    ScopedCritSec scope(&pagesAccess);
+    if ((size_t)pageCount == pages->size()) {
+        return false;
+    }
+    pageCount = (int)pages->size();
+    return true;
+}
+
+// note: make sure to only call with pagesAccess
+void EngineEbook::AddPageAnchors(int pageNo) {
+    DrawInstr* baseAnchor = baseAnchors.size() > 0 ? baseAnchors.Last() : nullptr;
+    Vec<DrawInstr>* pageInstrs = &pages->at(pageNo - 1)->instructions;
+    for (size_t k = 0; k < pageInstrs->size(); k++) {
+        DrawInstr* i = &pageInstrs->at(k);
+        if (DrawInstrType::Anchor != i->type) {
+            continue;
+        }
+        anchors.Append(PageAnchor(i, pageNo));
+        if (k < 2 && str::StartsWith(i->str.s + i->str.len, "\" page_marker />")) {
+            baseAnchor = i;
         }
-        baseAnchors.Append(baseAnchor);
+    }
+    baseAnchors.Append(baseAnchor);
+}
+
+bool EngineEbook::ExtractPageAnchors() {
+    ScopedCritSec scope(&pagesAccess);
+
+    for (int pageNo = 1; pageNo <= pageCount; pageNo++) {
+        AddPageAnchors(pageNo);
     }
 
     CrashIf(baseAnchors.size() != pages->size());
@@ -316,6 +475,7 @@ RenderedBitmap* EngineEbook::RenderPage(RenderPageArgs& args) {
         *args.cookie_out = cookie;
     }
 
+    WaitForPage(pageNo);
     ScopedCritSec scope(&pagesAccess);
 
     mui::ITextRender* textDraw = mui::TextRenderGdiplus::Create(&g);
@@ -341,6 +501,7 @@ static Rect GetInstrBbox(DrawInstr& instr, float pageBorder) {
 
 PageText EngineEbook::ExtractPageText(int pageNo) {
     const WCHAR* lineSep = L"\n";
+    WaitForPage(pageNo);
     ScopedCritSec scope(&pagesAccess);
 
     gAllowAllocFailure++;
@@ -429,7 +590,13 @@ PageElement* EngineEbook::CreatePageLink(DrawInstr* link, Rect rect, int pageNo)
         return newEbookLink(link, rect, nullptr, pageNo);
     }
 
-    DrawInstr* baseAnchor = baseAnchors.at(pageNo - 1);
+    DrawInstr* baseAnchor = nullptr;
+    {
+        ScopedCritSec scope(&pagesAccess);
+        if ((size_t)pageNo <= baseAnchors.size()) {
+            baseAnchor = baseAnchors.at(pageNo - 1);
+        }
+    }
     if (baseAnchor) {
         AutoFree basePath(str::DupN(baseAnchor->str.s, baseAnchor->str.len));
         AutoFree relPath(ResolveHtmlEntities(link->str.s, link->str.len));
@@ -447,7 +614,14 @@ PageElement* EngineEbook::CreatePageLink(DrawInstr* link, Rect rect, int pageNo)
 Vec<IPageElement*>* EngineEbook::GetElements(int pageNo) {
     auto els = new Vec<IPageElement*>();
 
-    Vec<DrawInstr>* pageInstrs = GetHtmlPage(pageNo);
+    // don't hold pagesAccess while creating links, as resolving
+    // them might have to wait for the remaining pages to be laid out
+    WaitForPage(pageNo);
+    Vec<DrawInstr>* pageInstrs = nullptr;
+    {
+        ScopedCritSec scope(&pagesAccess);
+        pageInstrs = GetHtmlPage(pageNo);
+    }
     size_t n = pageInstrs->size();
     for (size_t idx = 0; idx < n; idx++) {
         DrawInstr& i = pageInstrs->at(idx);
@@ -482,6 +656,8 @@ RenderedBitmap* EngineEbook::GetImageForPageElement(IPageElement* iel) {
     PageElement* el = (PageElement*)iel;
     int pageNo = el->pageNo;
     int idx = el->imageID;
+    WaitForPage(pageNo);
+    ScopedCritSec scope(&pagesAccess);
     Vec<DrawInstr>* pageInstrs = GetHtmlPage(pageNo);
     const DrawInstr& i = pageInstrs->at(idx);
     CrashIf(i.type != DrawInstrType::Image);
@@ -511,6 +687,20 @@ IPageElement* EngineEbook::GetElementAtPos(int pageNo, PointF pt) {
 }
 
 PageDestination* EngineEbook::GetNamedDest(const WCHAR* name) {
+    // don't wait for the remaining pages to be laid out
+    // if the destination is on a page that already has been
+    PageDestination* dest = FindNamedDest(name, false);
+    if (!dest) {
+        WaitForLayout();
+        dest = FindNamedDest(name, true);
+    }
+    return dest;
+}
+
+// allowBaseDest: return the start of a merged document if the ID can't be found
+PageDestination* EngineEbook::FindNamedDest(const WCHAR* name, bool allowBaseDest) {
+    ScopedCritSec scope(&pagesAccess);
+
     AutoFree name_utf8(strconv::WstrToUtf8(name));
     const char* id = name_utf8.Get();
     if (str::FindChar(id, '#')) {
@@ -544,6 +734,10 @@ PageDestination* EngineEbook::GetNamedDest(const WCHAR* name) {
             }
             continue;
         }
+        // the page count might have been underestimated (see StartLayout)
+        if (anchor->pageNo > PageCount()) {
+            break;
+        }
         // note: at least CHM treats URLs as case-independent
         if (id_len == anchor->instr->str.len && str::EqNI(id, anchor->instr->str.s, id_len)) {
             RectF rect(0, anchor->instr->bbox.y + pageBorder, pageRect.dx, 10);
@@ -553,7 +747,7 @@ PageDestination* EngineEbook::GetNamedDest(const WCHAR* name) {
     }
 
     // don't fail if an ID doesn't exist in a merged document
-    if (basePageNo != 0) {
+    if (basePageNo != 0 && basePageNo <= PageCount() && allowBaseDest) {
         RectF rect(0, pageBorder, pageRect.dx, 10);
         rect.Inflate(-pageBorder, 0);
         return newSimpleDest(basePageNo, rect);
@@ -563,6 +757,7 @@ PageDestination* EngineEbook::GetNamedDest(const WCHAR* name) {
 }
 
 WCHAR* EngineEbook::ExtractFontList() {
+    WaitForLayout();
     ScopedCritSec scope(&pagesAccess);
 
     Vec<mui::CachedFont*> seenFonts;
@@ -709,6 +904,7 @@ EngineEpub::EngineEpub() : EngineEbook() {
 }
 
 EngineEpub::~EngineEpub() {
+    StopLayout();
     delete doc;
     delete tocTree;
     if (stream) {
@@ -761,11 +957,7 @@ bool EngineEpub::FinishLoading() {
     args.textAllocator = &allocator;
     args.textRenderMethod = mui::TextRenderMethodGdiplusQuick;
 
-    pages = EpubFormatter(&args, doc).FormatAllPages(false);
-
-    // must set pageCount before ExtractPageAnchors
-    pageCount = (int)pages->size();
-    if (!ExtractPageAnchors()) {
+    if (!StartLayout(new EpubFormatter(&args, doc), args.htmlStr.size(), false)) {
         return false;
     }
 
@@ -775,7 +967,7 @@ bool EngineEpub::FinishLoading() {
         preferredLayout = Layout_Book;
     }
 
-    return pageCount > 0;
+    return true;
 }
 
 std::span<u8> EngineEpub::GetFileData() {
@@ -804,6 +996,11 @@ TocTree* EngineEpub::GetToc() {
     if (tocTree) {
         return tocTree;
     }
+    // the ToC is only available once all pages have been laid out
+    // (cf. LayoutPagesAsync) so that the UI doesn't have to wait for it
+    if (IsLayingOut()) {
+        return nullptr;
+    }
     EbookTocBuilder builder(this);
     doc->ParseToc(&builder);
     TocItem* root = builder.GetRoot();
@@ -849,6 +1046,7 @@ class EngineFb2 : public EngineEbook {
         defaultFileExt = L".fb2";
     }
     virtual ~EngineFb2() {
+        StopLayout();
         delete tocTree;
         delete doc;
     }
@@ -907,19 +1105,17 @@ bool EngineFb2::FinishLoading() {
         defaultFileExt = L".fb2z";
     }
 
-    pages = Fb2Formatter(&args, doc).FormatAllPages(false);
-    // must set pageCount before ExtractPageAnchors
-    pageCount = (int)pages->size();
-    if (!ExtractPageAnchors()) {
-        return false;
-    }
-    return pageCount > 0;
+    return StartLayout(new Fb2Formatter(&args, doc), args.htmlStr.size(), false);
 }
 
 TocTree* EngineFb2::GetToc() {
     if (tocTree) {
         return tocTree;
     }
+    // see EngineEpub::GetToc
+    if (IsLayingOut()) {
+        return nullptr;
+    }
     EbookTocBuilder builder(this);
     doc->ParseToc(&builder);
     TocItem* root = builder.GetRoot();
@@ -967,6 +1163,7 @@ class EngineMobi : public EngineEbook {
         defaultFileExt = L".mobi";
     }
     ~EngineMobi() override {
+        StopLayout();
         delete tocTree;
         delete doc;
     }
@@ -1022,13 +1219,7 @@ bool EngineMobi::FinishLoading() {
     args.textAllocator = &allocator;
     args.textRenderMethod = mui::TextRenderMethodGdiplusQuick;
 
-    pages = MobiFormatter(&args, doc).FormatAllPages();
-    // must set pageCount before ExtractPageAnchors
-    pageCount = (int)pages->size();
-    if (!ExtractPageAnchors()) {
-        return false;
-    }
-    return pageCount > 0;
+    return StartLayout(new MobiFormatter(&args, doc), args.htmlStr.size(), true);
 }
 
 PageDestination* EngineMobi::GetNamedDest(const WCHAR* name) {
@@ -1036,14 +1227,6 @@ PageDestination* EngineMobi::GetNamedDest(const WCHAR* name) {
     if (filePos < 0 || 0 == filePos && *name != '0') {
         return nullptr;
     }
-    int pageNo;
-    for (pageNo = 1; pageNo < PageCount(); pageNo++) {
-        if (pages->at(pageNo)->reparseIdx > filePos) {
-            break;
-        }
-    }
-    CrashIf(pageNo < 1 || pageNo > PageCount());
-
     const std::span<u8> htmlData = doc->GetHtmlData();
     size_t htmlLen = htmlData.size();
     const char* start = (const char*)htmlData.data();
@@ -1051,7 +1234,28 @@ PageDestination* EngineMobi::GetNamedDest(const WCHAR* name) {
         return nullptr;
     }
 
+    // wait until the page following the one containing filePos has been laid out
+    for (int nPages = 1;; nPages++) {
+        WaitForPage(nPages);
+        ScopedCritSec scope(&pagesAccess);
+        if ((size_t)nPages > pages->size() || pages->at(nPages - 1)->reparseIdx > filePos) {
+            break;
+        }
+    }
+
     ScopedCritSec scope(&pagesAccess);
+    int pageNo;
+    int nPages = (int)pages->size();
+    for (pageNo = 1; pageNo < nPages; pageNo++) {
+        if (pages->at(pageNo)->reparseIdx > filePos) {
+            break;
+        }
+    }
+    // the page count might have been underestimated (see StartLayout)
+    if (pageNo > PageCount()) {
+        return nullptr;
+    }
+
     Vec<DrawInstr>* pageInstrs = GetHtmlPage(pageNo);
     // link to the bottom of the page, if filePos points
     // beyond the last visible DrawInstr of a page
@@ -1072,6 +1276,10 @@ TocTree* EngineMobi::GetToc() {
     if (tocTree) {
         return tocTree;
     }
+    // see EngineEpub::GetToc
+    if (IsLayingOut()) {
+        return nullptr;
+    }
     EbookTocBuilder builder(this);
     doc->ParseToc(&builder);
     TocItem* root = builder.GetRoot();
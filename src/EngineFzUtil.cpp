@@ -169,7 +169,13 @@ void* fz_memdup(fz_context* ctx, void* p, size_t size) {
     return res;
 }
 
-fz_stream* fz_open_file2(fz_context* ctx, const WCHAR* filePath) {
+static bool gMapLargeFiles = false;
+
+void SetMapLargeFiles(bool enable) {
+    gMapLargeFiles = enable;
+}
+
+fz_stream* fz_open_file2(fz_context* ctx, const WCHAR* filePath, bool mapFile) {
     fz_stream* stm = nullptr;
     AutoFreeStr path = strconv::WstrToUtf8(filePath);
     i64 fileSize = file::GetSize(path.AsView());
@@ -208,8 +214,19 @@ fz_stream* fz_open_file2(fz_context* ctx, const WCHAR* filePath) {
         return stm;
     }
 
+    // a file can't be replaced or truncated by other programs while it's
+    // mapped, so mapping is only done if the user has asked for it
+    mapFile = mapFile && gMapLargeFiles;
+    // reading a mapped file that has become unavailable (e.g. on a network
+    // drive or an unplugged USB disk) raises an exception instead of
+    // returning a read error
+    mapFile = mapFile && path::IsOnFixedDrive(filePath) && !path::IsOnRemovableBus(filePath);
     fz_try(ctx) {
-        stm = fz_open_file_w(ctx, filePath);
+        if (mapFile) {
+            stm = fz_open_file_mapped_w(ctx, filePath);
+        } else {
+            stm = fz_open_file_w(ctx, filePath);
+        }
     }
     fz_catch(ctx) {
         stm = nullptr;
@@ -38,8 +38,17 @@ struct FzPageInfo {
     Vec<IPageElement*> comments;
 
     RectF mediabox = {};
+    // set if mediabox is only an estimate (see EnginePdf::FinishLoading).
+    // Cleared with Interlocked* after mediabox has been determined, so that
+    // mediabox can be read without ctxAccess once this is no longer set
+    LONG isMediaboxEstimate = FALSE;
     Vec<FitzImagePos> images;
 
+    // cached display list of the page content (without annotations)
+    fz_display_list* list = nullptr;
+    // estimated memory used by list
+    size_t listSize = 0;
+
     // if false, only loaded page (fast)
     // if true, loaded expensive info (extracted text etc.)
     bool fullyLoaded = false;
@@ -61,7 +70,10 @@ WCHAR* pdf_to_wstr(fz_context* ctx, pdf_obj* obj);
 WCHAR* pdf_clean_string(WCHAR* string);
 
 fz_stream* fz_open_istream(fz_context* ctx, IStream* stream);
-fz_stream* fz_open_file2(fz_context* ctx, const WCHAR* filePath);
+// if mapFile is set, files that aren't loaded into memory are memory-mapped
+// (if enabled with SetMapLargeFiles and only on internal fixed drives)
+// instead of being read through stdio
+fz_stream* fz_open_file2(fz_context* ctx, const WCHAR* filePath, bool mapFile = false);
 void fz_stream_fingerprint(fz_context* ctx, fz_stream* stm, u8 digest[16]);
 std::span<u8> fz_extract_stream_data(fz_context* ctx, fz_stream* stream);
 
@@ -68,8 +68,20 @@ Kind kindEngineImage = "engineImage";
 Kind kindEngineImageDir = "engineImageDir";
 Kind kindEngineComicBooks = "engineComicBooks";
 
-// number of decoded bitmaps to cache for quicker rendering
-#define MAX_IMAGE_PAGE_CACHE 10
+// memory to use for caching decoded bitmaps for quicker rendering
+#ifdef _WIN64
+#define MAX_IMAGE_PAGE_CACHE_BYTES (512 * 1024 * 1024)
+#else
+#define MAX_IMAGE_PAGE_CACHE_BYTES (192 * 1024 * 1024)
+#endif
+// number of pages to decode in advance in reading direction
+// (and in the opposite direction, 1 page is decoded in advance)
+#define IMAGE_READ_AHEAD_PAGES 2
+#define MAX_IMAGE_DECODE_THREADS 2
+// upper limit for the image data extracted from comic book archives kept in memory
+#define MAX_CBX_IMAGE_DATA_CACHE (64 * 1024 * 1024)
+// the size of most images can be determined from this many bytes
+#define IMAGE_HEADER_SIZE (64 * 1024)
 
 ///// EngineImages methods apply to all types of engines handling full-page images /////
 
@@ -77,7 +89,14 @@ struct ImagePage {
     int pageNo = 0;
     Bitmap* bmp = nullptr;
     bool ownBmp = true;
+    // one reference is held by the page cache
     int refs = 1;
+    // set while bmp is being loaded (possibly on another thread)
+    bool isLoading = false;
+    // estimated memory used by the decoded bmp
+    size_t bytes = 0;
+    // value of EngineImages::pageUseCount when last requested
+    u64 lastUsed = 0;
 
     ImagePage(int pageNo, Bitmap* bmp) {
         this->pageNo = pageNo;
@@ -122,8 +141,29 @@ class EngineImages : public EngineBase {
     ScopedComPtr<IStream> fileStream;
 
     CRITICAL_SECTION cacheAccess;
+    // all cached pages (in no particular order)
     Vec<ImagePage*> pageCache;
+    // cached pages by page number (nullptr if not cached)
+    Vec<ImagePage*> pageCacheByNo;
+    size_t pageCacheBytes = 0;
+    u64 pageUseCount = 0;
+    // filled in lazily by PageMediabox (protected by mediaboxAccess,
+    // as rendering threads ask for page sizes as well)
     Vec<RectF> mediaboxes;
+    CRITICAL_SECTION mediaboxAccess;
+
+    // set by engines whose LoadBitmapForPage can be called by several
+    // threads at once, so that pages can be decoded in parallel and in
+    // advance (derived classes must call StopReadAhead in their destructor)
+    bool loadsPagesInParallel = false;
+    HANDLE decodeThreads[MAX_IMAGE_DECODE_THREADS]{};
+    int nDecodeThreads = 0;
+    // pages to decode in advance (protected by cacheAccess)
+    Vec<int> readAheadQueue;
+    int lastRequestedPage = 0;
+    bool stopDecoding = false;
+    CONDITION_VARIABLE readAheadRequested;
+    CONDITION_VARIABLE pageLoaded;
 
     void GetTransform(Matrix& m, int pageNo, float zoom, int rotation);
 
@@ -132,6 +172,11 @@ class EngineImages : public EngineBase {
 
     ImagePage* GetPage(int pageNo, bool tryOnly = false);
     void DropPage(ImagePage* page, bool forceRemove);
+    ImagePage* LoadPage(int pageNo);
+    void FreeForNewPage(ImagePage* newPage);
+    void QueueReadAhead(int pageNo);
+    void StopReadAhead();
+    static DWORD WINAPI DecodeThread(LPVOID data);
 };
 
 EngineImages::EngineImages() {
@@ -141,9 +186,14 @@ EngineImages::EngineImages() {
     isImageCollection = true;
 
     InitializeCriticalSection(&cacheAccess);
+    InitializeCriticalSection(&mediaboxAccess);
+    InitializeConditionVariable(&readAheadRequested);
+    InitializeConditionVariable(&pageLoaded);
 }
 
 EngineImages::~EngineImages() {
+    StopReadAhead();
+
     EnterCriticalSection(&cacheAccess);
     while (pageCache.size() > 0) {
         ImagePage* lastPage = pageCache.Last();
@@ -152,15 +202,24 @@ EngineImages::~EngineImages() {
     }
     LeaveCriticalSection(&cacheAccess);
     DeleteCriticalSection(&cacheAccess);
+    DeleteCriticalSection(&mediaboxAccess);
 }
 
 RectF EngineImages::PageMediabox(int pageNo) {
     CrashIf((pageNo < 1) || (pageNo > pageCount));
     int n = pageNo - 1;
-    if (mediaboxes.at(n).IsEmpty()) {
-        mediaboxes.at(n) = LoadMediabox(pageNo);
+    {
+        ScopedCritSec scope(&mediaboxAccess);
+        if (!mediaboxes.at(n).IsEmpty()) {
+            return mediaboxes.at(n);
+        }
     }
-    return mediaboxes.at(n);
+    // LoadMediabox might have to wait for cacheAccess, so it's called without
+    // holding mediaboxAccess (at worst, a page size is determined twice)
+    RectF mediabox = LoadMediabox(pageNo);
+    ScopedCritSec scope(&mediaboxAccess);
+    mediaboxes.at(n) = mediabox;
+    return mediabox;
 }
 
 RenderedBitmap* EngineImages::RenderPage(RenderPageArgs& args) {
@@ -322,45 +381,41 @@ bool EngineImages::SaveFileAs(const char* copyFileName, [[maybe_unused]] bool in
     return file::WriteFile(dstPath, d.AsSpan());
 }
 
+// note: unless tryOnly is set, cacheAccess must not be held by the caller
+// (it's released while waiting for a page to load)
 ImagePage* EngineImages::GetPage(int pageNo, bool tryOnly) {
     ScopedCritSec scope(&cacheAccess);
-
-    ImagePage* result = nullptr;
-
-    for (size_t i = 0; i < pageCache.size(); i++) {
-        if (pageCache.at(i)->pageNo == pageNo) {
-            result = pageCache.at(i);
-            break;
-        }
+    CrashIf((pageNo < 1) || (pageNo > pageCount));
+    if (pageCacheByNo.size() == 0) {
+        pageCacheByNo.AppendBlanks(pageCount);
     }
+
+    ImagePage* result = pageCacheByNo.at(pageNo - 1);
     if (!result && tryOnly) {
         return nullptr;
     }
+    if (result && result->isLoading && tryOnly) {
+        return nullptr;
+    }
 
+    if (!tryOnly) {
+        QueueReadAhead(pageNo);
+    }
     if (!result) {
-        // TODO: drop most memory intensive pages first
-        // (i.e. formats which aren't IsGdiPlusNativeFormat)?
-        if (pageCache.size() >= MAX_IMAGE_PAGE_CACHE) {
-            CrashIf(pageCache.size() != MAX_IMAGE_PAGE_CACHE);
-            DropPage(pageCache.Last(), true);
-        }
-        result = new ImagePage(pageNo, nullptr);
-        result->bmp = LoadBitmapForPage(pageNo, result->ownBmp);
-        pageCache.InsertAt(0, result);
-    } else if (result != pageCache.at(0)) {
-        // keep the list Most Recently Used first
-        pageCache.Remove(result);
-        pageCache.InsertAt(0, result);
+        result = LoadPage(pageNo);
     }
-    // return nullptr if a page failed to load
-    if (result && !result->bmp) {
-        return nullptr;
+    result->lastUsed = ++pageUseCount;
+    // the reference also keeps the page from being removed while we wait
+    result->refs++;
+    while (result->isLoading) {
+        SleepConditionVariableCS(&pageLoaded, &cacheAccess, INFINITE);
     }
-    if (!result) {
+
+    // return nullptr if a page failed to load
+    if (!result->bmp) {
+        DropPage(result, false);
         return nullptr;
     }
-
-    result->refs++;
     return result;
 }
 
@@ -369,8 +424,10 @@ void EngineImages::DropPage(ImagePage* page, bool forceRemove) {
     page->refs--;
     CrashIf(page->refs < 0);
 
-    if (0 == page->refs || forceRemove) {
+    if ((0 == page->refs || forceRemove) && pageCacheByNo.at(page->pageNo - 1) == page) {
         pageCache.Remove(page);
+        pageCacheByNo.at(page->pageNo - 1) = nullptr;
+        pageCacheBytes -= page->bytes;
     }
 
     if (0 == page->refs) {
@@ -381,6 +438,141 @@ void EngineImages::DropPage(ImagePage* page, bool forceRemove) {
     }
 }
 
+// GDI+ only decodes most images when they're drawn for the first time,
+// so force decoding while loading instead of while rendering
+static void DecodeBitmap(Bitmap* bmp) {
+    Gdiplus::Rect rect(0, 0, bmp->GetWidth(), bmp->GetHeight());
+    Gdiplus::BitmapData bmpData;
+    if (bmp->LockBits(&rect, Gdiplus::ImageLockModeRead, bmp->GetPixelFormat(), &bmpData) == Ok) {
+        bmp->UnlockBits(&bmpData);
+    }
+}
+
+// adds the page to the cache and loads it. must be called with cacheAccess
+// held (exactly once), which is released while loading if loadsPagesInParallel
+ImagePage* EngineImages::LoadPage(int pageNo) {
+    CrashIf(pageCacheByNo.at(pageNo - 1));
+    ImagePage* page = new ImagePage(pageNo, nullptr);
+    page->isLoading = true;
+    page->lastUsed = ++pageUseCount;
+    pageCache.Append(page);
+    pageCacheByNo.at(pageNo - 1) = page;
+
+    bool ownBmp = true;
+    Bitmap* bmp = nullptr;
+    if (loadsPagesInParallel) {
+        LeaveCriticalSection(&cacheAccess);
+        bmp = LoadBitmapForPage(pageNo, ownBmp);
+        if (bmp) {
+            DecodeBitmap(bmp);
+        }
+        EnterCriticalSection(&cacheAccess);
+    } else {
+        bmp = LoadBitmapForPage(pageNo, ownBmp);
+    }
+
+    page->bmp = bmp;
+    page->ownBmp = ownBmp;
+    if (bmp) {
+        page->bytes = (size_t)bmp->GetWidth() * (size_t)bmp->GetHeight() * 4;
+    }
+    page->isLoading = false;
+    pageCacheBytes += page->bytes;
+    FreeForNewPage(page);
+    WakeAllConditionVariable(&pageLoaded);
+    return page;
+}
+
+// removes the least recently used pages which aren't in use
+// until the cached pages fit into MAX_IMAGE_PAGE_CACHE_BYTES
+void EngineImages::FreeForNewPage(ImagePage* newPage) {
+    while (pageCacheBytes > MAX_IMAGE_PAGE_CACHE_BYTES) {
+        ImagePage* lru = nullptr;
+        for (ImagePage* page : pageCache) {
+            if (page == newPage || page->isLoading || page->refs > 1) {
+                continue;
+            }
+            if (!lru || page->lastUsed < lru->lastUsed) {
+                lru = page;
+            }
+        }
+        if (!lru) {
+            break;
+        }
+        DropPage(lru, true);
+    }
+}
+
+// queues the pages following pageNo in reading direction
+// (as determined by the previously requested page) for decoding
+void EngineImages::QueueReadAhead(int pageNo) {
+    if (!loadsPagesInParallel || stopDecoding || pageNo == lastRequestedPage) {
+        return;
+    }
+    int dir = pageNo < lastRequestedPage ? -1 : 1;
+    lastRequestedPage = pageNo;
+
+    readAheadQueue.Reset();
+    for (int i = 1; i <= IMAGE_READ_AHEAD_PAGES + 1; i++) {
+        // the last page is the one preceding pageNo in reading direction
+        int n = i <= IMAGE_READ_AHEAD_PAGES ? pageNo + i * dir : pageNo - dir;
+        if (n < 1 || n > pageCount) {
+            continue;
+        }
+        ImagePage* page = pageCacheByNo.at(n - 1);
+        if (page) {
+            // keep cached pages which will likely be needed soon
+            page->lastUsed = pageUseCount;
+            continue;
+        }
+        readAheadQueue.Append(n);
+    }
+    if (readAheadQueue.size() == 0) {
+        return;
+    }
+
+    while (nDecodeThreads < MAX_IMAGE_DECODE_THREADS) {
+        decodeThreads[nDecodeThreads++] = CreateThread(nullptr, 0, DecodeThread, this, 0, nullptr);
+    }
+    WakeAllConditionVariable(&readAheadRequested);
+}
+
+void EngineImages::StopReadAhead() {
+    EnterCriticalSection(&cacheAccess);
+    stopDecoding = true;
+    readAheadQueue.Reset();
+    WakeAllConditionVariable(&readAheadRequested);
+    LeaveCriticalSection(&cacheAccess);
+
+    if (nDecodeThreads > 0) {
+        WaitForMultipleObjects(nDecodeThreads, decodeThreads, TRUE, INFINITE);
+    }
+    for (int i = 0; i < nDecodeThreads; i++) {
+        CloseHandle(decodeThreads[i]);
+        decodeThreads[i] = nullptr;
+    }
+    nDecodeThreads = 0;
+}
+
+DWORD WINAPI EngineImages::DecodeThread(LPVOID data) {
+    EngineImages* engine = (EngineImages*)data;
+    ScopedCritSec scope(&engine->cacheAccess);
+    for (;;) {
+        while (!engine->stopDecoding && engine->readAheadQueue.size() == 0) {
+            SleepConditionVariableCS(&engine->readAheadRequested, &engine->cacheAccess, INFINITE);
+        }
+        if (engine->stopDecoding) {
+            break;
+        }
+        int pageNo = engine->readAheadQueue.PopAt(0);
+        // don't evict pages just for reading ahead
+        if (!engine->pageCacheByNo.at(pageNo - 1) && engine->pageCacheBytes < MAX_IMAGE_PAGE_CACHE_BYTES) {
+            engine->LoadPage(pageNo);
+        }
+    }
+    return 0;
+}
+
 ///// ImageEngine handles a single image file /////
 
 class EngineImage : public EngineImages {
@@ -575,7 +767,7 @@ RectF EngineImage::LoadMediabox(int pageNo) {
     }
 
     // fill the cache to prevent the first few frames from being unpacked twice
-    ImagePage* page = GetPage(pageNo, MAX_IMAGE_PAGE_CACHE == pageCache.size());
+    ImagePage* page = GetPage(pageNo, pageCacheBytes >= MAX_IMAGE_PAGE_CACHE_BYTES);
     if (page) {
         RectF mbox(0, 0, (float)page->bmp->GetWidth(), (float)page->bmp->GetHeight());
         DropPage(page, false);
@@ -668,9 +860,11 @@ class EngineImageDir : public EngineImages {
         // TODO: is there a better place to expose pageFileNames
         // than through page labels?
         hasPageLabels = true;
+        loadsPagesInParallel = true;
     }
 
     virtual ~EngineImageDir() {
+        StopReadAhead();
         delete tocTree;
     }
 
@@ -807,7 +1001,18 @@ Bitmap* EngineImageDir::LoadBitmapForPage(int pageNo, bool& deleteAfterUse) {
 }
 
 RectF EngineImageDir::LoadMediabox(int pageNo) {
-    AutoFree bmpData = file::ReadFile(pageFileNames.at(pageNo - 1));
+    const WCHAR* path = pageFileNames.at(pageNo - 1);
+    // the size can usually be determined from the image's header
+    AutoFree header(AllocArray<char>(IMAGE_HEADER_SIZE));
+    int n = header.data ? file::ReadN(path, header.data, IMAGE_HEADER_SIZE) : -1;
+    if (n > 0) {
+        Size size = ImageSizeFromHeader({(u8*)header.data, (size_t)n});
+        if (!size.IsEmpty()) {
+            return RectF(0, 0, (float)size.dx, (float)size.dy);
+        }
+    }
+
+    AutoFree bmpData = file::ReadFile(path);
     if (bmpData.data) {
         std::span<u8> sp{(u8*)bmpData.data, bmpData.size()};
         Size size = BitmapSizeFromData(sp);
@@ -872,8 +1077,12 @@ class EngineCbx : public EngineImages, public json::ValueVisitor {
     static EngineBase* CreateFromFile(const WCHAR* path);
     static EngineBase* CreateFromStream(IStream* stream);
 
-    // an image for each page
+    // the image data for each page, extracted from cbxFile on demand
+    // (data is nullptr if it isn't cached, protected by cacheAccess)
     Vec<ImageData> images;
+    // pages with cached image data, Most Recently Used first
+    Vec<int> cachedImages;
+    size_t cachedImagesBytes = 0;
 
   protected:
     Bitmap* LoadBitmapForPage(int pageNo, bool& deleteAfterUse) override;
@@ -887,6 +1096,7 @@ class EngineCbx : public EngineImages, public json::ValueVisitor {
     void ParseComicInfoXml(std::span<u8> xmlData);
 
     // access to cbxFile must be protected after initialization (with cacheAccess)
+    // it's kept open so that pages can be extracted when they're needed
     MultiFormatArchive* cbxFile = nullptr;
     Vec<MultiFormatArchive::FileInfo*> files;
     TocTree* tocTree = nullptr;
@@ -909,13 +1119,12 @@ class EngineCbx : public EngineImages, public json::ValueVisitor {
 EngineCbx::EngineCbx(MultiFormatArchive* arch) {
     cbxFile = arch;
     kind = kindEngineComicBooks;
+    loadsPagesInParallel = true;
 }
 
 EngineCbx::~EngineCbx() {
+    StopReadAhead();
     delete tocTree;
-
-    // can be set in error conditions but generally is
-    // deleted in FinishLoading
     delete cbxFile;
 
     for (auto&& img : images) {
@@ -1048,7 +1257,7 @@ bool EngineCbx::FinishLoading() {
     TocItem* root = nullptr;
     TocItem* curr = nullptr;
     for (int i = 0; i < pageCount; i++) {
-        std::string_view fname = pageFiles[i]->name;
+        std::string_view fname = files[i]->name;
         AutoFreeWstr name = strconv::Utf8ToWstr(fname);
         const WCHAR* baseName = path::GetBaseNameNoFree(name.Get());
         TocItem* ti = new TocItem(nullptr, baseName, i + 1);
@@ -1062,17 +1271,8 @@ bool EngineCbx::FinishLoading() {
     }
     tocTree = new TocTree(root);
 
-    for (int i = 0; i < pageCount; i++) {
-        size_t fileId = files[i]->fileId;
-        std::span<u8> sv = cbxFile->GetFileDataById(fileId);
-        ImageData img;
-        img.data = (char*)sv.data();
-        img.len = sv.size();
-        images.Append(img);
-    }
-
-    delete cbxFile;
-    cbxFile = nullptr;
+    // pages are only extracted once they're needed (see GetImageData)
+    images.AppendBlanks(nFiles);
 
     return true;
 }
@@ -1081,9 +1281,38 @@ TocTree* EngineCbx::GetToc() {
     return tocTree;
 }
 
+// the returned data is only valid as long as cacheAccess is held
 ImageData EngineCbx::GetImageData(int pageNo) {
     CrashIf((pageNo < 1) || (pageNo > PageCount()));
-    return images[pageNo - 1];
+    ScopedCritSec scope(&cacheAccess);
+
+    ImageData& img = images[pageNo - 1];
+    if (img.data) {
+        // keep the list Most Recently Used first
+        cachedImages.Remove(pageNo);
+        cachedImages.InsertAt(0, pageNo);
+        return img;
+    }
+
+    if (!cbxFile) {
+        return {};
+    }
+    std::span<u8> data = cbxFile->GetFileDataById(files[pageNo - 1]->fileId);
+    if (data.empty()) {
+        return {};
+    }
+
+    while (cachedImages.size() > 0 && cachedImagesBytes + data.size() > MAX_CBX_IMAGE_DATA_CACHE) {
+        ImageData& lru = images[cachedImages.Pop() - 1];
+        cachedImagesBytes -= lru.len;
+        free(lru.data);
+        lru = {};
+    }
+    img.data = (char*)data.data();
+    img.len = data.size();
+    cachedImages.InsertAt(0, pageNo);
+    cachedImagesBytes += img.len;
+    return img;
 }
 
 static char* GetTextContent(HtmlPullParser& parser) {
@@ -1177,6 +1406,7 @@ bool EngineCbx::SaveFileAsPDF(const char* pdfFileName, [[maybe_unused]] bool inc
     bool ok = true;
     PdfCreator* c = new PdfCreator();
     for (int i = 1; i <= PageCount() && ok; i++) {
+        ScopedCritSec scope(&cacheAccess);
         ImageData img = GetImageData(i);
         ok = c->AddPageFromImageData(img.data, img.size(), GetFileDPI());
     }
@@ -1218,29 +1448,48 @@ Bitmap* EngineCbx::LoadBitmapForPage(int pageNo, bool& deleteAfterUse) {
         auto dur = TimeSinceInMs(timeStart);
         logf("EngineCbx::LoadBitmapForPage(page: %d) took %.2f\n", pageNo, dur);
     };
-    ImageData img = GetImageData(pageNo);
-    if (img.data) {
+    // decode a copy so that other pages can be extracted in the meantime
+    AutoFree data;
+    {
+        ScopedCritSec scope(&cacheAccess);
+        ImageData img = GetImageData(pageNo);
+        if (img.data) {
+            data.Set({(u8*)memdup(img.data, img.len), img.len});
+        }
+    }
+    if (data.data) {
         deleteAfterUse = true;
-        return BitmapFromData(img.AsSpan());
+        return BitmapFromData(data.AsSpan());
     }
     return nullptr;
 }
 
 RectF EngineCbx::LoadMediabox(int pageNo) {
-    // fill the cache to prevent the first few images from being unpacked twice
-    ImagePage* page = GetPage(pageNo, MAX_IMAGE_PAGE_CACHE == pageCache.size());
+    ScopedCritSec scope(&cacheAccess);
+
+    ImagePage* page = GetPage(pageNo, true);
     if (page) {
         RectF mbox(0, 0, (float)page->bmp->GetWidth(), (float)page->bmp->GetHeight());
         DropPage(page, false);
         return mbox;
     }
 
-    ImageData img = GetImageData(pageNo);
-    if (img.data) {
-        Size size = BitmapSizeFromData(img.AsSpan());
-        return RectF(0, 0, (float)size.dx, (float)size.dy);
+    // the size can usually be determined from the image's header, so
+    // don't extract (and decompress) the whole image just for that
+    Size size;
+    if (!images[pageNo - 1].data && cbxFile) {
+        AutoFree header = cbxFile->GetFileDataPartById(files[pageNo - 1]->fileId, IMAGE_HEADER_SIZE);
+        if (header.data) {
+            size = ImageSizeFromHeader(header.AsSpan());
+        }
     }
-    return RectF();
+    if (size.IsEmpty()) {
+        ImageData img = GetImageData(pageNo);
+        if (img.data) {
+            size = BitmapSizeFromData(img.AsSpan());
+        }
+    }
+    return RectF(0, 0, (float)size.dx, (float)size.dy);
 }
 
 EngineBase* EngineCbx::CreateFromFile(const WCHAR* path) {
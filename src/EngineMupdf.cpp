@@ -183,9 +183,10 @@ bool EngineMupdf::Load(const WCHAR* filePath, PasswordUI* pwdUI) {
         return false;
     }
 
+    // PDF objects are read in random order, so large files are memory-mapped
     fz_stream* file = nullptr;
     fz_try(ctx) {
-        file = fz_open_file2(ctx, filePath);
+        file = fz_open_file2(ctx, filePath, true);
     }
     fz_catch(ctx) {
         file = nullptr;
@@ -9,6 +9,7 @@ extern "C" {
 #include "utils/BaseUtil.h"
 #include "utils/Archive.h"
 #include "utils/ScopedWin.h"
+#include "utils/CryptoUtil.h"
 #include "utils/FileUtil.h"
 #include "utils/GuessFileType.h"
 #include "utils/HtmlParserLookup.h"
@@ -26,6 +27,7 @@ extern "C" {
 #include "EngineBase.h"
 #include "EngineFzUtil.h"
 #include "EnginePdf.h"
+#include "EnginePdfCache.h"
 
 // in mupdf_load_system_font.c
 extern "C" void drop_cached_fonts_for_ctx(fz_context*);
@@ -33,6 +35,16 @@ extern "C" void pdf_install_load_system_font_funcs(fz_context* ctx);
 
 Kind kindEnginePdf = "enginePdf";
 
+// for documents with more pages, the mediaboxes of all but the first page
+// are only estimated while loading (see EnginePdf::FinishLoading)
+#define MAX_PAGES_WITH_EXACT_MEDIABOXES 1024
+// number of mediaboxes EnginePdf::LoadMediaboxesThread determines before
+// reporting them (ctxAccess is only held for one page at a time)
+#define MEDIABOX_BATCH_SIZE 256
+// page sizes, outline and attachments of documents with at least this many
+// pages are cached on disk (if enabled, see EnginePdfCache.cpp)
+#define MIN_PAGES_FOR_LOAD_CACHE 512
+
 static fz_link* FixupPageLinks(fz_link* root) {
     // Links in PDF documents are added from bottom-most to top-most,
     // i.e. links that appear later in the list should be preferred
@@ -303,6 +315,8 @@ class EnginePdf : public EngineBase {
     EngineBase* Clone() override;
 
     RectF PageMediabox(int pageNo) override;
+    RectF PageMediaboxEstimate(int pageNo) override;
+    bool LoadMediaboxesAsync(const MediaboxesLoadedCb& onLoaded) override;
     RectF PageContentBox(int pageNo, RenderTarget target = RenderTarget::View) override;
 
     RenderedBitmap* RenderPage(RenderPageArgs& args) override;
@@ -336,7 +350,11 @@ class EnginePdf : public EngineBase {
 
     // make sure to never ask for pagesAccess in an ctxAccess
     // protected critical section in order to avoid deadlocks
+    // ctxAccess guards ctx and _doc. It's deliberately not one of mupdf's
+    // own locks so that RenderPage() can rasterize with a cloned context
+    // on several threads without waiting for it
     CRITICAL_SECTION* ctxAccess;
+    CRITICAL_SECTION docAccess;
     CRITICAL_SECTION pagesAccess;
 
     CRITICAL_SECTION mutexes[FZ_LOCK_MAX];
@@ -355,17 +373,42 @@ class EnginePdf : public EngineBase {
 
     TocTree* tocTree = nullptr;
 
+    // pages with a cached display list in FzPageInfo::list,
+    // least recently used first (protected by ctxAccess)
+    Vec<FzPageInfo*> cachedPageLists;
+    size_t cachedPageListsSize = 0;
+
+    // the mediabox used for pages with FzPageInfo::isMediaboxEstimate
+    RectF mediaboxEstimate;
+    HANDLE mediaboxThread = nullptr;
+    // set (with InterlockedExchange) to stop LoadMediaboxesThread
+    LONG stopLoadingMediaboxes = 0;
+    MediaboxesLoadedCb mediaboxesLoadedCb;
+
+    // set if what FinishLoading determines may be cached on disk
+    WCHAR* loadCacheDir = nullptr;
+    // hash of the trailer's ID (identifies the document in the cache)
+    u8 docId[16]{};
+    bool loadedFromCache = false;
+
     bool Load(const WCHAR* filePath, PasswordUI* pwdUI = nullptr);
     bool Load(IStream* stream, PasswordUI* pwdUI = nullptr);
     // TODO(port): fz_stream can no-longer be re-opened (fz_clone_stream)
     // bool Load(fz_stream* stm, PasswordUI* pwdUI = nullptr);
     bool LoadFromStream(fz_stream* stm, PasswordUI* pwdUI = nullptr);
     bool FinishLoading();
+    void LoadMediabox(FzPageInfo* pageInfo);
+    static DWORD WINAPI LoadMediaboxesThread(LPVOID data);
+    void SaveLoadCache();
 
     FzPageInfo* GetFzPageInfoFast(int pageNo);
     FzPageInfo* GetFzPageInfo(int pageNo, bool loadQuick);
     fz_matrix viewctm(int pageNo, float zoom, int rotation);
     fz_matrix viewctm(fz_page* page, float zoom, int rotation);
+    fz_display_list* GetPageContentList(FzPageInfo* pageInfo, fz_cookie* cookie);
+    void DropPageContentList(FzPageInfo* pageInfo);
+    void RunPage(FzPageInfo* pageInfo, fz_device* dev, fz_matrix ctm, fz_cookie* cookie);
+    fz_stext_page* NewStextPage(FzPageInfo* pageInfo, fz_stext_options* opts);
     TocItem* BuildTocTree(TocItem* parent, fz_outline* outline, int& idCounter, bool isAttachment);
     WCHAR* ExtractFontList();
 
@@ -414,7 +457,8 @@ EnginePdf::EnginePdf() {
         InitializeCriticalSection(&mutexes[i]);
     }
     InitializeCriticalSection(&pagesAccess);
-    ctxAccess = &mutexes[FZ_LOCK_ALLOC];
+    InitializeCriticalSection(&docAccess);
+    ctxAccess = &docAccess;
 
     fz_locks_ctx.user = this;
     fz_locks_ctx.lock = fz_lock_context_cs;
@@ -426,12 +470,21 @@ EnginePdf::EnginePdf() {
 }
 
 EnginePdf::~EnginePdf() {
+    if (mediaboxThread) {
+        InterlockedExchange(&stopLoadingMediaboxes, 1);
+        WaitForSingleObject(mediaboxThread, INFINITE);
+        CloseHandle(mediaboxThread);
+    }
+
     EnterCriticalSection(&pagesAccess);
 
     // TODO: remove this lock and see what happens
     EnterCriticalSection(ctxAccess);
 
     for (auto* pi : _pages) {
+        if (pi->list) {
+            fz_drop_display_list(ctx, pi->list);
+        }
         if (pi->links) {
             fz_drop_link(ctx, pi->links);
         }
@@ -454,11 +507,13 @@ EnginePdf::~EnginePdf() {
 
     delete _pageLabels;
     delete tocTree;
+    free(loadCacheDir);
 
     for (size_t i = 0; i < dimof(mutexes); i++) {
-        LeaveCriticalSection(&mutexes[i]);
         DeleteCriticalSection(&mutexes[i]);
     }
+    LeaveCriticalSection(ctxAccess);
+    DeleteCriticalSection(ctxAccess);
     LeaveCriticalSection(&pagesAccess);
     DeleteCriticalSection(&pagesAccess);
 }
@@ -594,9 +649,10 @@ bool EnginePdf::Load(const WCHAR* filePath, PasswordUI* pwdUI) {
     int streamNo = -1;
     AutoFreeWstr fnCopy = ParseEmbeddedStreamNumber(filePath, &streamNo);
 
+    // PDF objects are read in random order, so large files are memory-mapped
     fz_stream* file = nullptr;
     fz_try(ctx) {
-        file = fz_open_file2(ctx, fnCopy);
+        file = fz_open_file2(ctx, fnCopy, true);
     }
     fz_catch(ctx) {
         file = nullptr;
@@ -607,6 +663,7 @@ bool EnginePdf::Load(const WCHAR* filePath, PasswordUI* pwdUI) {
     }
 
     if (streamNo < 0) {
+        loadCacheDir = GetPdfLoadCacheDir();
         return FinishLoading();
     }
 
@@ -799,48 +856,78 @@ bool EnginePdf::FinishLoading() {
 
     ScopedCritSec scope(ctxAccess);
 
-    // this does the job of pdf_bound_page but without doing pdf_load_page()
-    // TODO: time pdf_load_page(), maybe it's not slow?
-    for (int i = 0; i < pageCount; i++) {
-        fz_rect mbox{};
-        fz_matrix page_ctm{};
-
+    // small documents are loaded quickly anyway and the outlines
+    // of password protected documents shouldn't end up on disk
+    if (pageCount < MIN_PAGES_FOR_LOAD_CACHE || isPasswordProtected) {
+        str::ReplacePtr(&loadCacheDir, nullptr);
+    }
+    RectF* cachedMediaboxes = nullptr;
+    if (loadCacheDir) {
+        str::Str id;
         fz_try(ctx) {
-            pdf_obj* pageref = pdf_lookup_page_obj(ctx, doc, i);
-            pdf_page_obj_transform(ctx, pageref, &mbox, &page_ctm);
-            mbox = fz_transform_rect(mbox, page_ctm);
+            pdf_obj* ids = pdf_dict_gets(ctx, pdf_trailer(ctx, doc), "ID");
+            for (int i = 0; i < pdf_array_len(ctx, ids); i++) {
+                pdf_obj* s = pdf_array_get(ctx, ids, i);
+                id.Append(pdf_to_str_buf(ctx, s), pdf_to_str_len(ctx, s));
+            }
+            CalcMD5Digest((const u8*)id.Get(), id.size(), docId);
         }
         fz_catch(ctx) {
+            str::ReplacePtr(&loadCacheDir, nullptr);
         }
-        if (fz_is_empty_rect(mbox)) {
-            fz_warn(ctx, "cannot find page size for page %d", i);
-            mbox.x0 = 0;
-            mbox.y0 = 0;
-            mbox.x1 = 612;
-            mbox.y1 = 792;
-        }
+    }
+    if (loadCacheDir) {
+        cachedMediaboxes = AllocArray<RectF>(pageCount);
+        loadedFromCache = LoadPdfLoadCache(loadCacheDir, FileName(), docId, pageCount, ctx, cachedMediaboxes,
+                                           &outline, &attachments);
+    }
+
+    // looking up the mediaboxes of all pages takes too long for documents
+    // with very many pages, so the size of the first page is used for all
+    // others until their mediabox is needed (see PageMediabox)
+    // or has been determined in the background (see LoadMediaboxesAsync)
+    bool estimateMediaboxes = pageCount > MAX_PAGES_WITH_EXACT_MEDIABOXES && !loadedFromCache;
+    for (int i = 0; i < pageCount; i++) {
         FzPageInfo* pageInfo = new FzPageInfo();
-        pageInfo->mediabox = ToRectFl(mbox);
         pageInfo->pageNo = i + 1;
+        pageInfo->mediabox = mediaboxEstimate;
+        pageInfo->isMediaboxEstimate = TRUE;
+        if (loadedFromCache) {
+            pageInfo->mediabox = cachedMediaboxes[i];
+            pageInfo->isMediaboxEstimate = FALSE;
+        } else if (i == 0 || !estimateMediaboxes) {
+            LoadMediabox(pageInfo);
+        }
+        if (i == 0) {
+            mediaboxEstimate = pageInfo->mediabox;
+        }
         _pages.Append(pageInfo);
     }
+    free(cachedMediaboxes);
 
-    fz_try(ctx) {
-        outline = fz_load_outline(ctx, _doc);
-    }
-    fz_catch(ctx) {
-        // ignore errors from pdf_load_outline()
-        // this information is not critical and checking the
-        // error might prevent loading some pdfs that would
-        // otherwise get displayed
-        fz_warn(ctx, "Couldn't load outline");
-    }
+    if (!loadedFromCache) {
+        fz_try(ctx) {
+            outline = fz_load_outline(ctx, _doc);
+        }
+        fz_catch(ctx) {
+            // ignore errors from pdf_load_outline()
+            // this information is not critical and checking the
+            // error might prevent loading some pdfs that would
+            // otherwise get displayed
+            fz_warn(ctx, "Couldn't load outline");
+        }
 
-    fz_try(ctx) {
-        attachments = pdf_load_attachments(ctx, doc);
+        fz_try(ctx) {
+            attachments = pdf_load_attachments(ctx, doc);
+        }
+        fz_catch(ctx) {
+            fz_warn(ctx, "Couldn't load attachments");
+        }
     }
-    fz_catch(ctx) {
-        fz_warn(ctx, "Couldn't load attachments");
+
+    // with estimated mediaboxes, the cache is saved by LoadMediaboxesThread
+    if (loadCacheDir && !loadedFromCache && !estimateMediaboxes) {
+        SaveLoadCache();
     }
 
     pdf_obj* orig_info = nullptr;
@@ -1195,15 +1282,9 @@ FzPageInfo* EnginePdf::GetFzPageInfo(int pageNo, bool loadQuick) {
 
     pageInfo->fullyLoaded = true;
 
-    fz_stext_page* stext = nullptr;
-    fz_var(stext);
     fz_stext_options opts{};
     opts.flags = FZ_STEXT_PRESERVE_IMAGES;
-    fz_try(ctx) {
-        stext = fz_new_stext_page_from_page(ctx, page, &opts);
-    }
-    fz_catch(ctx) {
-    }
+    fz_stext_page* stext = NewStextPage(pageInfo, &opts);
 
     auto links = fz_load_links(ctx, page);
 
@@ -1219,11 +1300,213 @@ FzPageInfo* EnginePdf::GetFzPageInfo(int pageNo, bool loadQuick) {
     return pageInfo;
 }
 
+// returns a display list of the page content (without annotations which
+// might get modified), re-using a cached one if possible.
+// The caller must fz_drop_display_list() it.
+// Note: make sure to only call with ctxAccess
+fz_display_list* EnginePdf::GetPageContentList(FzPageInfo* pageInfo, fz_cookie* cookie) {
+    if (pageInfo->list) {
+        cachedPageLists.Remove(pageInfo);
+        cachedPageLists.Append(pageInfo);
+        return fz_keep_display_list(ctx, pageInfo->list);
+    }
+
+    fz_page* page = pageInfo->page;
+    fz_display_list* list = nullptr;
+    fz_device* dev = nullptr;
+    fz_var(list);
+    fz_var(dev);
+    fz_try(ctx) {
+        list = fz_new_display_list(ctx, fz_bound_page(ctx, page));
+        dev = fz_new_list_device(ctx, list);
+        pdf_run_page_contents(ctx, pdf_page_from_fz_page(ctx, page), dev, fz_identity, cookie);
+        fz_close_device(ctx, dev);
+    }
+    fz_always(ctx) {
+        fz_drop_device(ctx, dev);
+    }
+    fz_catch(ctx) {
+        fz_drop_display_list(ctx, list);
+        return nullptr;
+    }
+
+    // an aborted list is incomplete and must not be re-used
+    bool wasAborted = cookie && cookie->abort;
+    size_t size = fz_display_list_size(ctx, list);
+    if (wasAborted || size > MAX_PAGE_RUN_MEMORY) {
+        return list;
+    }
+
+    // evict least recently used lists until the new one fits
+    while (cachedPageListsSize + size > MAX_PAGE_RUN_MEMORY && cachedPageLists.size() > 0) {
+        DropPageContentList(cachedPageLists.at(0));
+    }
+    pageInfo->list = fz_keep_display_list(ctx, list);
+    pageInfo->listSize = size;
+    cachedPageListsSize += size;
+    cachedPageLists.Append(pageInfo);
+    return list;
+}
+
+// Note: make sure to only call with ctxAccess
+void EnginePdf::DropPageContentList(FzPageInfo* pageInfo) {
+    if (!pageInfo->list) {
+        return;
+    }
+    fz_drop_display_list(ctx, pageInfo->list);
+    pageInfo->list = nullptr;
+    cachedPageListsSize -= pageInfo->listSize;
+    pageInfo->listSize = 0;
+    cachedPageLists.Remove(pageInfo);
+}
+
+// runs the (cached) page content followed by annotations and widgets
+// Note: make sure to only call with ctxAccess
+void EnginePdf::RunPage(FzPageInfo* pageInfo, fz_device* dev, fz_matrix ctm, fz_cookie* cookie) {
+    fz_display_list* list = GetPageContentList(pageInfo, cookie);
+    if (!list) {
+        fz_throw(ctx, FZ_ERROR_GENERIC, "cannot load content of page %d", pageInfo->pageNo);
+    }
+    fz_try(ctx) {
+        fz_run_display_list(ctx, list, dev, ctm, fz_infinite_rect, cookie);
+        pdf_page* pdfpage = pdf_page_from_fz_page(ctx, pageInfo->page);
+        pdf_run_page_annots(ctx, pdfpage, dev, ctm, cookie);
+        pdf_run_page_widgets(ctx, pdfpage, dev, ctm, cookie);
+    }
+    fz_always(ctx) {
+        fz_drop_display_list(ctx, list);
+    }
+    fz_catch(ctx) {
+        fz_rethrow(ctx);
+    }
+}
+
+// extracts text of the page content, annotations and widgets like
+// fz_new_stext_page_from_page() but re-using the cached display list
+// Note: make sure to only call with ctxAccess
+fz_stext_page* EnginePdf::NewStextPage(FzPageInfo* pageInfo, fz_stext_options* opts) {
+    fz_stext_page* stext = nullptr;
+    fz_device* dev = nullptr;
+    fz_var(stext);
+    fz_var(dev);
+    fz_try(ctx) {
+        stext = fz_new_stext_page(ctx, fz_bound_page(ctx, pageInfo->page));
+        dev = fz_new_stext_device(ctx, stext, opts);
+        RunPage(pageInfo, dev, fz_identity, nullptr);
+        fz_close_device(ctx, dev);
+    }
+    fz_always(ctx) {
+        fz_drop_device(ctx, dev);
+    }
+    fz_catch(ctx) {
+        fz_drop_stext_page(ctx, stext);
+        stext = nullptr;
+    }
+    return stext;
+}
+
+// this does the job of pdf_bound_page but without doing pdf_load_page()
+// note: make sure to only call with ctxAccess
+void EnginePdf::LoadMediabox(FzPageInfo* pageInfo) {
+    if (!pageInfo->isMediaboxEstimate) {
+        return;
+    }
+    pdf_document* doc = (pdf_document*)_doc;
+    int pageIdx = pageInfo->pageNo - 1;
+    fz_rect mbox{};
+    fz_matrix page_ctm{};
+
+    fz_try(ctx) {
+        pdf_obj* pageref = pdf_lookup_page_obj(ctx, doc, pageIdx);
+        pdf_page_obj_transform(ctx, pageref, &mbox, &page_ctm);
+        mbox = fz_transform_rect(mbox, page_ctm);
+    }
+    fz_catch(ctx) {
+    }
+    if (fz_is_empty_rect(mbox)) {
+        fz_warn(ctx, "cannot find page size for page %d", pageIdx);
+        mbox.x0 = 0;
+        mbox.y0 = 0;
+        mbox.x1 = 612;
+        mbox.y1 = 792;
+    }
+    pageInfo->mediabox = ToRectFl(mbox);
+    // publishes mediabox to readers without ctxAccess (see PageMediabox)
+    InterlockedExchange(&pageInfo->isMediaboxEstimate, FALSE);
+}
+
 RectF EnginePdf::PageMediabox(int pageNo) {
     FzPageInfo* pi = _pages[pageNo - 1];
+    if (InterlockedAdd(&pi->isMediaboxEstimate, 0)) {
+        ScopedCritSec scope(ctxAccess);
+        LoadMediabox(pi);
+    }
     return pi->mediabox;
 }
 
+RectF EnginePdf::PageMediaboxEstimate(int pageNo) {
+    FzPageInfo* pi = _pages[pageNo - 1];
+    // mediabox might be being determined by LoadMediaboxesThread
+    if (InterlockedAdd(&pi->isMediaboxEstimate, 0)) {
+        return mediaboxEstimate;
+    }
+    return pi->mediabox;
+}
+
+bool EnginePdf::LoadMediaboxesAsync(const MediaboxesLoadedCb& onLoaded) {
+    if (pageCount <= MAX_PAGES_WITH_EXACT_MEDIABOXES || loadedFromCache || mediaboxThread) {
+        return false;
+    }
+    mediaboxesLoadedCb = onLoaded;
+    mediaboxThread = CreateThread(nullptr, 0, LoadMediaboxesThread, this, 0, nullptr);
+    return mediaboxThread != nullptr;
+}
+
+DWORD WINAPI EnginePdf::LoadMediaboxesThread(LPVOID data) {
+    EnginePdf* e = (EnginePdf*)data;
+    int pageCount = e->pageCount;
+    auto wasStopped = [e]() { return InterlockedAdd(&e->stopLoadingMediaboxes, 0) > 0; };
+    for (int start = 2; start <= pageCount && !wasStopped(); start += MEDIABOX_BATCH_SIZE) {
+        int end = std::min(start + MEDIABOX_BATCH_SIZE - 1, pageCount);
+        int firstChanged = 0, lastChanged = 0;
+        for (int pageNo = start; pageNo <= end && !wasStopped(); pageNo++) {
+            FzPageInfo* pi = e->_pages[pageNo - 1];
+            // lock for every page, so that rendering and PageMediabox
+            // never have to wait for more than a single page
+            if (InterlockedAdd(&pi->isMediaboxEstimate, 0)) {
+                ScopedCritSec scope(e->ctxAccess);
+                e->LoadMediabox(pi);
+            }
+            // also report pages whose mediabox has been loaded by PageMediabox
+            if (pi->mediabox != e->mediaboxEstimate) {
+                if (!firstChanged) {
+                    firstChanged = pageNo;
+                }
+                lastChanged = pageNo;
+            }
+        }
+        if (firstChanged && !wasStopped()) {
+            e->mediaboxesLoadedCb(firstChanged, lastChanged);
+        }
+    }
+    if (e->loadCacheDir && !wasStopped()) {
+        e->SaveLoadCache();
+    }
+    return 0;
+}
+
+// all mediaboxes must have been determined
+// note: outline and attachments are no longer modified once loaded
+void EnginePdf::SaveLoadCache() {
+    RectF* mediaboxes = AllocArray<RectF>(pageCount);
+    for (int i = 0; i < pageCount; i++) {
+        CrashIf(_pages[i]->isMediaboxEstimate);
+        mediaboxes[i] = _pages[i]->mediabox;
+    }
+    SavePdfLoadCache(loadCacheDir, FileName(), docId, pageCount, mediaboxes, outline, attachments);
+    free(mediaboxes);
+}
+
 RectF EnginePdf::PageContentBox(int pageNo, RenderTarget target) {
     FzPageInfo* pageInfo = GetFzPageInfo(pageNo, false);
 
@@ -1232,26 +1515,18 @@ RectF EnginePdf::PageContentBox(int pageNo, RenderTarget target) {
     fz_cookie fzcookie = {};
     fz_rect rect = fz_empty_rect;
     fz_device* dev = nullptr;
-    fz_display_list* list = nullptr;
-
-    fz_rect pagerect = fz_bound_page(ctx, pageInfo->page);
 
     fz_var(dev);
-    fz_var(list);
 
-    RectF mediabox = pageInfo->mediabox;
+    RectF mediabox = PageMediabox(pageNo);
 
     fz_try(ctx) {
-        list = fz_new_display_list_from_page(ctx, pageInfo->page);
         dev = fz_new_bbox_device(ctx, &rect);
-        fz_run_display_list(ctx, list, dev, fz_identity, pagerect, &fzcookie);
+        RunPage(pageInfo, dev, fz_identity, &fzcookie);
         fz_close_device(ctx, dev);
     }
     fz_always(ctx) {
         fz_drop_device(ctx, dev);
-        if (list) {
-            fz_drop_display_list(ctx, list);
-        }
     }
     fz_catch(ctx) {
         return mediabox;
@@ -1285,6 +1560,37 @@ RectF EnginePdf::Transform(const RectF& rect, int pageNo, float zoom, int rotati
     return ToRectFl(rect2);
 }
 
+// records the page into a display list (or only its annotations and widgets if annotsOnly).
+// Must be called within ctxAccess as interpreting the page touches the shared document
+static fz_display_list* NewDisplayListForPage(fz_context* ctx, fz_document* doc, fz_page* page, const char* usage,
+                                              bool annotsOnly, fz_cookie* cookie) {
+    fz_display_list* list = nullptr;
+    fz_device* dev = nullptr;
+    fz_var(list);
+    fz_var(dev);
+    fz_try(ctx) {
+        list = fz_new_display_list(ctx, fz_bound_page(ctx, page));
+        dev = fz_new_list_device(ctx, list);
+        pdf_document* pdfdoc = pdf_document_from_fz_document(ctx, doc);
+        pdf_page* pdfpage = pdf_page_from_fz_page(ctx, page);
+        if (annotsOnly) {
+            pdf_run_page_annots(ctx, pdfpage, dev, fz_identity, cookie);
+            pdf_run_page_widgets(ctx, pdfpage, dev, fz_identity, cookie);
+        } else {
+            pdf_run_page_with_usage(ctx, pdfdoc, pdfpage, dev, fz_identity, usage, cookie);
+        }
+        fz_close_device(ctx, dev);
+    }
+    fz_always(ctx) {
+        fz_drop_device(ctx, dev);
+    }
+    fz_catch(ctx) {
+        fz_drop_display_list(ctx, list);
+        list = nullptr;
+    }
+    return list;
+}
+
 RenderedBitmap* EnginePdf::RenderPage(RenderPageArgs& args) {
     auto pageNo = args.pageNo;
 
@@ -1293,7 +1599,6 @@ RenderedBitmap* EnginePdf::RenderPage(RenderPageArgs& args) {
         return nullptr;
     }
     fz_page* page = pageInfo->page;
-    pdf_page* pdfpage = pdf_page_from_fz_page(ctx, page);
 
     fz_cookie* fzcookie = nullptr;
     FitzAbortCookie* cookie = nullptr;
@@ -1303,23 +1608,52 @@ RenderedBitmap* EnginePdf::RenderPage(RenderPageArgs& args) {
         fzcookie = &cookie->cookie;
     }
 
-    // TODO(port): I don't see why this lock is needed
-    ScopedCritSec cs(ctxAccess);
+    const char* usage = "View";
+    switch (args.target) {
+        case RenderTarget::Print:
+            usage = "Print";
+            break;
+    }
 
     auto pageRect = args.pageRect;
     auto zoom = args.zoom;
     auto rotation = args.rotation;
+
+    // when viewing, the page content comes from the cached display list and
+    // only the annotations (which might have been modified) are recorded anew
+    fz_display_list* lists[2]{};
     fz_rect pRect;
-    if (pageRect) {
-        pRect = To_fz_rect(*pageRect);
-    } else {
+    fz_matrix ctm;
+    fz_context* renderCtx = nullptr;
+    {
+        ScopedCritSec cs(ctxAccess);
+        fz_rect bounds = fz_bound_page(ctx, page);
         // TODO(port): use pageInfo->mediabox?
-        pRect = fz_bound_page(ctx, page);
+        pRect = pageRect ? To_fz_rect(*pageRect) : bounds;
+        ctm = fz_create_view_ctm(bounds, zoom, rotation);
+        if (args.target == RenderTarget::View) {
+            lists[0] = GetPageContentList(pageInfo, fzcookie);
+            lists[1] = NewDisplayListForPage(ctx, _doc, page, usage, true, fzcookie);
+        } else {
+            lists[0] = NewDisplayListForPage(ctx, _doc, page, usage, false, fzcookie);
+        }
+        // each rendering thread gets its own context sharing the store,
+        // font and glyph caches of ctx (protected by mupdf's fine-grained locks)
+        if (lists[0]) {
+            renderCtx = fz_clone_context(ctx);
+        }
+        if (!renderCtx) {
+            fz_drop_display_list(ctx, lists[0]);
+            fz_drop_display_list(ctx, lists[1]);
+            return nullptr;
+        }
     }
-    fz_matrix ctm = viewctm(page, zoom, rotation);
+
+    // rasterizing the display list doesn't touch the document
+    // so we don't need ctxAccess for the expensive part
     fz_irect bbox = fz_round_rect(fz_transform_rect(pRect, ctm));
 
-    fz_colorspace* colorspace = fz_device_rgb(ctx);
+    fz_colorspace* colorspace = fz_device_rgb(renderCtx);
     fz_irect ibounds = bbox;
     fz_rect cliprect = fz_rect_from_irect(bbox);
 
@@ -1331,35 +1665,30 @@ RenderedBitmap* EnginePdf::RenderPage(RenderPageArgs& args) {
     fz_var(pix);
     fz_var(bitmap);
 
-    const char* usage = "View";
-    switch (args.target) {
-        case RenderTarget::Print:
-            usage = "Print";
-            break;
-    }
-
-    fz_try(ctx) {
-        pix = fz_new_pixmap_with_bbox(ctx, colorspace, ibounds, nullptr, 1);
+    fz_try(renderCtx) {
+        pix = fz_new_pixmap_with_bbox(renderCtx, colorspace, ibounds, nullptr, 1);
         // initialize with white background
-        fz_clear_pixmap_with_value(ctx, pix, 0xff);
-        // TODO: in printing different style. old code use pdf_run_page_with_usage(), with usage ="View"
-        // or "Print". "Export" is not used
-        dev = fz_new_draw_device(ctx, fz_identity, pix);
-        pdf_document* doc = pdf_document_from_fz_document(ctx, _doc);
-        pdf_run_page_with_usage(ctx, doc, pdfpage, dev, ctm, usage, fzcookie);
-        bitmap = new_rendered_fz_pixmap(ctx, pix);
-        fz_close_device(ctx, dev);
-    }
-    fz_always(ctx) {
-        if (dev) {
-            fz_drop_device(ctx, dev);
+        fz_clear_pixmap_with_value(renderCtx, pix, 0xff);
+        dev = fz_new_draw_device(renderCtx, fz_identity, pix);
+        for (fz_display_list* list : lists) {
+            if (list) {
+                fz_run_display_list(renderCtx, list, dev, ctm, cliprect, fzcookie);
+            }
         }
-        fz_drop_pixmap(ctx, pix);
+        fz_close_device(renderCtx, dev);
+        bitmap = new_rendered_fz_pixmap(renderCtx, pix);
     }
-    fz_catch(ctx) {
+    fz_always(renderCtx) {
+        fz_drop_device(renderCtx, dev);
+        fz_drop_pixmap(renderCtx, pix);
+        fz_drop_display_list(renderCtx, lists[0]);
+        fz_drop_display_list(renderCtx, lists[1]);
+    }
+    fz_catch(renderCtx) {
         delete bitmap;
-        return nullptr;
+        bitmap = nullptr;
     }
+    fz_drop_context(renderCtx);
     return bitmap;
 }
 
@@ -1455,14 +1784,8 @@ PageText EnginePdf::ExtractPageText(int pageNo) {
 
     ScopedCritSec scope(ctxAccess);
 
-    fz_stext_page* stext = nullptr;
-    fz_var(stext);
     fz_stext_options opts{};
-    fz_try(ctx) {
-        stext = fz_new_stext_page_from_page(ctx, pageInfo->page, &opts);
-    }
-    fz_catch(ctx) {
-    }
+    fz_stext_page* stext = NewStextPage(pageInfo, &opts);
     if (!stext) {
         return {};
     }
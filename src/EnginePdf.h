@@ -12,3 +12,13 @@ int EnginePdfGetAnnotations(EngineBase*, Vec<Annotation*>*);
 bool EnginePdfHasUnsavedAnnotations(EngineBase* engine);
 bool EnginePdfSaveUpdated(EngineBase* engine, std::string_view path);
 Annotation* EnginePdfGetAnnotationAtPos(EngineBase* engine, int pageNo, PointF pos, AnnotationType* allowedAnnots);
+
+// if dir is set, the page sizes and outlines of large documents are cached
+// there so that they're re-opened faster (dir == nullptr disables the cache)
+void SetPdfLoadCacheDir(const WCHAR* dir);
+// removes the least recently used cache files if they take up too much
+// space on disk (or all of them if deleteAll is set)
+void CleanUpPdfLoadCache(bool deleteAll = false);
+
+// if enable is set, large files are memory-mapped when loaded (see fz_open_file2)
+void SetMapLargeFiles(bool enable);
@@ -0,0 +1,293 @@
+/* Copyright 2020 the SumatraPDF project authors (see AUTHORS file).
+   License: GPLv3 */
+
+extern "C" {
+#include <mupdf/fitz.h>
+}
+
+#include "utils/BaseUtil.h"
+#include "utils/ScopedWin.h"
+#include "utils/CryptoUtil.h"
+#include "utils/FileUtil.h"
+
+#include "EnginePdfCache.h"
+
+#include "utils/Log.h"
+
+#define PDF_CACHE_EXT L".pdfcache"
+#define PDF_CACHE_MAGIC 0x43504453 // 'SDPC'
+#define PDF_CACHE_VERSION 1
+// outlines nested more deeply aren't cached
+#define MAX_OUTLINE_DEPTH 64
+// cache files are removed (least recently used first) above this total size
+#define MAX_PDF_CACHE_SIZE (64 * 1024 * 1024)
+
+/* The file consists of a PdfCacheHeader, the mediabox (a RectF) of every
+   page, a PdfCacheItem for every item of the outline and for every
+   attachment (both in depth-first order) and the strings referenced by
+   the items (zero-terminated UTF-8). */
+struct PdfCacheHeader {
+    u32 magic;
+    u32 version;
+    u64 fileSize;
+    u64 modificationTime;
+    // hash of the document's trailer ID
+    u8 docId[16];
+    u32 nPages;
+    u32 nOutlineItems;
+    u32 nAttachments;
+    u32 stringsSize;
+    u32 reserved[2];
+};
+
+struct PdfCacheItem {
+    // offset of the string within the strings + 1 (0 for nullptr)
+    u32 title;
+    u32 uri;
+    i32 page;
+    float x;
+    float y;
+    u16 depth;
+    u8 isOpen;
+    u8 nColor;
+    i32 flags;
+    float color[4];
+};
+
+static_assert(sizeof(PdfCacheHeader) == 64, "unexpected PdfCacheHeader size");
+static_assert(sizeof(PdfCacheItem) == 44, "unexpected PdfCacheItem size");
+static_assert(sizeof(RectF) == 4 * sizeof(float), "unexpected RectF size");
+
+// set on the UI thread but read by EnginePdf::Load, which also runs on
+// other threads (e.g. when cloning engines for printing)
+static WCHAR* gPdfCacheDir = nullptr;
+
+static CRITICAL_SECTION* GetPdfCacheDirAccess() {
+    static CRITICAL_SECTION access;
+    [[maybe_unused]] static bool initialized = (InitializeCriticalSection(&access), true);
+    return &access;
+}
+
+void SetPdfLoadCacheDir(const WCHAR* dir) {
+    ScopedCritSec scope(GetPdfCacheDirAccess());
+    str::ReplacePtr(&gPdfCacheDir, dir);
+}
+
+WCHAR* GetPdfLoadCacheDir() {
+    ScopedCritSec scope(GetPdfCacheDirAccess());
+    return str::Dup(gPdfCacheDir);
+}
+
+static bool GetFileSizeAndTime(const WCHAR* filePath, u64* sizeOut, u64* timeOut) {
+    WIN32_FILE_ATTRIBUTE_DATA fad{};
+    if (!filePath || !GetFileAttributesExW(filePath, GetFileExInfoStandard, &fad)) {
+        return false;
+    }
+    *sizeOut = ((u64)fad.nFileSizeHigh << 32) | fad.nFileSizeLow;
+    *timeOut = ((u64)fad.ftLastWriteTime.dwHighDateTime << 32) | fad.ftLastWriteTime.dwLowDateTime;
+    return true;
+}
+
+static WCHAR* GetPdfCachePath(const WCHAR* cacheDir, const WCHAR* filePath) {
+    AutoFreeWstr key(str::Dup(filePath));
+    str::ToLowerInPlace(key);
+    u8 digest[16];
+    CalcMD5Digest((const u8*)key.Get(), str::Len(key) * sizeof(WCHAR), digest);
+    AutoFree hex(str::MemToHex(digest, dimof(digest)));
+    AutoFreeWstr fname(strconv::FromAnsi(hex.Get()));
+    return str::Format(L"%s\\%s%s", cacheDir, fname.Get(), PDF_CACHE_EXT);
+}
+
+static const char* GetItemString(const char* strings, u32 stringsSize, u32 offset) {
+    if (offset == 0 || offset > stringsSize) {
+        return nullptr;
+    }
+    return strings + offset - 1;
+}
+
+// the items have already been validated
+static fz_outline* BuildOutline(fz_context* ctx, const PdfCacheItem* items, int nItems, const char* strings,
+                                u32 stringsSize) {
+    fz_outline* root = nullptr;
+    // the most recent item at every depth
+    fz_outline* last[MAX_OUTLINE_DEPTH + 1]{};
+
+    fz_var(root);
+    fz_try(ctx) {
+        for (int i = 0; i < nItems; i++) {
+            const PdfCacheItem* it = &items[i];
+            fz_outline* item = fz_new_outline(ctx);
+            // link the item first, so that it's dropped along with root
+            if (last[it->depth]) {
+                last[it->depth]->next = item;
+            } else if (it->depth > 0) {
+                last[it->depth - 1]->down = item;
+            } else {
+                root = item;
+            }
+            last[it->depth] = item;
+            last[it->depth + 1] = nullptr;
+
+            const char* title = GetItemString(strings, stringsSize, it->title);
+            const char* uri = GetItemString(strings, stringsSize, it->uri);
+            item->title = title ? fz_strdup(ctx, title) : nullptr;
+            item->uri = uri ? fz_strdup(ctx, uri) : nullptr;
+            item->page = it->page;
+            item->x = it->x;
+            item->y = it->y;
+            item->is_open = it->isOpen;
+            item->flags = it->flags;
+            item->n_color = it->nColor;
+            memcpy(item->color, it->color, sizeof(item->color));
+        }
+    }
+    fz_catch(ctx) {
+        fz_drop_outline(ctx, root);
+        return nullptr;
+    }
+    return root;
+}
+
+static bool IsValidOutline(const PdfCacheItem* items, int nItems, u32 stringsSize) {
+    int prevDepth = -1;
+    for (int i = 0; i < nItems; i++) {
+        const PdfCacheItem* it = &items[i];
+        if (it->depth > prevDepth + 1 || it->depth >= MAX_OUTLINE_DEPTH || it->nColor > dimof(it->color)) {
+            return false;
+        }
+        if (it->title > stringsSize || it->uri > stringsSize) {
+            return false;
+        }
+        prevDepth = it->depth;
+    }
+    return true;
+}
+
+bool LoadPdfLoadCache(const WCHAR* cacheDir, const WCHAR* filePath, const u8 docId[16], int nPages, fz_context* ctx,
+                      RectF* mediaboxesOut, fz_outline** outlineOut, fz_outline** attachmentsOut) {
+    u64 fileSize, modificationTime;
+    if (!cacheDir || nPages <= 0 || !GetFileSizeAndTime(filePath, &fileSize, &modificationTime)) {
+        return false;
+    }
+    AutoFreeWstr path(GetPdfCachePath(cacheDir, filePath));
+    if (!file::Exists(path)) {
+        return false;
+    }
+
+    MappedCacheFile cacheFile;
+    if (!cacheFile.Open(path) || cacheFile.size < sizeof(PdfCacheHeader)) {
+        return false;
+    }
+    const u8* data = cacheFile.data;
+
+    const PdfCacheHeader* hdr = (const PdfCacheHeader*)data;
+    bool isValid = hdr->magic == PDF_CACHE_MAGIC && hdr->version == PDF_CACHE_VERSION && hdr->fileSize == fileSize &&
+                   hdr->modificationTime == modificationTime && memeq(hdr->docId, docId, sizeof(hdr->docId)) &&
+                   hdr->nPages == (u32)nPages;
+    // don't trust the content of the file
+    u64 nItems = (u64)hdr->nOutlineItems + hdr->nAttachments;
+    u64 itemsOffset = sizeof(PdfCacheHeader) + (u64)nPages * sizeof(RectF);
+    u64 stringsOffset = itemsOffset + nItems * sizeof(PdfCacheItem);
+    isValid = isValid && stringsOffset + hdr->stringsSize == cacheFile.size;
+    const PdfCacheItem* items = (const PdfCacheItem*)(data + itemsOffset);
+    const char* strings = (const char*)(data + stringsOffset);
+    isValid = isValid && (hdr->stringsSize == 0 || strings[hdr->stringsSize - 1] == '\0');
+    isValid = isValid && IsValidOutline(items, (int)hdr->nOutlineItems, hdr->stringsSize);
+    isValid = isValid && IsValidOutline(items + hdr->nOutlineItems, (int)hdr->nAttachments, hdr->stringsSize);
+
+    fz_outline* outline = nullptr;
+    fz_outline* attachments = nullptr;
+    if (isValid) {
+        memcpy(mediaboxesOut, data + sizeof(PdfCacheHeader), nPages * sizeof(RectF));
+        outline = BuildOutline(ctx, items, (int)hdr->nOutlineItems, strings, hdr->stringsSize);
+        attachments = BuildOutline(ctx, items + hdr->nOutlineItems, (int)hdr->nAttachments, strings, hdr->stringsSize);
+        isValid = (outline || hdr->nOutlineItems == 0) && (attachments || hdr->nAttachments == 0);
+    }
+
+    if (!isValid) {
+        logf(L"LoadPdfLoadCache: '%s' is out of date\n", path.Get());
+        fz_drop_outline(ctx, outline);
+        fz_drop_outline(ctx, attachments);
+        return false;
+    }
+    *outlineOut = outline;
+    *attachmentsOut = attachments;
+    cacheFile.MarkUsed();
+    return true;
+}
+
+static u32 AddItemString(str::Str& strings, const char* s) {
+    if (!s) {
+        return 0;
+    }
+    u32 offset = (u32)strings.size() + 1;
+    strings.Append(s, str::Len(s) + 1);
+    return offset;
+}
+
+static bool FlattenOutline(fz_outline* outline, int depth, Vec<PdfCacheItem>& items, str::Str& strings) {
+    if (depth >= MAX_OUTLINE_DEPTH) {
+        return false;
+    }
+    for (; outline; outline = outline->next) {
+        PdfCacheItem it{};
+        it.title = AddItemString(strings, outline->title);
+        it.uri = AddItemString(strings, outline->uri);
+        it.page = outline->page;
+        it.x = outline->x;
+        it.y = outline->y;
+        it.depth = (u16)depth;
+        it.isOpen = outline->is_open ? 1 : 0;
+        it.nColor = (u8)std::clamp(outline->n_color, 0, (int)dimof(it.color));
+        it.flags = outline->flags;
+        memcpy(it.color, outline->color, sizeof(it.color));
+        items.Append(it);
+        if (outline->down && !FlattenOutline(outline->down, depth + 1, items, strings)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool SavePdfLoadCache(const WCHAR* cacheDir, const WCHAR* filePath, const u8 docId[16], int nPages,
+                      const RectF* mediaboxes, fz_outline* outline, fz_outline* attachments) {
+    PdfCacheHeader hdr{};
+    if (!cacheDir || nPages <= 0 || !GetFileSizeAndTime(filePath, &hdr.fileSize, &hdr.modificationTime)) {
+        return false;
+    }
+    Vec<PdfCacheItem> items;
+    str::Str strings;
+    if (!FlattenOutline(outline, 0, items, strings)) {
+        return false;
+    }
+    hdr.nOutlineItems = (u32)items.size();
+    if (!FlattenOutline(attachments, 0, items, strings)) {
+        return false;
+    }
+    hdr.nAttachments = (u32)items.size() - hdr.nOutlineItems;
+    hdr.magic = PDF_CACHE_MAGIC;
+    hdr.version = PDF_CACHE_VERSION;
+    memcpy(hdr.docId, docId, sizeof(hdr.docId));
+    hdr.nPages = (u32)nPages;
+    hdr.stringsSize = (u32)strings.size();
+
+    if (!dir::Create(cacheDir)) {
+        return false;
+    }
+    AutoFreeWstr path(GetPdfCachePath(cacheDir, filePath));
+    CacheFileWriter w(path);
+    w.Write(&hdr, sizeof(hdr));
+    w.Write(mediaboxes, nPages * sizeof(RectF));
+    w.Write(items.LendData(), items.size() * sizeof(PdfCacheItem));
+    w.Write(strings.Get(), strings.size());
+    bool ok = w.Commit();
+    if (!ok) {
+        logf(L"SavePdfLoadCache: failed to save '%s'\n", path.Get());
+    }
+    return ok;
+}
+
+void CleanUpPdfLoadCache(bool deleteAll) {
+    AutoFreeWstr dir(GetPdfLoadCacheDir());
+    CleanUpCacheFiles(dir, PDF_CACHE_EXT, MAX_PDF_CACHE_SIZE, deleteAll);
+}
@@ -0,0 +1,18 @@
+/* Copyright 2020 the SumatraPDF project authors (see AUTHORS file).
+   License: GPLv3 */
+
+// An optional on-disk cache of what EnginePdf::FinishLoading determines
+// for large documents (the page sizes, the outline and the attachments),
+// so that re-opening them doesn't require walking the page tree and the
+// outline again. Cache files are identified by the document's path and
+// are only used if the document's size, modification time and trailer ID
+// still match.
+
+// returns nullptr if the cache is disabled (see SetPdfLoadCacheDir)
+WCHAR* GetPdfLoadCacheDir();
+
+// mediaboxesOut must have room for nPages mediaboxes
+bool LoadPdfLoadCache(const WCHAR* cacheDir, const WCHAR* filePath, const u8 docId[16], int nPages, fz_context* ctx,
+                      RectF* mediaboxesOut, fz_outline** outlineOut, fz_outline** attachmentsOut);
+bool SavePdfLoadCache(const WCHAR* cacheDir, const WCHAR* filePath, const u8 docId[16], int nPages,
+                      const RectF* mediaboxes, fz_outline* outline, fz_outline* attachments);
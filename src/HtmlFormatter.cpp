@@ -7,6 +7,7 @@
 #include "utils/CssParser.h"
 #include "utils/HtmlPullParser.h"
 #include "utils/Log.h"
+#include "utils/ScopedWin.h"
 #include "mui/Mui.h"
 #include "utils/Timer.h"
 
@@ -159,10 +160,195 @@ void StyleRule::Merge(StyleRule& source) {
     }
 }
 
+// maximum number of threads laying out chapters in parallel
+#define MAX_LAYOUT_THREADS 8
+
+// text allocators aren't thread-safe
+struct LockedAllocator : Allocator {
+    Allocator* allocator = nullptr;
+    CRITICAL_SECTION access;
+
+    explicit LockedAllocator(Allocator* allocator) : allocator(allocator) {
+        InitializeCriticalSection(&access);
+    }
+    ~LockedAllocator() override {
+        DeleteCriticalSection(&access);
+    }
+    void* Alloc(size_t size) override {
+        ScopedCritSec scope(&access);
+        return Allocator::Alloc(allocator, size);
+    }
+    void* Realloc(void* mem, size_t size) override {
+        ScopedCritSec scope(&access);
+        return Allocator::Realloc(allocator, mem, size);
+    }
+    void Free(const void* mem) override {
+        ScopedCritSec scope(&access);
+        Allocator::Free(allocator, (void*)mem);
+    }
+};
+
+struct LayoutChapter {
+    int start = 0;
+    int end = 0;
+    Vec<HtmlPage*> pages;
+    // pages before nextPage have been handed out by ChapterLayout::Next
+    size_t nextPage = 0;
+    bool isDone = false;
+};
+
+// Lays out the chapters of a document concurrently, each with its own
+// formatter (and thus its own text measurement context) and returns
+// the pages of all chapters in order
+struct ChapterLayout {
+    HtmlFormatterFactory createFormatter;
+    // the arguments for the chapter formatters
+    float pageDx = 0;
+    float pageDy = 0;
+    AutoFreeWstr fontName;
+    float fontSize = 0;
+    mui::TextRenderMethod textRenderMethod = mui::TextRenderMethodGdiplus;
+    std::span<u8> htmlStr;
+    LockedAllocator* textAllocator = nullptr;
+    bool skipEmptyPages = true;
+
+    Vec<LayoutChapter*> chapters;
+    // chapters before nextChapter are being (or have been) laid out
+    int nextChapter = 0;
+    // the chapter whose pages are currently returned by Next()
+    int currChapter = 0;
+    bool stop = false;
+    CRITICAL_SECTION access;
+    CONDITION_VARIABLE chapterLaidOut;
+
+    HANDLE threads[MAX_LAYOUT_THREADS]{};
+    int nThreads = 0;
+
+    ChapterLayout() {
+        InitializeCriticalSection(&access);
+        InitializeConditionVariable(&chapterLaidOut);
+    }
+    ~ChapterLayout();
+
+    void StartThreads();
+    void LayOut(LayoutChapter* ch);
+    HtmlPage* Next();
+
+    static DWORD WINAPI LayoutThread(LPVOID data);
+};
+
+ChapterLayout::~ChapterLayout() {
+    EnterCriticalSection(&access);
+    stop = true;
+    LeaveCriticalSection(&access);
+
+    if (nThreads > 0) {
+        WaitForMultipleObjects(nThreads, threads, TRUE, INFINITE);
+    }
+    for (int i = 0; i < nThreads; i++) {
+        CloseHandle(threads[i]);
+    }
+    for (LayoutChapter* ch : chapters) {
+        for (size_t i = ch->nextPage; i < ch->pages.size(); i++) {
+            delete ch->pages.at(i);
+        }
+        delete ch;
+    }
+    delete textAllocator;
+    DeleteCriticalSection(&access);
+}
+
+void ChapterLayout::StartThreads() {
+    SYSTEM_INFO si{};
+    GetSystemInfo(&si);
+    int n = std::clamp((int)si.dwNumberOfProcessors, 1, MAX_LAYOUT_THREADS);
+    n = std::min(n, (int)chapters.size());
+    for (int i = 0; i < n; i++) {
+        HANDLE h = CreateThread(nullptr, 0, LayoutThread, this, 0, nullptr);
+        if (h) {
+            threads[nThreads++] = h;
+        }
+    }
+}
+
+// must be called without access held
+void ChapterLayout::LayOut(LayoutChapter* ch) {
+    HtmlFormatterArgs args;
+    args.pageDx = pageDx;
+    args.pageDy = pageDy;
+    args.SetFontName(fontName);
+    args.fontSize = fontSize;
+    args.textAllocator = textAllocator;
+    args.textRenderMethod = textRenderMethod;
+    args.htmlStr = htmlStr;
+    args.reparseIdx = ch->start;
+    args.reparseEnd = ch->end;
+
+    // ch->pages is only accessed by this thread until the chapter is done
+    HtmlFormatter* formatter = createFormatter(&args);
+    while (!stop) {
+        HtmlPage* pd = formatter->Next(skipEmptyPages);
+        if (!pd) {
+            break;
+        }
+        ch->pages.Append(pd);
+    }
+    delete formatter;
+
+    ScopedCritSec scope(&access);
+    ch->isDone = true;
+    WakeAllConditionVariable(&chapterLaidOut);
+}
+
+DWORD WINAPI ChapterLayout::LayoutThread(LPVOID data) {
+    ChapterLayout* cl = (ChapterLayout*)data;
+    for (;;) {
+        EnterCriticalSection(&cl->access);
+        if (cl->stop || cl->nextChapter >= (int)cl->chapters.size()) {
+            LeaveCriticalSection(&cl->access);
+            break;
+        }
+        LayoutChapter* ch = cl->chapters.at(cl->nextChapter++);
+        LeaveCriticalSection(&cl->access);
+
+        cl->LayOut(ch);
+    }
+    return 0;
+}
+
+HtmlPage* ChapterLayout::Next() {
+    HtmlPage* pd = nullptr;
+    EnterCriticalSection(&access);
+    while (!pd && currChapter < (int)chapters.size()) {
+        LayoutChapter* ch = chapters.at(currChapter);
+        if (nextChapter == currChapter) {
+            // no thread has gotten to this chapter yet
+            nextChapter++;
+            LeaveCriticalSection(&access);
+            LayOut(ch);
+            EnterCriticalSection(&access);
+        }
+        while (!ch->isDone) {
+            SleepConditionVariableCS(&chapterLaidOut, &access, INFINITE);
+        }
+        if (ch->nextPage < ch->pages.size()) {
+            pd = ch->pages.at(ch->nextPage++);
+        } else {
+            currChapter++;
+        }
+    }
+    LeaveCriticalSection(&access);
+    return pd;
+}
+
 HtmlFormatter::HtmlFormatter(HtmlFormatterArgs* args)
     : pageDx(args->pageDx), pageDy(args->pageDy), textAllocator(args->textAllocator) {
     currReparseIdx = args->reparseIdx;
-    htmlParser = new HtmlPullParser((const char*)args->htmlStr.data(), args->htmlStr.size());
+    reparseEnd = args->reparseEnd;
+    htmlStr = args->htmlStr;
+    textRenderMethod = args->textRenderMethod;
+    size_t htmlLen = reparseEnd > 0 ? (size_t)reparseEnd : htmlStr.size();
+    htmlParser = new HtmlPullParser((const char*)htmlStr.data(), htmlLen);
     htmlParser->SetCurrPosOff(currReparseIdx);
     CrashIf(!ValidReparseIdx(currReparseIdx, htmlParser));
 
@@ -191,6 +377,7 @@ HtmlFormatter::HtmlFormatter(HtmlFormatterArgs* args)
 }
 
 HtmlFormatter::~HtmlFormatter() {
+    delete chapterLayout;
     // delete all pages that were not consumed by the caller
     DeleteVecMembers(pagesToSend);
     delete currPage;
@@ -1330,12 +1517,52 @@ static bool IsEmptyPage(HtmlPage* p) {
     return true;
 }
 
+// returns nullptr if the document doesn't consist of several chapters
+ChapterLayout* HtmlFormatter::StartChapterLayout(bool skipEmptyPages) {
+    if (reparseEnd > 0) {
+        // this formatter lays out a single chapter
+        return nullptr;
+    }
+    Vec<int> chapterStarts;
+    HtmlFormatterFactory createFormatter = GetChapters(chapterStarts);
+    if (!createFormatter || chapterStarts.size() < 2) {
+        return nullptr;
+    }
+
+    ChapterLayout* cl = new ChapterLayout();
+    cl->createFormatter = createFormatter;
+    cl->pageDx = pageDx;
+    cl->pageDy = pageDy;
+    cl->fontName.SetCopy(defaultFontName);
+    cl->fontSize = defaultFontSize;
+    cl->textRenderMethod = textRenderMethod;
+    cl->htmlStr = htmlStr;
+    cl->textAllocator = new LockedAllocator(textAllocator);
+    cl->skipEmptyPages = skipEmptyPages;
+    for (size_t i = 0; i < chapterStarts.size(); i++) {
+        LayoutChapter* ch = new LayoutChapter();
+        ch->start = chapterStarts.at(i);
+        ch->end = i + 1 < chapterStarts.size() ? chapterStarts.at(i + 1) : (int)htmlStr.size();
+        cl->chapters.Append(ch);
+    }
+    cl->StartThreads();
+    return cl;
+}
+
 // Return the next parsed page. Returns nullptr if finished parsing.
 // For simplicity of implementation, we parse xml text node or
 // xml element at a time. This might cause a creation of one
 // or more pages, which we remeber and send to the caller
 // if we detect accumulated pages.
 HtmlPage* HtmlFormatter::Next(bool skipEmptyPages) {
+    if (!checkedForChapters) {
+        checkedForChapters = true;
+        chapterLayout = StartChapterLayout(skipEmptyPages);
+    }
+    if (chapterLayout) {
+        return chapterLayout->Next();
+    }
+
     gAllowAllocFailure++;
     defer {
         gAllowAllocFailure--;
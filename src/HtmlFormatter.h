@@ -171,6 +171,8 @@ struct HtmlFormatterArgs {
 
     // we start parsing from htmlStr + reparseIdx
     int reparseIdx{0};
+    // and stop at htmlStr + reparseEnd (at the end of htmlStr if 0)
+    int reparseEnd{0};
 
     AutoFreeWstr fontName;
 };
@@ -178,6 +180,10 @@ struct HtmlFormatterArgs {
 class HtmlPullParser;
 struct HtmlToken;
 struct CssSelector;
+struct ChapterLayout;
+class HtmlFormatter;
+
+typedef std::function<HtmlFormatter*(HtmlFormatterArgs*)> HtmlFormatterFactory;
 
 class HtmlFormatter {
   protected:
@@ -205,6 +211,13 @@ class HtmlFormatter {
     }
     virtual void HandleTagLink([[maybe_unused]] HtmlToken* t) {
     }
+    // for documents consisting of independent chapters (which always start on a new
+    // page and don't inherit any styling), returns the reparse points at which the
+    // chapters start and how to create a formatter for laying out a single chapter
+    virtual HtmlFormatterFactory GetChapters([[maybe_unused]] Vec<int>& chapterStarts) {
+        return nullptr;
+    }
+    ChapterLayout* StartChapterLayout(bool skipEmptyPages);
 
     float CurrLineDx();
     float CurrLineDy();
@@ -257,6 +270,9 @@ class HtmlFormatter {
     float defaultFontSize{0};
     Allocator* textAllocator{nullptr};
     mui::ITextRender* textMeasure{nullptr};
+    mui::TextRenderMethod textRenderMethod = mui::TextRenderMethodGdiplus;
+    std::span<u8> htmlStr;
+    int reparseEnd{0};
 
     // style stack of the current line
     Vec<DrawStyle> styleStack;
@@ -294,6 +310,10 @@ class HtmlFormatter {
 
     HtmlPullParser* htmlParser{nullptr};
 
+    // if set, chapters are laid out in parallel and Next() returns their pages
+    ChapterLayout* chapterLayout{nullptr};
+    bool checkedForChapters{false};
+
     // list of pages that we've created but haven't yet sent to client
     Vec<HtmlPage*> pagesToSend;
 
@@ -190,6 +190,17 @@ static_assert(kCdicHeaderLen == sizeof(CdicHeader), "wrong size of CdicHeader st
 
 #define kCdicsMax 32
 
+// symbols are only cached if there are at most 2^kMaxCachedCodeLength per dictionary
+#define kMaxCachedCodeLength 14
+// upper limit for the memory used by cached symbol expansions
+#define kMaxExpandedBytes (16 * 1024 * 1024)
+
+static bool gCacheHuffDicSymbols = true;
+
+void SetMobiHuffDicCache(bool enable) {
+    gCacheHuffDicSymbols = enable;
+}
+
 class HuffDicDecompressor {
     u32 cacheTable[kCacheItemCount] = {};
     u32 baseTable[kBaseTableItemCount] = {};
@@ -201,21 +212,69 @@ class HuffDicDecompressor {
 
     u32 codeLength = 0;
 
-    Vec<u32> recursionGuard;
+    // the fully expanded non-terminal symbols, indexed by code (i.e. dictionary
+    // index and code within the dictionary). Each entry is a u32 length followed
+    // by the data. Entries are only set once (with InterlockedCompareExchangePointer)
+    u8** expanded = nullptr;
+    u32 expandedCount = 0;
+    u32 expandedCodeLength = 0;
+    LONG expandedBytes = 0;
+
+    // the tables are read-only after setup, only recursionGuard is
+    // per call so that records can be decompressed on several threads
+    bool Decompress(u8* src, size_t srcSize, str::Str& dst, Vec<u32>& recursionGuard);
+    bool DecodeOne(u32 code, str::Str& dst, Vec<u32>& recursionGuard);
+    void CacheExpanded(u32 code, const char* s, size_t len);
 
   public:
     HuffDicDecompressor();
+    ~HuffDicDecompressor();
 
     bool SetHuffData(u8* huffData, size_t huffDataLen);
     bool AddCdicData(u8* cdicData, u32 cdicDataLen);
     bool Decompress(u8* src, size_t srcSize, str::Str& dst);
-    bool DecodeOne(u32 code, str::Str& dst);
 };
 
 HuffDicDecompressor::HuffDicDecompressor() {
 }
 
-bool HuffDicDecompressor::DecodeOne(u32 code, str::Str& dst) {
+HuffDicDecompressor::~HuffDicDecompressor() {
+    for (u32 i = 0; i < expandedCount; i++) {
+        free(expanded[i]);
+    }
+    free(expanded);
+}
+
+void HuffDicDecompressor::CacheExpanded(u32 code, const char* s, size_t len) {
+    LONG size = (LONG)(sizeof(u32) + len);
+    if (InterlockedExchangeAdd(&expandedBytes, size) + size > kMaxExpandedBytes) {
+        InterlockedExchangeAdd(&expandedBytes, -size);
+        return;
+    }
+    u8* e = AllocArray<u8>(size);
+    if (!e) {
+        InterlockedExchangeAdd(&expandedBytes, -size);
+        return;
+    }
+    *(u32*)e = (u32)len;
+    memcpy(e + sizeof(u32), s, len);
+    if (InterlockedCompareExchangePointer((void**)&expanded[code], e, nullptr) != nullptr) {
+        // another thread has expanded the same symbol
+        InterlockedExchangeAdd(&expandedBytes, -size);
+        free(e);
+    }
+}
+
+bool HuffDicDecompressor::DecodeOne(u32 code, str::Str& dst, Vec<u32>& recursionGuard) {
+    if (code < expandedCount) {
+        u8* e = expanded[code];
+        if (e) {
+            dst.Append((char*)e + sizeof(u32), *(u32*)e);
+            return true;
+        }
+    }
+
+    u32 fullCode = code;
     u16 dict = (u16)(code >> codeLength);
     if (dict >= dictsCount) {
         logf("invalid dict value\n");
@@ -241,10 +300,14 @@ bool HuffDicDecompressor::DecodeOne(u32 code, str::Str& dst) {
             return false;
         }
         recursionGuard.Append(code);
-        if (!Decompress(p, symLen, dst)) {
+        size_t startLen = dst.size();
+        if (!Decompress(p, symLen, dst, recursionGuard)) {
             return false;
         }
         recursionGuard.Pop();
+        if (fullCode < expandedCount) {
+            CacheExpanded(fullCode, dst.Get() + startLen, dst.size() - startLen);
+        }
     } else {
         symLen &= 0x7fff;
         if (symLen > 127) {
@@ -257,6 +320,11 @@ bool HuffDicDecompressor::DecodeOne(u32 code, str::Str& dst) {
 }
 
 bool HuffDicDecompressor::Decompress(u8* src, size_t srcSize, str::Str& dst) {
+    Vec<u32> recursionGuard;
+    return Decompress(src, srcSize, dst, recursionGuard);
+}
+
+bool HuffDicDecompressor::Decompress(u8* src, size_t srcSize, str::Str& dst, Vec<u32>& recursionGuard) {
     u32 bitsConsumed = 0;
     u32 bits = 0;
 
@@ -302,7 +370,7 @@ bool HuffDicDecompressor::Decompress(u8* src, size_t srcSize, str::Str& dst) {
             code = baseTable[codeLen * 2 - 1] - (bits >> (32 - codeLen));
         }
 
-        if (!DecodeOne(code, dst)) {
+        if (!DecodeOne(code, dst, recursionGuard)) {
             return false;
         }
         bitsConsumed = codeLen;
@@ -393,6 +461,27 @@ bool HuffDicDecompressor::AddCdicData(u8* cdicData, u32 cdicDataLen) {
     dicts[dictsCount] = cdicData + hdrLen;
     dictSize[dictsCount] = size;
     ++dictsCount;
+
+    // make room for caching the expanded symbols of this dictionary
+    // (the code length is expected to be the same for all dictionaries)
+    if (expanded && expandedCodeLength != codeLength) {
+        for (u32 i = 0; i < expandedCount; i++) {
+            free(expanded[i]);
+        }
+        free(expanded);
+        expanded = nullptr;
+        expandedCount = 0;
+        expandedBytes = 0;
+    } else if (gCacheHuffDicSymbols && codeLength <= kMaxCachedCodeLength) {
+        expandedCodeLength = codeLength;
+        u32 count = (u32)dictsCount << codeLength;
+        u8** tmp = (u8**)realloc(expanded, count * sizeof(u8*));
+        if (tmp) {
+            memset(tmp + expandedCount, 0, (count - expandedCount) * sizeof(u8*));
+            expanded = tmp;
+            expandedCount = count;
+        }
+    }
     return true;
 }
 
@@ -856,6 +945,76 @@ bool MobiDoc::LoadDocRecordIntoBuffer(size_t recNo, str::Str& strOut) {
     return false;
 }
 
+// documents with at least this many text records have them
+// decompressed in parallel (each record is compressed independently)
+#define MIN_RECORDS_FOR_PARALLEL_LOAD 64
+#define MAX_LOAD_THREADS 8
+
+static bool gLoadDocRecordsInParallel = true;
+
+void SetMobiParallelLoad(bool enable) {
+    gLoadDocRecordsInParallel = enable;
+}
+
+struct DocRecordsLoad {
+    MobiDoc* mobiDoc = nullptr;
+    // decompressed text of the records 1 to docRecCount
+    str::Str* records = nullptr;
+    // the last record claimed by a thread (use Interlocked* to modify)
+    LONG lastRecNo = 0;
+    LONG nFailed = 0;
+};
+
+DWORD WINAPI MobiDoc::LoadDocRecordsThread(LPVOID data) {
+    DocRecordsLoad* load = (DocRecordsLoad*)data;
+    MobiDoc* mb = load->mobiDoc;
+    for (;;) {
+        size_t recNo = (size_t)InterlockedIncrement(&load->lastRecNo);
+        if (recNo > mb->docRecCount) {
+            break;
+        }
+        if (!mb->LoadDocRecordIntoBuffer(recNo, load->records[recNo - 1])) {
+            InterlockedIncrement(&load->nFailed);
+        }
+    }
+    return 0;
+}
+
+// decompresses the text records into per-record buffers on several
+// threads and then appends them to doc in order.
+// Returns the number of records that failed to decompress
+size_t MobiDoc::LoadDocRecordsParallel() {
+    DocRecordsLoad load;
+    load.mobiDoc = this;
+    load.records = new str::Str[docRecCount];
+
+    SYSTEM_INFO si{};
+    GetSystemInfo(&si);
+    // the calling thread decompresses records as well
+    int nThreads = std::clamp((int)si.dwNumberOfProcessors, 1, MAX_LOAD_THREADS) - 1;
+    HANDLE threads[MAX_LOAD_THREADS]{};
+    int nStarted = 0;
+    for (int i = 0; i < nThreads; i++) {
+        HANDLE h = CreateThread(nullptr, 0, LoadDocRecordsThread, &load, 0, nullptr);
+        if (h) {
+            threads[nStarted++] = h;
+        }
+    }
+    LoadDocRecordsThread(&load);
+    if (nStarted > 0) {
+        WaitForMultipleObjects(nStarted, threads, TRUE, INFINITE);
+    }
+    for (int i = 0; i < nStarted; i++) {
+        CloseHandle(threads[i]);
+    }
+
+    for (size_t i = 0; i < docRecCount; i++) {
+        doc->Append(load.records[i].Get(), load.records[i].size());
+    }
+    delete[] load.records;
+    return (size_t)load.nFailed;
+}
+
 bool MobiDoc::LoadDocument(PdbReader* pdbReader) {
     logToDebugger = true;
     this->pdbReader = pdbReader;
@@ -866,9 +1025,13 @@ bool MobiDoc::LoadDocument(PdbReader* pdbReader) {
     CrashIf(doc != nullptr);
     doc = new str::Str(docUncompressedSize);
     size_t nFailed = 0;
-    for (size_t i = 1; i <= docRecCount; i++) {
-        if (!LoadDocRecordIntoBuffer(i, *doc)) {
-            nFailed++;
+    if (gLoadDocRecordsInParallel && docRecCount >= MIN_RECORDS_FOR_PARALLEL_LOAD) {
+        nFailed = LoadDocRecordsParallel();
+    } else {
+        for (size_t i = 1; i <= docRecCount; i++) {
+            if (!LoadDocRecordIntoBuffer(i, *doc)) {
+                nFailed++;
+            }
         }
     }
 
@@ -35,6 +35,8 @@ class MobiDoc {
 
     bool ParseHeader();
     bool LoadDocRecordIntoBuffer(size_t recNo, str::Str& strOut);
+    size_t LoadDocRecordsParallel();
+    static DWORD WINAPI LoadDocRecordsThread(LPVOID data);
     void LoadImages();
     bool LoadImage(size_t imageNo);
     bool LoadDocument(PdbReader* pdbReader);
@@ -68,3 +70,8 @@ class MobiDoc {
     static MobiDoc* CreateFromFile(const WCHAR* fileName);
     static MobiDoc* CreateFromStream(IStream* stream);
 };
+
+// for comparing load times with and without decompressing text records in parallel
+void SetMobiParallelLoad(bool enable);
+// for comparing load times with and without caching expanded HuffDic symbols
+void SetMobiHuffDicCache(bool enable);
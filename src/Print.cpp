@@ -50,6 +50,10 @@ struct PrintData {
         if (engine) {
             this->engine = engine->Clone();
         }
+        if (this->engine) {
+            // the page ranges refer to all pages (see EngineBase::UpdatePageCount)
+            this->engine->UpdatePageCount();
+        }
 
         if (printerInfo) {
             printerName.SetCopy(printerInfo->pPrinterName);
@@ -41,44 +41,248 @@ RenderCache::RenderCache() : maxTileSize({GetSystemMetrics(SM_CXSCREEN), GetSyst
     textColor = WIN_COL_BLACK;
     backgroundColor = WIN_COL_WHITE;
 
+    size_t screenBytes = (size_t)maxTileSize.dx * (size_t)maxTileSize.dy * 4;
+    maxCacheBytes = std::clamp(screenBytes * CACHE_MEMORY_SCREENS, (size_t)MIN_CACHE_MEMORY, (size_t)MAX_CACHE_MEMORY);
+    table = new BitmapCacheTable();
+
     InitializeCriticalSection(&cacheAccess);
     InitializeCriticalSection(&requestAccess);
-
-    startRendering = CreateEvent(nullptr, FALSE, FALSE, nullptr);
-    renderThread = CreateThread(nullptr, 0, RenderCacheThread, this, 0, 0);
-    CrashIf(nullptr == renderThread);
+    InitializeCriticalSection(&visiblePartsAccess);
+    InitializeSListHead(&postedRequests);
+
+    startRendering = CreateSemaphoreW(nullptr, 0, LONG_MAX, nullptr);
+
+    // render as many tiles in parallel as there are cores (up to a limit)
+    SYSTEM_INFO si{};
+    GetSystemInfo(&si);
+    nWorkers = std::clamp((int)si.dwNumberOfProcessors, 1, MAX_RENDER_THREADS);
+    for (int i = 0; i < nWorkers; i++) {
+        RenderWorker* worker = &workers[i];
+        worker->cache = this;
+        worker->workerNo = i;
+        worker->thread = CreateThread(nullptr, 0, RenderCacheThread, worker, 0, 0);
+        CrashIf(nullptr == worker->thread);
+    }
 }
 
 RenderCache::~RenderCache() {
     EnterCriticalSection(&requestAccess);
     EnterCriticalSection(&cacheAccess);
 
-    CloseHandle(renderThread);
+    for (int i = 0; i < nWorkers; i++) {
+        CrashIf(workers[i].curReq);
+        CloseHandle(workers[i].thread);
+    }
     CloseHandle(startRendering);
-    CrashIf(curReq || 0 != requestCount || 0 != cacheCount);
+    CrashIf(0 != requestCount || 0 != cacheCount);
+    CrashIf(readers[0] != 0 || readers[1] != 0);
+
+    delete table;
+    for (int i = 0; i < 2; i++) {
+        DeleteVecMembers(retiredTables[i]);
+        DeleteVecMembers(retiredEntries[i]);
+    }
+    DeleteVecMembers(freeTables);
+    PSLIST_ENTRY posted = InterlockedFlushSList(&postedRequests);
+    while (posted) {
+        auto req = (PostedRequest*)posted;
+        posted = posted->Next;
+        delete req;
+    }
 
     LeaveCriticalSection(&cacheAccess);
     DeleteCriticalSection(&cacheAccess);
     LeaveCriticalSection(&requestAccess);
     DeleteCriticalSection(&requestAccess);
+
+    for (VisibleParts* vis : visibleParts) {
+        DropVisibleParts(vis);
+    }
+    DeleteCriticalSection(&visiblePartsAccess);
+}
+
+// publishes what's currently visible of dm for the rendering threads.
+// Must be called on the UI thread before requesting rendering or painting
+void RenderCache::UpdateVisibleParts(DisplayModel* dm) {
+    VisibleParts* prev = GetVisibleParts(dm);
+    bool isUpToDate = prev && prev->version == dm->visiblePartsVersion;
+    DropVisibleParts(prev);
+    if (isUpToDate) {
+        return;
+    }
+
+    auto vis = new VisibleParts();
+    vis->dm = dm;
+    vis->version = dm->visiblePartsVersion;
+    vis->rotation = dm->GetRotation();
+    vis->viewPortSize = dm->GetViewPort().Size();
+    vis->currentPageNo = dm->CurrentPageNo();
+    vis->pageCount = dm->PageCount();
+    int firstVisiblePage = dm->FirstVisiblePageNo();
+    if (firstVisiblePage != INVALID_PAGE_NO) {
+        // pages nearby are in the row above or below a visible page
+        // (cf. DisplayModel::PageVisibleNearby)
+        int columns = IsSingle(dm->GetDisplayMode()) ? 1 : 2;
+        int firstPage = std::max(firstVisiblePage - 2 * columns - 1, 1);
+        int lastPage = std::min(dm->LastVisiblePageNo() + 2 * columns + 1, vis->pageCount);
+        for (int pageNo = firstPage; pageNo <= lastPage; pageNo++) {
+            if (!dm->PageVisibleNearby(pageNo)) {
+                continue;
+            }
+            PageInfo* pageInfo = dm->GetPageInfo(pageNo);
+            VisiblePage page;
+            page.pageNo = pageNo;
+            page.isVisible = pageInfo->visibleRatio > 0.0;
+            page.pageOnScreen = dm->PageOnScreen(pageNo);
+            vis->pages.Append(page);
+        }
+    }
+
+    ScopedCritSec scope(&visiblePartsAccess);
+    for (VisibleParts*& other : visibleParts) {
+        if (other->dm == dm) {
+            // readers might still be using the previous copy
+            DropVisibleParts(other);
+            other = vis;
+            return;
+        }
+    }
+    visibleParts.Append(vis);
+}
+
+// returns what has last been published as visible of dm (nullptr if nothing
+// has been). Call DropVisibleParts when no longer needed
+VisibleParts* RenderCache::GetVisibleParts(DisplayModel* dm) {
+    ScopedCritSec scope(&visiblePartsAccess);
+    for (VisibleParts* vis : visibleParts) {
+        if (vis->dm == dm) {
+            InterlockedIncrement(&vis->refs);
+            return vis;
+        }
+    }
+    return nullptr;
+}
+
+void RenderCache::DropVisibleParts(VisibleParts* vis) {
+    if (vis && InterlockedDecrement(&vis->refs) == 0) {
+        delete vis;
+    }
+}
+
+static int GetBucketIdx(DisplayModel* dm, int pageNo, int rotation) {
+    uintptr_t h = (uintptr_t)dm >> 4;
+    h = h * 31 + (uintptr_t)pageNo;
+    h = h * 31 + (uintptr_t)(rotation / 90);
+    return (int)(h % BITMAP_CACHE_BUCKETS);
+}
+
+// readers (i.e. Find) register for the current epoch so that the tables
+// and entries they might see aren't freed before they're done
+int RenderCache::EnterReader() {
+    for (;;) {
+        LONG e = InterlockedAdd(&epoch, 0);
+        int slot = (int)(e & 1);
+        InterlockedIncrement(&readers[slot]);
+        if (InterlockedAdd(&epoch, 0) == e) {
+            return slot;
+        }
+        // the epoch advanced in the meantime, register for the new one
+        InterlockedDecrement(&readers[slot]);
+    }
+}
+
+void RenderCache::LeaveReader(int readerSlot) {
+    InterlockedDecrement(&readers[readerSlot]);
+}
+
+// frees what was retired during the previous epoch once all of its readers
+// are gone and advances the epoch. Must be called with cacheAccess held
+void RenderCache::ReclaimRetired() {
+    LONG e = InterlockedAdd(&epoch, 0);
+    int prevSlot = (int)((e - 1) & 1);
+    if (InterlockedAdd(&readers[prevSlot], 0) != 0) {
+        return;
+    }
+    for (BitmapCacheTable* t : retiredTables[prevSlot]) {
+        if (freeTables.size() < MAX_FREE_TABLES) {
+            freeTables.Append(t);
+        } else {
+            delete t;
+        }
+    }
+    retiredTables[prevSlot].Reset();
+    DeleteVecMembers(retiredEntries[prevSlot]);
+    // from now on, things are retired into prevSlot again
+    InterlockedIncrement(&epoch);
+}
+
+// makes the current content of cache visible to Find().
+// Must be called with cacheAccess held
+void RenderCache::PublishTable() {
+    BitmapCacheTable* newTable;
+    if (freeTables.size() > 0) {
+        // no reader can still see a reclaimed table
+        newTable = freeTables.Pop();
+        ZeroMemory(newTable->bucketStart, sizeof(newTable->bucketStart));
+    } else {
+        newTable = new BitmapCacheTable();
+    }
+    int* bucketStart = newTable->bucketStart;
+    for (int i = 0; i < cacheCount; i++) {
+        BitmapCacheEntry* e = cache[i];
+        bucketStart[GetBucketIdx(e->dm, e->pageNo, e->rotation) + 1]++;
+    }
+    for (int i = 0; i < BITMAP_CACHE_BUCKETS; i++) {
+        bucketStart[i + 1] += bucketStart[i];
+    }
+    int next[BITMAP_CACHE_BUCKETS];
+    memcpy(next, bucketStart, sizeof(next));
+    for (int i = 0; i < cacheCount; i++) {
+        BitmapCacheEntry* e = cache[i];
+        int idx = next[GetBucketIdx(e->dm, e->pageNo, e->rotation)]++;
+        newTable->entries[idx] = e;
+    }
+    newTable->nEntries = cacheCount;
+
+    auto oldTable = (BitmapCacheTable*)InterlockedExchangePointer((PVOID*)&table, newTable);
+    retiredTables[InterlockedAdd(&epoch, 0) & 1].Append(oldTable);
+    ReclaimRetired();
+}
+
+static bool TryAddRef(BitmapCacheEntry* entry) {
+    for (;;) {
+        LONG refs = InterlockedAdd(&entry->refs, 0);
+        if (refs <= 0) {
+            // removed from the cache and no longer used
+            return false;
+        }
+        if (InterlockedCompareExchange(&entry->refs, refs + 1, refs) == refs) {
+            return true;
+        }
+    }
 }
 
 /* Find a bitmap for a page defined by <dm> and <pageNo> and optionally also
    <rotation> and <zoom> in the cache - call DropCacheEntry when you
-   no longer need a found entry. */
+   no longer need a found entry. This doesn't block on cacheAccess
+   so that painting isn't delayed by rendering threads adding bitmaps. */
 BitmapCacheEntry* RenderCache::Find(DisplayModel* dm, int pageNo, int rotation, float zoom, TilePosition* tile) {
-    ScopedCritSec scope(&cacheAccess);
     rotation = NormalizeRotation(rotation);
-    for (int i = 0; i < cacheCount; i++) {
-        BitmapCacheEntry* e = cache[i];
+    int readerSlot = EnterReader();
+    BitmapCacheTable* t = (BitmapCacheTable*)InterlockedCompareExchangePointer((PVOID*)&table, nullptr, nullptr);
+    int bucketIdx = GetBucketIdx(dm, pageNo, rotation);
+    BitmapCacheEntry* found = nullptr;
+    for (int i = t->bucketStart[bucketIdx]; i < t->bucketStart[bucketIdx + 1]; i++) {
+        BitmapCacheEntry* e = t->entries[i];
         if ((dm == e->dm) && (pageNo == e->pageNo) && (rotation == e->rotation) &&
-            (INVALID_ZOOM == zoom || zoom == e->zoom) && (!tile || e->tile == *tile)) {
-            e->refs++;
-            CrashIf(i != e->cacheIdx);
-            return e;
+            (INVALID_ZOOM == zoom || zoom == e->zoom) && (!tile || e->tile == *tile) && TryAddRef(e)) {
+            InterlockedExchange(&e->lastUsed, (LONG)GetTickCount());
+            found = e;
+            break;
         }
     }
-    return nullptr;
+    LeaveReader(readerSlot);
+    return found;
 }
 
 bool RenderCache::Exists(DisplayModel* dm, int pageNo, int rotation, float zoom, TilePosition* tile) {
@@ -89,29 +293,46 @@ bool RenderCache::Exists(DisplayModel* dm, int pageNo, int rotation, float zoom,
     return entry != nullptr;
 }
 
+// releases a reference to entry, returns true if that was the last one
 bool RenderCache::DropCacheEntry(BitmapCacheEntry* entry) {
-    ScopedCritSec scope(&cacheAccess);
     CrashIf(!entry);
     if (!entry) {
         return false;
     }
+    LONG refs = InterlockedDecrement(&entry->refs);
+    CrashIf(refs < 0);
+    if (refs > 0) {
+        return false;
+    }
+    CrashIf(entry->cacheIdx != -1);
+    dbglogf("RenderCache::DropCacheEntry: pageNo: %d, rotation: %d, zoom: %.2f\n", entry->pageNo, entry->rotation,
+            entry->zoom);
+
+    // the bitmap is no longer reachable but concurrent lookups might
+    // still look at the entry itself
+    delete entry->bitmap;
+    entry->bitmap = nullptr;
+    ScopedCritSec scope(&cacheAccess);
+    retiredEntries[InterlockedAdd(&epoch, 0) & 1].Append(entry);
+    return true;
+}
+
+// removes entry from the cache. The entry is freed once the
+// last caller of Find() is done with it (see DropCacheEntry).
+// Call PublishTable() afterwards
+void RenderCache::RemoveCacheEntry(BitmapCacheEntry* entry) {
+    ScopedCritSec scope(&cacheAccess);
     int idx = entry->cacheIdx;
     CrashIf(idx < 0);
     CrashIf(idx >= cacheCount);
     if ((idx < 0) || (idx >= cacheCount)) {
-        return false;
-    }
-    CrashIf(entry->refs <= 0);
-    --entry->refs;
-    if (entry->refs > 0) {
-        return false;
+        return;
     }
-    CrashIf(entry->refs != 0);
     CrashIf(cache[idx] != entry);
-    dbglogf("RenderCache::DropCacheEntry: pageNo: %d, rotation: %d, zoom: %.2f\n", entry->pageNo, entry->rotation,
-            entry->zoom);
 
-    delete entry;
+    CrashIf(cacheBytes < entry->bytes);
+    cacheBytes -= entry->bytes;
+    entry->cacheIdx = -1;
 
     // fast removal by replacing freed item with the item at the end
     cache[idx] = nullptr;
@@ -123,43 +344,90 @@ bool RenderCache::DropCacheEntry(BitmapCacheEntry* entry) {
     }
     cacheCount--;
     CrashIf(cacheCount < 0);
-    return true;
+
+    DropCacheEntry(entry);
 }
 
-static bool FreeIfFull(RenderCache* rc, const PageRenderRequest& req) {
-    int n = rc->cacheCount;
-    if (n < MAX_BITMAPS_CACHED) {
-        return true;
+static size_t GetBitmapBytes(RenderedBitmap* bmp) {
+    if (!bmp || !bmp->GetBitmap()) {
+        return 0;
+    }
+    BITMAP info{};
+    if (!GetObject(bmp->GetBitmap(), sizeof(info), &info)) {
+        Size size = bmp->Size();
+        return (size_t)size.dx * (size_t)size.dy * 4;
     }
+    return (size_t)info.bmWidthBytes * (size_t)info.bmHeight;
+}
 
-    DisplayModel* dm = req.dm;
-    // free an invisible page of the same DisplayModel ...
-    for (int i = 0; i < n; i++) {
-        auto entry = rc->cache[i];
-        if (entry->dm == dm && !dm->PageVisibleNearby(entry->pageNo)) {
-            bool didDrop = rc->DropCacheEntry(entry);
-            if (didDrop) {
-                return true;
-            }
-        }
+static bool IsTileVisible(VisibleParts* vis, int pageNo, TilePosition tile, float fuzz = 0);
+
+// how much we gain (and how little we lose) by evicting an entry:
+// large bitmaps that haven't been painted in a while and are far
+// away from the visible pages are evicted first.
+// Visible tiles are only evicted as a last resort (isVisible is set)
+static float GetEvictionScore(BitmapCacheEntry* entry, VisibleParts* vis, DWORD now, bool* isVisible) {
+    int pageNo = entry->pageNo;
+    const VisiblePage* page = vis ? vis->GetPage(pageNo) : nullptr;
+    *isVisible = false;
+    int distance = 0;
+    if (!vis) {
+        // nothing of entry->dm has been painted yet, so
+        // its bitmaps are the least likely to be needed soon
+        distance = std::numeric_limits<short>::max();
+    } else if (entry->outOfDate) {
+        distance = vis->pageCount;
+    } else if (page && page->isVisible) {
+        *isVisible = entry->tile.res <= 1 || IsTileVisible(vis, pageNo, entry->tile, 0.5);
+        distance = *isVisible ? 0 : 1;
+    } else if (page) {
+        distance = 1;
+    } else {
+        distance = 1 + abs(pageNo - vis->currentPageNo);
     }
+    DWORD lastUsed = (DWORD)InterlockedAdd(&entry->lastUsed, 0);
+    float ageSecs = (float)(now - lastUsed) / 1000.f;
+    return (float)entry->bytes * (1.f + ageSecs) * (float)(1 + distance);
+}
 
-    // ... or just the oldest cached page
-    for (int i = 0; i < n; i++) {
-        auto entry = rc->cache[i];
-        if (entry->dm == dm) {
-            // don't free pages from the document we're currently displaying
-            // as it leads to flicker
-            // TODO: it can still flicker if the dm is from a visible tab
-            // in a different window, but it's harder to detect
-            continue;
-        }
-        bool didDrop = rc->DropCacheEntry(entry);
-        if (didDrop) {
+// frees cached bitmaps until there's space for another bitmap of newBytes
+// bytes. Visible tiles are kept even if that means exceeding the
+// memory budget, unless there's no free slot at all
+static bool FreeForNewBitmap(RenderCache* rc, size_t newBytes) {
+    DWORD now = GetTickCount();
+    for (;;) {
+        bool isFull = rc->cacheCount >= MAX_BITMAPS_CACHED;
+        if (!isFull && rc->cacheBytes + newBytes <= rc->maxCacheBytes) {
             return true;
         }
+
+        BitmapCacheEntry* victim = nullptr;
+        float victimScore = 0;
+        bool victimVisible = false;
+        for (int i = 0; i < rc->cacheCount; i++) {
+            BitmapCacheEntry* entry = rc->cache[i];
+            if (InterlockedAdd(&entry->refs, 0) > 1) {
+                // currently being painted
+                continue;
+            }
+            bool isVisible;
+            VisibleParts* vis = rc->GetVisibleParts(entry->dm);
+            float score = GetEvictionScore(entry, vis, now, &isVisible);
+            rc->DropVisibleParts(vis);
+            bool isBetter = !victim || (victimVisible && !isVisible) ||
+                            (victimVisible == isVisible && score > victimScore);
+            if (isBetter) {
+                victim = entry;
+                victimScore = score;
+                victimVisible = isVisible;
+            }
+        }
+        if (!victim || (victimVisible && !isFull)) {
+            return !isFull;
+        }
+        dbglogf("RenderCache: evicting pageNo: %d, bytes: %d\n", victim->pageNo, (int)victim->bytes);
+        rc->RemoveCacheEntry(victim);
     }
-    return false;
 }
 
 void RenderCache::Add(PageRenderRequest& req, RenderedBitmap* bmp) {
@@ -171,16 +439,29 @@ void RenderCache::Add(PageRenderRequest& req, RenderedBitmap* bmp) {
 
     /* It's possible there still is a cached bitmap with different zoom/rotation */
     FreePage(req.dm, req.pageNo, &req.tile);
+    if (InterlockedExchange(&freeNotVisiblePending, 0) != 0) {
+        FreeNotVisible();
+    }
 
-    bool hasSpace = FreeIfFull(this, req);
-    CrashIf(!hasSpace); // TODO: FreeIfFull() might actually fail to free
-    CrashIf(cacheCount > MAX_BITMAPS_CACHED);
+    size_t bytes = GetBitmapBytes(bmp);
+    bool hasSpace = FreeForNewBitmap(this, bytes);
+    if (!hasSpace) {
+        // all cached bitmaps are currently being painted
+        PublishTable();
+        delete bmp;
+        return;
+    }
+    CrashIf(cacheCount >= MAX_BITMAPS_CACHED);
 
     // Copy the PageRenderRequest as it will be reused
     auto entry = new BitmapCacheEntry(req.dm, req.pageNo, req.rotation, req.zoom, req.tile, bmp);
+    entry->bytes = bytes;
+    entry->lastUsed = (LONG)GetTickCount();
     entry->cacheIdx = cacheCount;
     cache[cacheCount] = entry;
     cacheCount++;
+    cacheBytes += bytes;
+    PublishTable();
 }
 
 static RectF GetTileRect(RectF pagerect, TilePosition tile) {
@@ -215,28 +496,109 @@ static Rect GetTileOnScreen(EngineBase* engine, int pageNo, int rotation, float
     return bbox;
 }
 
-static bool IsTileVisible(DisplayModel* dm, int pageNo, TilePosition tile, float fuzz = 0) {
-    if (!dm) {
+// get the coordinates of a tile from where the whole page is on screen
+// (without asking the engine for the page's mediabox, which might have to
+// wait for the engine's lock, cf. GetTileRectDevice and GetBaseTransform)
+static Rect GetTileInPageOnScreen(Rect pageOnScreen, int rotation, TilePosition tile) {
+    CrashIf(tile.res > 30);
+    double n = (tile.res > 0 && tile.res != INVALID_TILE_RES) ? (double)(1ULL << tile.res) : 1.0;
+    double col = n > 1 ? tile.col : 0;
+    double row = n > 1 ? tile.row : 0;
+    // the tile as a fraction of the unrotated page (rows are counted from the bottom)
+    double x0 = col / n, x1 = (col + 1) / n;
+    double y0 = (n - row - 1) / n, y1 = (n - row) / n;
+    rotation = rotation % 360;
+    if (rotation < 0) {
+        rotation = rotation + 360;
+    }
+    double left = x0, top = y0, right = x1, bottom = y1;
+    if (90 == rotation) {
+        left = 1 - y1, right = 1 - y0, top = x0, bottom = x1;
+    } else if (180 == rotation) {
+        left = 1 - x1, right = 1 - x0, top = 1 - y1, bottom = 1 - y0;
+    } else if (270 == rotation) {
+        left = y0, right = y1, top = 1 - x1, bottom = 1 - x0;
+    }
+    int x = pageOnScreen.x + (int)floor(left * pageOnScreen.dx);
+    int y = pageOnScreen.y + (int)floor(top * pageOnScreen.dy);
+    int dx = pageOnScreen.x + (int)ceil(right * pageOnScreen.dx) - x;
+    int dy = pageOnScreen.y + (int)ceil(bottom * pageOnScreen.dy) - y;
+    return Rect(x, y, dx, dy);
+}
+
+// only pages visible or nearby (as last published by the UI thread) can have visible tiles.
+// Only looks at vis so that it's safe to call within requestAccess and cacheAccess
+static bool IsTileVisible(VisibleParts* vis, int pageNo, TilePosition tile, float fuzz) {
+    if (!vis) {
         return false;
     }
-    PageInfo* pageInfo = dm->GetPageInfo(pageNo);
-    EngineBase* engine = dm->GetEngine();
-    if (!engine || !pageInfo) {
+    const VisiblePage* page = vis->GetPage(pageNo);
+    if (!page) {
         return false;
     }
-    int rotation = dm->GetRotation();
-    float zoom = dm->GetZoomReal(pageNo);
-    Rect r = pageInfo->pageOnScreen;
-    Rect tileOnScreen = GetTileOnScreen(engine, pageNo, rotation, zoom, tile, r);
+    Rect tileOnScreen = GetTileInPageOnScreen(page->pageOnScreen, vis->rotation, tile);
     // consider nearby tiles visible depending on the fuzz factor
     tileOnScreen.x -= (int)(tileOnScreen.dx * fuzz * 0.5);
     tileOnScreen.dx = (int)(tileOnScreen.dx * (fuzz + 1));
     tileOnScreen.y -= (int)(tileOnScreen.dy * fuzz * 0.5);
     tileOnScreen.dy = (int)(tileOnScreen.dy * (fuzz + 1));
-    Rect screen(Point(), dm->GetViewPort().Size());
+    Rect screen(Point(), vis->viewPortSize);
     return !tileOnScreen.Intersect(screen).IsEmpty();
 }
 
+static RenderPriority GetRenderPriority(RenderCache* rc, PageRenderRequest* req) {
+    if (req->renderCb) {
+        return RenderPriority::Thumbnail;
+    }
+    if (req->isDraft) {
+        return RenderPriority::Draft;
+    }
+    VisibleParts* vis = rc->GetVisibleParts(req->dm);
+    bool isVisible = IsTileVisible(vis, req->pageNo, req->tile);
+    rc->DropVisibleParts(vis);
+    if (isVisible) {
+        return RenderPriority::Visible;
+    }
+    return RenderPriority::Prefetch;
+}
+
+// must be called within requestAccess
+static void DropLeastUrgentRequest(RenderCache* rc) {
+    RenderWorker* owner = nullptr;
+    int worstIdx = -1;
+    RenderPriority worstPrio = RenderPriority::Draft;
+    for (int i = 0; i < rc->nWorkers; i++) {
+        RenderWorker* w = &rc->workers[i];
+        int n = w->queue.isize();
+        for (int j = 0; j < n; j++) {
+            PageRenderRequest* r = w->queue.at(j);
+            RenderPriority prio = GetRenderPriority(rc, r);
+            if (owner && (prio < worstPrio || (prio == worstPrio && r->seq > owner->queue.at(worstIdx)->seq))) {
+                continue;
+            }
+            owner = w;
+            worstIdx = j;
+            worstPrio = prio;
+        }
+    }
+    if (!owner) {
+        return;
+    }
+    PageRenderRequest* req = owner->queue.PopAt(worstIdx);
+    if (req->renderCb) {
+        req->renderCb->Callback();
+    }
+    delete req;
+    rc->requestCount--;
+}
+
+static void AbortRequest(PageRenderRequest* req) {
+    if (req->abortCookie) {
+        req->abortCookie->Abort();
+    }
+    req->abort = true;
+}
+
 /* Free all bitmaps in the cache that are of a specific page (or all pages
    of the given DisplayModel, or even all invisible pages). */
 void RenderCache::FreePage(DisplayModel* dm, int pageNo, TilePosition* tile) {
@@ -244,6 +606,7 @@ void RenderCache::FreePage(DisplayModel* dm, int pageNo, TilePosition* tile) {
     ScopedCritSec scope(&cacheAccess);
 
     // must go from end becaues freeing changes the cache
+    int prevCount = cacheCount;
     for (int i = cacheCount - 1; i >= 0; i--) {
         BitmapCacheEntry* entry = cache[i];
         bool shouldFree;
@@ -263,25 +626,60 @@ void RenderCache::FreePage(DisplayModel* dm, int pageNo, TilePosition* tile) {
             shouldFree = (entry->dm == dm);
         } else {
             // all invisible pages resp. page tiles
-            shouldFree = !entry->dm->PageVisibleNearby(entry->pageNo);
+            VisibleParts* vis = GetVisibleParts(entry->dm);
+            shouldFree = !vis || !vis->GetPage(entry->pageNo);
             if (!shouldFree && entry->tile.res > 1) {
-                shouldFree = !IsTileVisible(entry->dm, entry->pageNo, entry->tile, 2.0);
+                shouldFree = !IsTileVisible(vis, entry->pageNo, entry->tile, 2.0);
             }
+            DropVisibleParts(vis);
         }
         if (shouldFree) {
-            DropCacheEntry(entry);
+            RemoveCacheEntry(entry);
         }
     }
+    if (cacheCount != prevCount) {
+        PublishTable();
+    }
 }
 
 void RenderCache::FreeForDisplayModel(DisplayModel* dm) {
     FreePage(dm);
+
+    // dm is about to be deleted
+    VisibleParts* vis = nullptr;
+    EnterCriticalSection(&visiblePartsAccess);
+    for (int i = 0; i < visibleParts.isize(); i++) {
+        if (visibleParts.at(i)->dm == dm) {
+            vis = visibleParts.PopAt(i);
+            break;
+        }
+    }
+    LeaveCriticalSection(&visiblePartsAccess);
+    DropVisibleParts(vis);
 }
 
 void RenderCache::FreeNotVisible() {
     FreePage();
 }
 
+// frees the page's tiles of other resolutions (if freeOtherRes) and all
+// invisible tiles after painting. Painting doesn't wait for a rendering
+// thread holding cacheAccess, though: invisible tiles are then freed by the
+// next call to Add and the page's other tiles on the repaint following it
+void RenderCache::FreeAfterPaint(DisplayModel* dm, int pageNo, USHORT targetRes, bool freeOtherRes) {
+    if (!TryEnterCriticalSection(&cacheAccess)) {
+        InterlockedExchange(&freeNotVisiblePending, 1);
+        return;
+    }
+    if (freeOtherRes) {
+        TilePosition tile(targetRes, (USHORT)-1, 0);
+        dbglogf("RenderCache::FreeAfterPaint: calling FreePage() pageNo: %d\n", pageNo);
+        FreePage(dm, pageNo, &tile);
+    }
+    FreeNotVisible();
+    LeaveCriticalSection(&cacheAccess);
+}
+
 // keep the cached bitmaps for visible pages to avoid flickering during a reload.
 // mark invisible pages as out-of-date to prevent inconsistencies
 void RenderCache::KeepForDisplayModel(DisplayModel* oldDm, DisplayModel* newDm) {
@@ -298,20 +696,21 @@ void RenderCache::KeepForDisplayModel(DisplayModel* oldDm, DisplayModel* newDm)
         entry->zoom = INVALID_ZOOM;
         entry->outOfDate = true;
     }
+    // entries might have moved to a different bucket
+    PublishTable();
 }
 
 // marks all tiles containing rect of pageNo as out of date
 void RenderCache::Invalidate(DisplayModel* dm, int pageNo, RectF rect) {
+    // ask the engine before taking requestAccess (see IsTileVisible)
+    RectF mediabox = dm->GetEngine()->PageMediabox(pageNo);
     ScopedCritSec scopeReq(&requestAccess);
 
     ClearQueueForDisplayModel(dm, pageNo);
-    if (curReq && curReq->dm == dm && curReq->pageNo == pageNo) {
-        AbortCurrentRequest();
-    }
+    AbortCurrentRequests(dm, pageNo);
 
     ScopedCritSec scopeCache(&cacheAccess);
 
-    RectF mediabox = dm->GetEngine()->PageMediabox(pageNo);
     for (int i = 0; i < cacheCount; i++) {
         auto e = cache[i];
         if (e->dm == dm && e->pageNo == pageNo && !GetTileRect(mediabox, e->tile).Intersect(rect).IsEmpty()) {
@@ -356,14 +755,17 @@ USHORT RenderCache::GetTileRes(DisplayModel* dm, int pageNo) {
 
 // get the maximum resolution available for the given page
 USHORT RenderCache::GetMaxTileRes(DisplayModel* dm, int pageNo, int rotation) {
-    ScopedCritSec scope(&cacheAccess);
+    int readerSlot = EnterReader();
+    BitmapCacheTable* t = (BitmapCacheTable*)InterlockedCompareExchangePointer((PVOID*)&table, nullptr, nullptr);
+    int bucketIdx = GetBucketIdx(dm, pageNo, rotation);
     USHORT maxRes = 0;
-    for (int i = 0; i < cacheCount; i++) {
-        auto e = cache[i];
+    for (int i = t->bucketStart[bucketIdx]; i < t->bucketStart[bucketIdx + 1]; i++) {
+        auto e = t->entries[i];
         if (e->dm == dm && e->pageNo == pageNo && e->rotation == rotation) {
             maxRes = std::max(e->tile.res, maxRes);
         }
     }
+    LeaveReader(readerSlot);
     return maxRes;
 }
 
@@ -376,6 +778,8 @@ bool RenderCache::ReduceTileSize() {
 
     ScopedCritSec scope1(&requestAccess);
     ScopedCritSec scope2(&cacheAccess);
+    // posted requests are for tiles of the current size
+    QueuePostedRequests();
 
     if (maxTileSize.dx > maxTileSize.dy) {
         maxTileSize.dx /= 2;
@@ -385,17 +789,21 @@ bool RenderCache::ReduceTileSize() {
 
     // invalidate all rendered bitmaps and all requests
     while (cacheCount > 0) {
-        FreeForDisplayModel(cache[0]->dm);
+        FreePage(cache[0]->dm);
     }
-    while (requestCount > 0) {
-        ClearQueueForDisplayModel(requests[0].dm);
+    for (int i = 0; i < nWorkers; i++) {
+        Vec<PageRenderRequest*>& queue = workers[i].queue;
+        while (queue.size() > 0) {
+            ClearQueueForDisplayModel(queue.at(0)->dm);
+        }
     }
-    AbortCurrentRequest();
+    AbortCurrentRequests();
 
     return true;
 }
 
 void RenderCache::RequestRendering(DisplayModel* dm, int pageNo) {
+    UpdateVisibleParts(dm);
     TilePosition tile(GetTileRes(dm, pageNo), 0, 0);
     // only honor the request if there's a good chance that the
     // rendered tile will actually be used
@@ -415,46 +823,129 @@ void RenderCache::RequestRendering(DisplayModel* dm, int pageNo) {
 /* Render a bitmap for page <pageNo> in <dm>. */
 void RenderCache::RequestRendering(DisplayModel* dm, int pageNo, TilePosition tile, bool clearQueueForPage) {
     dbglogf("RenderCache::RequestRendering(): pageNo %d\n", pageNo);
-    ScopedCritSec scope(&requestAccess);
     CrashIf(!dm);
     if (!dm || dm->dontRenderFlag) {
         return;
     }
 
-    int rotation = NormalizeRotation(dm->GetRotation());
-    float zoom = dm->GetZoomReal(pageNo);
+    PostedRequest req;
+    req.dm = dm;
+    req.pageNo = pageNo;
+    req.rotation = NormalizeRotation(dm->GetRotation());
+    req.zoom = dm->GetZoomReal(pageNo);
+    req.tile = tile;
+    req.clearQueueForPage = clearQueueForPage;
+    PostRequest(req);
+}
 
-    if (curReq && (curReq->pageNo == pageNo) && (curReq->dm == dm) && (curReq->tile == tile)) {
-        if ((curReq->zoom == zoom) && (curReq->rotation == rotation)) {
-            /* we're already rendering exactly the same page */
-            return;
+/* Render the whole page at a fraction of the current zoom level, so that
+   there's something to show (scaled up) right away while the tiles at the
+   current zoom level are rendered (e.g. after zooming in). */
+void RenderCache::RequestDraftRendering(DisplayModel* dm, int pageNo) {
+    CrashIf(!dm);
+    if (!dm || dm->dontRenderFlag) {
+        return;
+    }
+
+    PostedRequest req;
+    req.dm = dm;
+    req.pageNo = pageNo;
+    req.rotation = NormalizeRotation(dm->GetRotation());
+    req.zoom = dm->GetZoomReal(pageNo) * DRAFT_ZOOM_FACTOR;
+    req.tile = TilePosition(0, 0, 0);
+    req.isDraft = true;
+    PostRequest(req);
+}
+
+// queues req right away unless a rendering thread currently holds requestAccess
+// (requests are made while painting, which mustn't wait for rendering threads)
+void RenderCache::PostRequest(PostedRequest& req) {
+    if (TryEnterCriticalSection(&requestAccess)) {
+        QueueRequest(req);
+        LeaveCriticalSection(&requestAccess);
+        return;
+    }
+    auto posted = new PostedRequest(req);
+    InterlockedPushEntrySList(&postedRequests, &posted->next);
+    // make sure that a rendering thread gets to queue it
+    ReleaseSemaphore(startRendering, 1, nullptr);
+}
+
+// queues the requests posted while requestAccess was held in the order in
+// which they were made. Must be called within requestAccess
+void RenderCache::QueuePostedRequests() {
+    Vec<PostedRequest*> posted;
+    for (PSLIST_ENTRY e = InterlockedFlushSList(&postedRequests); e; e = e->Next) {
+        posted.Append((PostedRequest*)e);
+    }
+    // the list is in LIFO order
+    posted.Reverse();
+    for (PostedRequest* req : posted) {
+        QueueRequest(*req);
+        delete req;
+    }
+}
+
+// must be called within requestAccess
+void RenderCache::QueueRequest(PostedRequest& req) {
+    DisplayModel* dm = req.dm;
+    int pageNo = req.pageNo;
+    int rotation = req.rotation;
+    float zoom = req.zoom;
+    TilePosition tile = req.tile;
+    if (dm->dontRenderFlag) {
+        return;
+    }
+
+    if (req.isDraft) {
+        for (int i = 0; i < nWorkers; i++) {
+            PageRenderRequest* curReq = workers[i].curReq;
+            if (curReq && curReq->pageNo == pageNo && curReq->dm == dm && curReq->tile == tile) {
+                return;
+            }
+            for (PageRenderRequest* queued : workers[i].queue) {
+                if (queued->isDraft && queued->pageNo == pageNo && queued->dm == dm) {
+                    return;
+                }
+            }
+        }
+        Render(dm, pageNo, rotation, zoom, &tile, nullptr, nullptr, true);
+        return;
+    }
+
+    for (int i = 0; i < nWorkers; i++) {
+        PageRenderRequest* curReq = workers[i].curReq;
+        if (curReq && !curReq->isDraft && (curReq->pageNo == pageNo) && (curReq->dm == dm) && (curReq->tile == tile)) {
+            if ((curReq->zoom == zoom) && (curReq->rotation == rotation)) {
+                /* we're already rendering exactly the same page */
+                return;
+            }
+            /* Currently rendered page is for the same page but with different zoom
+            or rotation, so abort it */
+            AbortRequest(curReq);
         }
-        /* Currently rendered page is for the same page but with different zoom
-        or rotation, so abort it */
-        AbortCurrentRequest();
     }
 
     // clear requests for tiles of different resolution and invisible tiles
-    if (clearQueueForPage) {
+    if (req.clearQueueForPage) {
         ClearQueueForDisplayModel(dm, pageNo, &tile);
     }
 
-    for (int i = 0; i < requestCount; i++) {
-        PageRenderRequest* req = &(requests[i]);
-        if ((req->pageNo == pageNo) && (req->dm == dm) && (req->tile == tile)) {
-            if ((req->zoom == zoom) && (req->rotation == rotation)) {
+    for (int i = 0; i < nWorkers; i++) {
+        for (PageRenderRequest* queued : workers[i].queue) {
+            if (queued->isDraft || (queued->pageNo != pageNo) || (queued->dm != dm) || !(queued->tile == tile)) {
+                continue;
+            }
+            if ((queued->zoom == zoom) && (queued->rotation == rotation)) {
                 /* Request with exactly the same parameters already queued for
-                   rendering. Move it to the top of the queue so that it'll
+                   rendering. Make it the most recent request so that it'll
                    be rendered faster. */
-                PageRenderRequest tmp;
-                tmp = requests[requestCount - 1];
-                requests[requestCount - 1] = *req;
-                *req = tmp;
+                queued->seq = ++requestSeq;
             } else {
                 /* There was a request queued for the same page but with different
                    zoom or rotation, so only replace this request */
-                req->zoom = zoom;
-                req->rotation = rotation;
+                queued->zoom = zoom;
+                queued->rotation = rotation;
             }
             return;
         }
@@ -478,7 +969,7 @@ void RenderCache::Render(DisplayModel* dm, int pageNo, int rotation, float zoom,
 }
 
 bool RenderCache::Render(DisplayModel* dm, int pageNo, int rotation, float zoom, TilePosition* tile, RectF* pageRect,
-                         RenderingCallback* renderCb) {
+                         RenderingCallback* renderCb, bool isDraft) {
     dbglogf("RenderCache::Render(): pageNo %d\n", pageNo);
     CrashIf(!dm);
     if (!dm || dm->dontRenderFlag) {
@@ -490,29 +981,31 @@ bool RenderCache::Render(DisplayModel* dm, int pageNo, int rotation, float zoom,
         return false;
     }
 
+    // the engine mustn't be called within requestAccess (see IsTileVisible)
+    RectF tileRect;
+    if (tile) {
+        tileRect = GetTileRectUser(dm->GetEngine(), pageNo, rotation, zoom, *tile);
+    }
+
     ScopedCritSec scope(&requestAccess);
-    PageRenderRequest* newRequest;
 
-    /* add request to the queue */
-    if (requestCount == MAX_PAGE_REQUESTS) {
-        /* queue is full -> remove the oldest items on the queue */
-        if (requests[0].renderCb) {
-            requests[0].renderCb->Callback();
-        }
-        memmove(&(requests[0]), &(requests[1]), sizeof(PageRenderRequest) * (MAX_PAGE_REQUESTS - 1));
-        newRequest = &(requests[MAX_PAGE_REQUESTS - 1]);
-    } else {
-        newRequest = &(requests[requestCount]);
-        requestCount++;
+    if (IsRenderQueueFull()) {
+        /* queue is full -> remove the oldest of the least important requests */
+        DropLeastUrgentRequest(this);
     }
-    CrashIf(requestCount > MAX_PAGE_REQUESTS);
+
+    /* add request to the queue of the worker responsible for the page */
+    RenderWorker* worker = &workers[pageNo % nWorkers];
+    PageRenderRequest* newRequest = new PageRenderRequest();
+    worker->queue.Append(newRequest);
+    requestCount++;
 
     newRequest->dm = dm;
     newRequest->pageNo = pageNo;
     newRequest->rotation = rotation;
     newRequest->zoom = zoom;
     if (tile) {
-        newRequest->pageRect = GetTileRectUser(dm->GetEngine(), pageNo, rotation, zoom, *tile);
+        newRequest->pageRect = tileRect;
         newRequest->tile = *tile;
     } else if (pageRect) {
         newRequest->pageRect = *pageRect;
@@ -524,56 +1017,126 @@ bool RenderCache::Render(DisplayModel* dm, int pageNo, int rotation, float zoom,
     newRequest->abort = false;
     newRequest->abortCookie = nullptr;
     newRequest->timestamp = GetTickCount();
+    newRequest->seq = ++requestSeq;
     newRequest->renderCb = renderCb;
+    newRequest->isDraft = isDraft;
 
-    SetEvent(startRendering);
+    ReleaseSemaphore(startRendering, 1, nullptr);
 
     return true;
 }
 
 int RenderCache::GetRenderDelay(DisplayModel* dm, int pageNo, TilePosition tile) {
-    ScopedCritSec scope(&requestAccess);
+    // don't wait for a rendering thread holding requestAccess. If the tile
+    // has already been requested, requesting it again won't change a thing
+    if (!TryEnterCriticalSection(&requestAccess)) {
+        return RENDER_DELAY_UNDEFINED;
+    }
 
-    if (curReq && curReq->pageNo == pageNo && curReq->dm == dm && curReq->tile == tile) {
-        return GetTickCount() - curReq->timestamp;
+    DWORD timestamp = 0;
+    bool isRequested = false;
+    for (int i = 0; i < nWorkers && !isRequested; i++) {
+        PageRenderRequest* curReq = workers[i].curReq;
+        if (curReq && curReq->pageNo == pageNo && curReq->dm == dm && curReq->tile == tile) {
+            timestamp = curReq->timestamp;
+            isRequested = true;
+        }
     }
 
-    for (int i = 0; i < requestCount; i++) {
-        if (requests[i].pageNo == pageNo && requests[i].dm == dm && requests[i].tile == tile) {
-            return GetTickCount() - requests[i].timestamp;
+    for (int i = 0; i < nWorkers && !isRequested; i++) {
+        for (PageRenderRequest* req : workers[i].queue) {
+            if (req->pageNo == pageNo && req->dm == dm && req->tile == tile) {
+                timestamp = req->timestamp;
+                isRequested = true;
+                break;
+            }
         }
     }
 
-    return RENDER_DELAY_UNDEFINED;
+    LeaveCriticalSection(&requestAccess);
+    return isRequested ? GetTickCount() - timestamp : RENDER_DELAY_UNDEFINED;
 }
 
-bool RenderCache::GetNextRequest(PageRenderRequest* req) {
+// must be called within requestAccess
+static bool IsPageRenderedByOtherWorker(RenderCache* rc, RenderWorker* worker, PageRenderRequest* req) {
+    for (int i = 0; i < rc->nWorkers; i++) {
+        PageRenderRequest* curReq = rc->workers[i].curReq;
+        if (&rc->workers[i] != worker && curReq && curReq->dm == req->dm && curReq->pageNo == req->pageNo) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// picks the most urgent request, preferring the worker's own queue
+// and stealing from other workers' queues only if they have more
+// urgent requests or the worker's own queue is empty.
+// Tiles of a page are never rendered by two workers at the same time
+// (not all engines can render the same page concurrently)
+bool RenderCache::GetNextRequest(RenderWorker* worker, PageRenderRequest* req) {
     ScopedCritSec scope(&requestAccess);
+    QueuePostedRequests();
 
     if (requestCount == 0) {
         return false;
     }
 
-    CrashIf(requestCount < 0);
-    CrashIf(requestCount > MAX_PAGE_REQUESTS);
+    RenderWorker* owner = nullptr;
+    int bestIdx = -1;
+    RenderPriority bestPrio = RenderPriority::Thumbnail;
+    for (int i = 0; i < nWorkers; i++) {
+        RenderWorker* w = &workers[(worker->workerNo + i) % nWorkers];
+        int n = w->queue.isize();
+        for (int j = 0; j < n; j++) {
+            PageRenderRequest* r = w->queue.at(j);
+            if (IsPageRenderedByOtherWorker(this, worker, r)) {
+                continue;
+            }
+            RenderPriority prio = GetRenderPriority(this, r);
+            if (owner) {
+                if (prio > bestPrio) {
+                    continue;
+                }
+                if (prio == bestPrio && (w != owner || r->seq < owner->queue.at(bestIdx)->seq)) {
+                    continue;
+                }
+            }
+            owner = w;
+            bestIdx = j;
+            bestPrio = prio;
+        }
+    }
+    if (!owner) {
+        return false;
+    }
+
+    PageRenderRequest* next = owner->queue.PopAt(bestIdx);
     requestCount--;
-    *req = requests[requestCount];
-    curReq = req;
     CrashIf(requestCount < 0);
+    *req = *next;
+    delete next;
+    worker->curReq = req;
     CrashIf(req->abort);
 
     return true;
 }
 
-bool RenderCache::ClearCurrentRequest() {
+void RenderCache::ClearCurrentRequest(RenderWorker* worker) {
     ScopedCritSec scope(&requestAccess);
-    if (curReq) {
-        delete curReq->abortCookie;
+    if (worker->curReq) {
+        delete worker->curReq->abortCookie;
     }
-    curReq = nullptr;
+    worker->curReq = nullptr;
+}
 
-    bool isQueueEmpty = requestCount == 0;
-    return isQueueEmpty;
+bool RenderCache::IsRenderingForDisplayModel(DisplayModel* dm) {
+    ScopedCritSec scope(&requestAccess);
+    for (int i = 0; i < nWorkers; i++) {
+        if (workers[i].curReq && workers[i].curReq->dm == dm) {
+            return true;
+        }
+    }
+    return false;
 }
 
 /* Wait until rendering of a page beloging to <dm> has finished. */
@@ -584,14 +1147,16 @@ void RenderCache::CancelRendering(DisplayModel* dm) {
 
     for (;;) {
         EnterCriticalSection(&requestAccess);
-        if (!curReq || (curReq->dm != dm)) {
+        if (!IsRenderingForDisplayModel(dm)) {
+            // requests might have been posted in the meantime
+            QueuePostedRequests();
             // to be on the safe side
             ClearQueueForDisplayModel(dm);
             LeaveCriticalSection(&requestAccess);
             return;
         }
 
-        AbortCurrentRequest();
+        AbortCurrentRequests(dm);
         LeaveCriticalSection(&requestAccess);
 
         /* TODO: busy loop is not good, but I don't have a better idea */
@@ -601,57 +1166,62 @@ void RenderCache::CancelRendering(DisplayModel* dm) {
 
 void RenderCache::ClearQueueForDisplayModel(DisplayModel* dm, int pageNo, TilePosition* tile) {
     ScopedCritSec scope(&requestAccess);
-    int reqCount = requestCount;
-    int curPos = 0;
-    for (int i = 0; i < reqCount; i++) {
-        PageRenderRequest* req = &(requests[i]);
-        bool shouldRemove = req->dm == dm && (pageNo == INVALID_PAGE_NO || req->pageNo == pageNo) &&
-                            (!tile || req->tile.res != tile->res || !IsTileVisible(dm, req->pageNo, *tile, 0.5));
-        if (i != curPos) {
-            requests[curPos] = requests[i];
-        }
-        if (shouldRemove) {
+    VisibleParts* vis = tile ? GetVisibleParts(dm) : nullptr;
+    for (int i = 0; i < nWorkers; i++) {
+        Vec<PageRenderRequest*>& queue = workers[i].queue;
+        for (int j = queue.isize() - 1; j >= 0; j--) {
+            PageRenderRequest* req = queue.at(j);
+            // drafts are only useful while the tiles at tile->res are missing
+            bool shouldRemove =
+                req->dm == dm && (pageNo == INVALID_PAGE_NO || req->pageNo == pageNo) &&
+                (!tile || !req->isDraft && (req->tile.res != tile->res || !IsTileVisible(vis, req->pageNo, *tile, 0.5)));
+            if (!shouldRemove) {
+                continue;
+            }
             if (req->renderCb) {
                 req->renderCb->Callback();
             }
+            queue.RemoveAt(j);
+            delete req;
             requestCount--;
-        } else {
-            curPos++;
         }
     }
+    DropVisibleParts(vis);
 }
 
-void RenderCache::AbortCurrentRequest() {
+// aborts requests currently being rendered (for a given DisplayModel and page)
+void RenderCache::AbortCurrentRequests(DisplayModel* dm, int pageNo) {
     ScopedCritSec scope(&requestAccess);
-    if (!curReq) {
-        return;
-    }
-    if (curReq->abortCookie) {
-        curReq->abortCookie->Abort();
+    for (int i = 0; i < nWorkers; i++) {
+        PageRenderRequest* curReq = workers[i].curReq;
+        if (!curReq || (dm && curReq->dm != dm) || (pageNo != INVALID_PAGE_NO && curReq->pageNo != pageNo)) {
+            continue;
+        }
+        AbortRequest(curReq);
     }
-    curReq->abort = true;
 }
 
 DWORD WINAPI RenderCache::RenderCacheThread(LPVOID data) {
-    RenderCache* cache = (RenderCache*)data;
+    RenderWorker* worker = (RenderWorker*)data;
+    RenderCache* cache = worker->cache;
     PageRenderRequest req;
     RenderedBitmap* bmp;
 
     for (;;) {
-        if (cache->ClearCurrentRequest()) {
-            DWORD waitResult = WaitForSingleObject(cache->startRendering, INFINITE);
-            // Is it not a page render request?
-            if (WAIT_OBJECT_0 != waitResult) {
-                continue;
-            }
-        }
-
-        if (!cache->GetNextRequest(&req)) {
+        cache->ClearCurrentRequest(worker);
+        if (!cache->GetNextRequest(worker, &req)) {
+            // nothing (we're allowed) to render, so wait for new requests
+            WaitForSingleObject(cache->startRendering, INFINITE);
             continue;
         }
 
-        if (!req.dm->PageVisibleNearby(req.pageNo) && !req.renderCb) {
-            continue;
+        if (!req.renderCb) {
+            VisibleParts* vis = cache->GetVisibleParts(req.dm);
+            bool isNearby = vis && vis->GetPage(req.pageNo);
+            cache->DropVisibleParts(vis);
+            if (!isNearby) {
+                continue;
+            }
         }
 
         if (req.dm->dontRenderFlag) {
@@ -661,10 +1231,16 @@ DWORD WINAPI RenderCache::RenderCacheThread(LPVOID data) {
             continue;
         }
 
+        if (req.isDraft && cache->Exists(req.dm, req.pageNo, req.rotation, INVALID_ZOOM, &req.tile)) {
+            // the page has been rendered in the meantime
+            continue;
+        }
+
         // make sure that we have extracted page text for
         // all rendered pages to allow text selection and
         // searching without any further delays
-        if (!req.dm->textCache->HasTextForPage(req.pageNo)) {
+        // (but show drafts as quickly as possible)
+        if (!req.isDraft && !req.dm->textCache->HasTextForPage(req.pageNo)) {
             req.dm->textCache->GetTextForPage(req.pageNo);
         }
 
@@ -796,10 +1372,11 @@ int RenderCache::Paint(HDC hdc, Rect bounds, DisplayModel* dm, int pageNo, PageI
     if (!dm->ShouldCacheRendering(pageNo)) {
         int rotation = dm->GetRotation();
         float zoom = dm->GetZoomReal(pageNo);
-        bounds = pageInfo->pageOnScreen.Intersect(bounds);
+        Rect pageOnScreen = dm->PageOnScreen(pageNo);
+        bounds = pageOnScreen.Intersect(bounds);
 
         RectF area = ToRectFl(bounds);
-        area.Offset(-pageInfo->pageOnScreen.x, -pageInfo->pageOnScreen.y);
+        area.Offset(-pageOnScreen.x, -pageOnScreen.y);
         area = dm->GetEngine()->Transform(area, pageNo, zoom, rotation, true);
 
         RenderPageArgs args(pageNo, zoom, rotation, &area);
@@ -810,6 +1387,8 @@ int RenderCache::Paint(HDC hdc, Rect bounds, DisplayModel* dm, int pageNo, PageI
         return success ? 0 : RENDER_DELAY_FAILED;
     }
 
+    UpdateVisibleParts(dm);
+    Rect pageOnScreen = dm->PageOnScreen(pageNo);
     int rotation = dm->GetRotation();
     float zoom = dm->GetZoomReal(pageNo);
     USHORT targetRes = GetTileRes(dm, pageNo);
@@ -818,6 +1397,13 @@ int RenderCache::Paint(HDC hdc, Rect bounds, DisplayModel* dm, int pageNo, PageI
         maxRes = targetRes;
     }
 
+    // without at least a whole page bitmap (at any zoom level) to scale up,
+    // nothing would be shown until all visible tiles have been rendered
+    TilePosition pageTile(0, 0, 0);
+    if (targetRes > 0 && !isRemoteSession && !Exists(dm, pageNo, rotation, INVALID_ZOOM, &pageTile)) {
+        RequestDraftRendering(dm, pageNo);
+    }
+
     Vec<TilePosition> queue;
     queue.Append(TilePosition(0, 0, 0));
     int renderDelayMin = RENDER_DELAY_UNDEFINED;
@@ -825,13 +1411,13 @@ int RenderCache::Paint(HDC hdc, Rect bounds, DisplayModel* dm, int pageNo, PageI
 
     while (queue.size() > 0) {
         TilePosition tile = queue.PopAt(0);
-        Rect tileOnScreen = GetTileOnScreen(dm->GetEngine(), pageNo, rotation, zoom, tile, pageInfo->pageOnScreen);
+        Rect tileOnScreen = GetTileOnScreen(dm->GetEngine(), pageNo, rotation, zoom, tile, pageOnScreen);
         if (tileOnScreen.IsEmpty()) {
             // display an error message when only empty tiles should be drawn (i.e. on page loading errors)
             renderDelayMin = std::min(RENDER_DELAY_FAILED, renderDelayMin);
             continue;
         }
-        tileOnScreen = pageInfo->pageOnScreen.Intersect(tileOnScreen);
+        tileOnScreen = pageOnScreen.Intersect(tileOnScreen);
         Rect isect = bounds.Intersect(tileOnScreen);
         if (isect.IsEmpty()) {
             continue;
@@ -861,16 +1447,11 @@ int RenderCache::Paint(HDC hdc, Rect bounds, DisplayModel* dm, int pageNo, PageI
     }
 
 #ifdef CONSERVE_MEMORY
-    if (!neededScaling) {
-        if (renderOutOfDateCue) {
-            *renderOutOfDateCue = false;
-        }
-        // free tiles with different resolution
-        TilePosition tile(targetRes, (USHORT)-1, 0);
-        dbglogf("RenderCache::Paint: calling FreePage() pageNo: %d\n", pageNo);
-        FreePage(dm, pageNo, &tile);
+    if (!neededScaling && renderOutOfDateCue) {
+        *renderOutOfDateCue = false;
     }
-    FreeNotVisible();
+    // free tiles with different resolution (unless still needed for scaling)
+    FreeAfterPaint(dm, pageNo, targetRes, !neededScaling);
 #endif
 
     return renderDelayMin;
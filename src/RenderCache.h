@@ -6,12 +6,26 @@ constexpr int RENDER_DELAY_UNDEFINED = std::numeric_limits<int>::max() - 2;
 
 #define INVALID_TILE_RES ((USHORT)-1)
 
+// maximum number of queued requests per rendering thread
 #define MAX_PAGE_REQUESTS 8
-// keep this value reasonably low, else we'll run out of
-// GDI resources/memory when caching many larger bitmaps
-// TODO: this should be based on amount of memory taken by rendered pages
-// i.e. one big page can use as much memory as lots of small pages
-#define MAX_BITMAPS_CACHED 64
+// maximum number of threads rendering pages in parallel
+#define MAX_RENDER_THREADS 8
+// upper limit for the number of cached bitmaps (each one is a GDI object)
+#define MAX_BITMAPS_CACHED 256
+// the memory budget for cached bitmaps is enough for this many
+// screen-sized bitmaps (within the limits below)
+#define CACHE_MEMORY_SCREENS 16
+#define MIN_CACHE_MEMORY (32 * 1024 * 1024)
+#ifdef _WIN64
+#define MAX_CACHE_MEMORY (1024 * 1024 * 1024)
+#else
+#define MAX_CACHE_MEMORY (256 * 1024 * 1024)
+#endif
+#define BITMAP_CACHE_BUCKETS (2 * MAX_BITMAPS_CACHED)
+// number of reclaimed lookup tables kept for reuse
+#define MAX_FREE_TABLES 4
+// drafts are rendered at this fraction of the requested zoom level
+#define DRAFT_ZOOM_FACTOR 0.25f
 
 class RenderingCallback {
   public:
@@ -40,19 +54,28 @@ struct TilePosition {
 
 /* We keep a cache of rendered bitmaps. BitmapCacheEntry keeps data
    that uniquely identifies rendered page (dm, pageNo, rotation, zoom)
-   and the corresponding rendered bitmap. */
+   and the corresponding rendered bitmap.
+   dm, zoom and outOfDate are only modified with cacheAccess held but
+   can be read at any time by lock-free lookups (see BitmapCacheTable). */
 struct BitmapCacheEntry {
     DisplayModel* dm = nullptr;
     int pageNo = 0;
     int rotation = 0;
     float zoom = 0.f;
     TilePosition tile;
-    int cacheIdx = -1; // index within RenderCache.cache
+    int cacheIdx = -1; // index within RenderCache.cache, -1 once removed
 
     // owned by the BitmapCacheEntry
     RenderedBitmap* bitmap = nullptr;
+    // memory used by bitmap
+    size_t bytes = 0;
+    // last time (GetTickCount()) the bitmap was looked up
+    // (use Interlocked* to access, as it's updated by lock-free lookups)
+    LONG lastUsed = 0;
     bool outOfDate = false;
-    int refs = 1;
+    // one reference is held by RenderCache until the entry is removed,
+    // the others by callers of RenderCache::Find (use Interlocked* to modify)
+    LONG refs = 1;
 
     BitmapCacheEntry(DisplayModel* dm, int pageNo, int rotation, float zoom, TilePosition tile,
                      RenderedBitmap* bitmap) {
@@ -82,24 +105,143 @@ struct PageRenderRequest {
     bool abort = false;
     AbortCookie* abortCookie = nullptr;
     DWORD timestamp = 0;
+    // incremented when re-requested so that the most recently
+    // requested page is rendered first among those of equal priority
+    int seq = 0;
+    // a quick low resolution rendering of the whole page, shown
+    // (scaled up) until the tiles at the requested zoom are available
+    bool isDraft = false;
     // owned by the PageRenderRequest (use it before reusing the request)
     // on rendering success, the callback gets handed the RenderedBitmap
     RenderingCallback* renderCb = nullptr;
 };
 
+/* A rendering request made by the UI thread while requestAccess was held
+   by a rendering thread. It's queued by the next rendering thread to take
+   requestAccess instead, so that painting never waits for requestAccess
+   (see RenderCache::QueueRequest) */
+struct PostedRequest {
+    // must come first (see InterlockedPushEntrySList)
+    SLIST_ENTRY next;
+    DisplayModel* dm = nullptr;
+    int pageNo = 0;
+    int rotation = 0;
+    float zoom = 0.f;
+    TilePosition tile;
+    bool isDraft = false;
+    bool clearQueueForPage = true;
+};
+
+// order in which queued requests are rendered (lower values first)
+enum class RenderPriority {
+    // drafts of visible pages for which nothing is cached
+    Draft = 0,
+    // tiles currently visible on screen
+    Visible,
+    // tiles of pages just above or below the visible ones
+    Prefetch,
+    // requests with a callback (e.g. for thumbnails)
+    Thumbnail,
+};
+
+/* Immutable snapshot of the cached bitmaps hashed by (dm, pageNo, rotation)
+   so that Find() doesn't have to take cacheAccess. A new table is published
+   whenever the cache changes. Retired tables and removed entries are only
+   freed once no reader can still see them (see RenderCache::EnterReader). */
+struct BitmapCacheTable {
+    // entries of bucket i are entries[bucketStart[i]] to entries[bucketStart[i + 1] - 1]
+    int bucketStart[BITMAP_CACHE_BUCKETS + 1]{};
+    BitmapCacheEntry* entries[MAX_BITMAPS_CACHED]{};
+    int nEntries = 0;
+};
+
+struct VisiblePage {
+    int pageNo = 0;
+    // false for pages which are merely in a row next to a visible one
+    bool isVisible = false;
+    Rect pageOnScreen;
+};
+
+/* What's visible of a DisplayModel as of its last RecalcVisibleParts().
+   The UI thread publishes a copy (see RenderCache::UpdateVisibleParts) so
+   that rendering threads don't have to look at the DisplayModel's layout
+   while the UI thread changes it. Immutable once published */
+struct VisibleParts {
+    DisplayModel* dm = nullptr;
+    // DisplayModel::visiblePartsVersion this is a copy of
+    int version = 0;
+    int rotation = 0;
+    Size viewPortSize;
+    int currentPageNo = 0;
+    int pageCount = 0;
+    // visible pages and the pages in the rows above and below them
+    Vec<VisiblePage> pages;
+    // references are held by RenderCache and by GetVisibleParts callers
+    LONG refs = 1;
+
+    const VisiblePage* GetPage(int pageNo) const {
+        for (const VisiblePage& page : pages) {
+            if (page.pageNo == pageNo) {
+                return &page;
+            }
+        }
+        return nullptr;
+    }
+};
+
+class RenderCache;
+
+/* Each rendering thread has its own queue. Requests are queued with the
+   worker owning the page (so that tiles of a page are rendered by the same
+   thread) and idle workers steal requests from the queues of others. */
+struct RenderWorker {
+    RenderCache* cache = nullptr;
+    int workerNo = 0;
+    HANDLE thread = nullptr;
+    // queue and curReq are protected by RenderCache::requestAccess
+    Vec<PageRenderRequest*> queue;
+    PageRenderRequest* curReq = nullptr;
+};
+
 class RenderCache {
   public:
     BitmapCacheEntry* cache[MAX_BITMAPS_CACHED]{};
     int cacheCount = 0;
+    // memory used by all cached bitmaps
+    size_t cacheBytes = 0;
+    // bitmaps are evicted when they'd use more memory than this
+    size_t maxCacheBytes = 0;
+    // the table used for lookups (swapped with InterlockedExchangePointer)
+    BitmapCacheTable* table = nullptr;
+    // epoch based reclamation: readers register with readers[epoch & 1],
+    // tables and entries retired during an epoch go into retired*[epoch & 1]
+    // and are freed once all readers of that epoch are gone
+    LONG epoch = 0;
+    LONG readers[2]{};
+    Vec<BitmapCacheTable*> retiredTables[2];
+    Vec<BitmapCacheEntry*> retiredEntries[2];
+    // reclaimed tables to be reused by PublishTable
+    Vec<BitmapCacheTable*> freeTables;
+    // set by Paint if it couldn't free invisible tiles right away
+    // because cacheAccess was held (they're then freed in Add)
+    LONG freeNotVisiblePending = 0;
     // make sure to never ask for requestAccess in a cacheAccess
     // protected critical section in order to avoid deadlocks
     CRITICAL_SECTION cacheAccess;
 
-    PageRenderRequest requests[MAX_PAGE_REQUESTS]{};
+    RenderWorker workers[MAX_RENDER_THREADS];
+    int nWorkers = 0;
+    // total number of requests queued with all workers
     int requestCount = 0;
-    PageRenderRequest* curReq = nullptr;
+    int requestSeq = 0;
     CRITICAL_SECTION requestAccess;
-    HANDLE renderThread = nullptr;
+    // requests to be queued once requestAccess is available (see PostedRequest)
+    SLIST_HEADER postedRequests;
+
+    // what's visible of every DisplayModel that's being rendered
+    Vec<VisibleParts*> visibleParts;
+    // only held for accessing visibleParts (no other lock may be taken with it)
+    CRITICAL_SECTION visiblePartsAccess;
 
     Size maxTileSize{};
     bool isRemoteSession = false;
@@ -107,7 +249,8 @@ class RenderCache {
     COLORREF textColor = 0;
     COLORREF backgroundColor = 0;
 
-    /* Interface for page rendering thread */
+    /* Interface for page rendering threads (a semaphore
+       released once for every queued request) */
     HANDLE startRendering = nullptr;
 
     RenderCache();
@@ -127,8 +270,12 @@ class RenderCache {
     // painted, 0 if something has been painted and RENDER_DELAY_FAILED on failure
     int Paint(HDC hdc, Rect bounds, DisplayModel* dm, int pageNo, PageInfo* pageInfo, bool* renderOutOfDateCue);
 
-    bool ClearCurrentRequest();
-    bool GetNextRequest(PageRenderRequest* req);
+    void UpdateVisibleParts(DisplayModel* dm);
+    VisibleParts* GetVisibleParts(DisplayModel* dm);
+    void DropVisibleParts(VisibleParts* vis);
+
+    void ClearCurrentRequest(RenderWorker* worker);
+    bool GetNextRequest(RenderWorker* worker, PageRenderRequest* req);
     void Add(PageRenderRequest& req, RenderedBitmap* bmp);
 
     USHORT GetTileRes(DisplayModel* dm, int pageNo);
@@ -136,22 +283,33 @@ class RenderCache {
     bool ReduceTileSize();
 
     bool IsRenderQueueFull() const {
-        return requestCount == MAX_PAGE_REQUESTS;
+        return requestCount >= MAX_PAGE_REQUESTS * nWorkers;
     }
     int GetRenderDelay(DisplayModel* dm, int pageNo, TilePosition tile);
     void RequestRendering(DisplayModel* dm, int pageNo, TilePosition tile, bool clearQueueForPage = true);
+    void RequestDraftRendering(DisplayModel* dm, int pageNo);
+    void PostRequest(PostedRequest& req);
+    void QueueRequest(PostedRequest& req);
+    void QueuePostedRequests();
     bool Render(DisplayModel* dm, int pageNo, int rotation, float zoom, TilePosition* tile = nullptr,
-                RectF* pageRect = nullptr, RenderingCallback* renderCb = nullptr);
+                RectF* pageRect = nullptr, RenderingCallback* renderCb = nullptr, bool isDraft = false);
     void ClearQueueForDisplayModel(DisplayModel* dm, int pageNo = INVALID_PAGE_NO, TilePosition* tile = nullptr);
-    void AbortCurrentRequest();
+    void AbortCurrentRequests(DisplayModel* dm = nullptr, int pageNo = INVALID_PAGE_NO);
+    bool IsRenderingForDisplayModel(DisplayModel* dm);
 
     static DWORD WINAPI RenderCacheThread(LPVOID data);
 
     BitmapCacheEntry* Find(DisplayModel* dm, int pageNo, int rotation, float zoom = INVALID_ZOOM,
                            TilePosition* tile = nullptr);
     bool DropCacheEntry(BitmapCacheEntry* entry);
+    void RemoveCacheEntry(BitmapCacheEntry* entry);
+    void PublishTable();
+    int EnterReader();
+    void LeaveReader(int readerSlot);
+    void ReclaimRetired();
     void FreePage(DisplayModel* dm = nullptr, int pageNo = -1, TilePosition* tile = nullptr);
     void FreeNotVisible();
+    void FreeAfterPaint(DisplayModel* dm, int pageNo, USHORT targetRes, bool freeOtherRes);
 
     int PaintTile(HDC hdc, Rect bounds, DisplayModel* dm, int pageNo, TilePosition tile, Rect tileOnScreen,
                   bool renderMissing, bool* renderOutOfDateCue, bool* renderedReplacement);
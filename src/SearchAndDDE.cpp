@@ -338,6 +338,9 @@ static DWORD WINAPI FindThread(LPVOID data) {
             rect = dm->textSearch->FindFirst(startPage, ftd->text, ftd);
         }
     }
+    // the background extraction started by TextSearch (see
+    // DocumentTextCache::StartExtraction) isn't needed anymore
+    dm->textCache->StopExtraction();
 
     // wait for FindTextOnThread to return so that
     // FindEndTask closes the correct handle to
@@ -403,7 +406,7 @@ void PaintForwardSearchMark(WindowInfo* win, HDC hdc) {
         rect = dm->CvtToScreen(pageNo, ToRectFl(rect));
         if (hiLiOff > 0) {
             float zoom = dm->GetZoomReal(pageNo);
-            rect.x = std::max(pageInfo->pageOnScreen.x, 0) + (int)(hiLiOff * zoom);
+            rect.x = std::max(dm->PageOnScreen(pageNo).x, 0) + (int)(hiLiOff * zoom);
             rect.dx = (int)((hiLiWidth > 0 ? hiLiWidth : 15.0) * zoom);
             rect.y -= 4;
             rect.dy += 8;
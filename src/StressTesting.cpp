@@ -1,10 +1,16 @@
 /* Copyright 2020 the SumatraPDF project authors (see AUTHORS file).
    License: GPLv3 */
 
+extern "C" {
+#include <mupdf/fitz.h>
+#include <mupdf/pdf.h>
+}
+
 #include "utils/BaseUtil.h"
 #include "utils/ScopedWin.h"
 #include "utils/DirIter.h"
 #include "utils/FileUtil.h"
+#include "utils/FindSubstring.h"
 #include "utils/GuessFileType.h"
 #include "utils/GdiPlusUtil.h"
 #include "utils/HtmlParserLookup.h"
@@ -19,7 +25,9 @@
 #include "Annotation.h"
 #include "EngineBase.h"
 #include "EngineCreate.h"
+#include "EngineFzUtil.h"
 #include "EbookBase.h"
+#include "MobiDoc.h"
 #include "HtmlFormatter.h"
 #include "EbookFormatter.h"
 #include "Doc.h"
@@ -144,11 +152,512 @@ void BenchEbookLayout(const WCHAR* filePath) {
     TimeOneMethod(doc, TextRenderMethodGdiplus, L"gdi+      ");
     TimeOneMethod(doc, TextRenderMethodGdiplusQuick, L"gdi+ quick");
 
+    // gdi sums up the cached advance widths of most characters
+    // instead of measuring every word
+    SetUseGlyphAdvances(false);
+    TimeOneMethod(doc, TextRenderMethodGdi, L"gdi (no glyph advances)");
+    SetUseGlyphAdvances(true);
+
     doc.Delete();
 
     logf(L"pages: %d", nPages);
 }
 
+// text resembling extracted page text: words of mixed case
+static WCHAR* GenerateSearchBenchText(int nChars) {
+    static const WCHAR* words[] = {L"The",     L"quick",    L"brown", L"fox",  L"jumps", L"over", L"lazy",
+                                   L"dog",     L"Document", L"page",  L"text", L"Search", L"\x00e9t\x00e9",
+                                   L"Zusammen", L"\x0416\x0438\x0437\x043d\x044c"};
+    WCHAR* text = AllocArray<WCHAR>(nChars + 1);
+    int n = 0;
+    unsigned seed = 1;
+    while (n < nChars) {
+        seed = seed * 1103515245 + 12345;
+        const WCHAR* word = words[(seed >> 16) % dimof(words)];
+        for (const WCHAR* c = word; *c && n < nChars; c++) {
+            text[n++] = *c;
+        }
+        if (n < nChars) {
+            text[n++] = ' ';
+        }
+    }
+    return text;
+}
+
+static int CountMatches(const WCHAR* text, const WCHAR* s, bool reverse, TextSearchKernel kernel) {
+    int count = 0;
+    if (reverse) {
+        const WCHAR* end = text + str::Len(text);
+        while ((end = FindSubstringReverse(text, end, s, false, kernel)) != nullptr) {
+            count++;
+        }
+        return count;
+    }
+    for (const WCHAR* pos = text; (pos = FindSubstring(pos, s, false, kernel)) != nullptr; pos++) {
+        count++;
+    }
+    return count;
+}
+
+// compares the case-insensitive substring search used by TextSearch
+// with StrStrI/StrRStrI (which it replaced) on 16 MB of text
+void BenchTextSearch() {
+    const int nChars = 8 * 1024 * 1024;
+    AutoFreeWstr text(GenerateSearchBenchText(nChars));
+    const WCHAR* needles[] = {L"lazy dog", L"zusammen", L"\x0436\x0438\x0437\x043d\x044c", L"not found"};
+    const int nRuns = 5;
+
+    for (const WCHAR* s : needles) {
+        auto t = TimeGet();
+        int count = 0;
+        for (int i = 0; i < nRuns; i++) {
+            count = 0;
+            for (const WCHAR* pos = text; (pos = StrStrI(pos, s)) != nullptr; pos++) {
+                count++;
+            }
+        }
+        double timeMs = TimeSinceInMs(t) / nRuns;
+        logf(L"'%s': %d matches", s, count);
+        logf(L"  StrStrI:   %7.2f ms (%.0f MB/s)", timeMs, nChars * sizeof(WCHAR) / 1000.0 / timeMs);
+
+        t = TimeGet();
+        for (int i = 0; i < nRuns; i++) {
+            count = 0;
+            const WCHAR* end = text + nChars;
+            while ((end = StrRStrI(text, end, s)) != nullptr) {
+                count++;
+            }
+        }
+        timeMs = TimeSinceInMs(t) / nRuns;
+        logf(L"  StrRStrI:  %7.2f ms (%d matches)", timeMs, count);
+
+        TextSearchKernel kernels[] = {TextSearchKernel::Scalar, TextSearchKernel::SSE2, TextSearchKernel::AVX2};
+        const WCHAR* names[] = {L"scalar", L"sse2  ", L"avx2  "};
+        for (int k = 0; k < (int)dimof(kernels); k++) {
+            if (kernels[k] > GetBestTextSearchKernel()) {
+                continue;
+            }
+            for (int reverse = 0; reverse < 2; reverse++) {
+                t = TimeGet();
+                for (int i = 0; i < nRuns; i++) {
+                    count = CountMatches(text, s, reverse != 0, kernels[k]);
+                }
+                timeMs = TimeSinceInMs(t) / nRuns;
+                logf(L"  %s %s: %7.2f ms (%.0f MB/s, %d matches)", names[k], reverse ? L"rev" : L"fwd", timeMs,
+                     nChars * sizeof(WCHAR) / 1000.0 / timeMs, count);
+            }
+        }
+    }
+}
+
+// compares determining the size of all images in dir (and its sub-directories)
+// from their first 64 KB with decoding them completely
+void BenchImageSizes(const WCHAR* dir) {
+    const size_t headerSize = 64 * 1024;
+    int nImages = 0, nFromHeader = 0, nMismatches = 0;
+    double headerMs = 0, decodeMs = 0;
+
+    DirIter di(dir, true);
+    for (const WCHAR* path = di.First(); path; path = di.Next()) {
+        AutoFree data = file::ReadFile(path);
+        if (!data.data || GfxFormatFromData(data.AsSpan()) == ImgFormat::Unknown) {
+            continue;
+        }
+        nImages++;
+
+        std::span<u8> header{(u8*)data.data, std::min(data.size(), headerSize)};
+        auto t = TimeGet();
+        Size size = ImageSizeFromHeader(header);
+        headerMs += TimeSinceInMs(t);
+
+        t = TimeGet();
+        Gdiplus::Bitmap* bmp = BitmapFromData(data.AsSpan());
+        decodeMs += TimeSinceInMs(t);
+        if (size.IsEmpty()) {
+            logf(L"no size in header: %s", path);
+        } else {
+            nFromHeader++;
+            if (bmp && (size.dx != (int)bmp->GetWidth() || size.dy != (int)bmp->GetHeight())) {
+                nMismatches++;
+                logf(L"size mismatch: %s (%dx%d instead of %dx%d)", path, size.dx, size.dy, bmp->GetWidth(),
+                     bmp->GetHeight());
+            }
+        }
+        delete bmp;
+    }
+
+    logf(L"%d images, size from header for %d (%d mismatches)", nImages, nFromHeader, nMismatches);
+    logf(L"  header: %8.2f ms", headerMs);
+    logf(L"  decode: %8.2f ms", decodeMs);
+}
+
+// compares loading the Mobi files in dir (and its sub-directories) with
+// their text records decompressed sequentially and in parallel (and for
+// HuffDic compressed files, without caching expanded symbols)
+void BenchMobiLoad(const WCHAR* dir) {
+    const int nRuns = 3;
+    const WCHAR* names[] = {L"sequential, no symbol cache", L"sequential                 ",
+                            L"parallel                   "};
+
+    DirIter di(dir, true);
+    for (const WCHAR* path = di.First(); path; path = di.Next()) {
+        if (!MobiDoc::IsSupportedFileType(GuessFileType(path, true))) {
+            continue;
+        }
+        logf(L"%s", path);
+        for (int k = 0; k < (int)dimof(names); k++) {
+            SetMobiHuffDicCache(k > 0);
+            SetMobiParallelLoad(k == 2);
+            double timeMs = 0;
+            size_t htmlSize = 0;
+            for (int i = 0; i < nRuns; i++) {
+                auto t = TimeGet();
+                MobiDoc* mb = MobiDoc::CreateFromFile(path);
+                timeMs += TimeSinceInMs(t);
+                if (!mb) {
+                    break;
+                }
+                htmlSize = mb->GetHtmlDataSize();
+                delete mb;
+            }
+            if (0 == htmlSize) {
+                logf(L"  Error: failed to load the file");
+                break;
+            }
+            timeMs /= nRuns;
+            logf(L"  %s: %8.2f ms (%.1f MB/s)", names[k], timeMs, htmlSize / 1000.0 / timeMs);
+        }
+    }
+    SetMobiHuffDicCache(true);
+    SetMobiParallelLoad(true);
+}
+
+// runs all pages of a PDF document the way mutool draw does in low memory
+// mode (FZ_NO_CACHE drops the objects loaded for a page from the xref
+// afterwards), so that objects in object streams have to be re-loaded
+static double BenchPdfRunPages(const WCHAR* path) {
+    fz_context* ctx = fz_new_context(nullptr, nullptr, FZ_STORE_DEFAULT);
+    if (!ctx) {
+        return -1;
+    }
+    fz_stream* file = nullptr;
+    pdf_document* doc = nullptr;
+    pdf_page* page = nullptr;
+    fz_device* dev = nullptr;
+    fz_rect bbox{};
+    double timeMs = -1;
+    fz_var(file);
+    fz_var(doc);
+    fz_var(page);
+    fz_var(dev);
+
+    fz_try(ctx) {
+        auto t = TimeGet();
+        file = fz_open_file2(ctx, path, true);
+        doc = pdf_open_document_with_stream(ctx, file);
+        int nPages = pdf_count_pages(ctx, doc);
+        for (int i = 0; i < nPages; i++) {
+            page = pdf_load_page(ctx, doc, i);
+            dev = fz_new_bbox_device(ctx, &bbox);
+            fz_enable_device_hints(ctx, dev, FZ_NO_CACHE);
+            pdf_run_page(ctx, page, dev, fz_scale(1, 1), nullptr);
+            fz_close_device(ctx, dev);
+            fz_drop_device(ctx, dev);
+            dev = nullptr;
+            fz_drop_page(ctx, (fz_page*)page);
+            page = nullptr;
+        }
+        timeMs = TimeSinceInMs(t);
+    }
+    fz_always(ctx) {
+        fz_drop_device(ctx, dev);
+        fz_drop_page(ctx, (fz_page*)page);
+        pdf_drop_document(ctx, doc);
+        fz_drop_stream(ctx, file);
+    }
+    fz_catch(ctx) {
+        timeMs = -1;
+    }
+    fz_drop_context(ctx);
+    return timeMs;
+}
+
+// compares loading and running all pages of the PDF files in dir (and its
+// sub-directories) with and without caching the decompressed object streams
+void BenchPdfObjStm(const WCHAR* dir) {
+    const int nRuns = 3;
+    const WCHAR* names[] = {L"no object stream cache", L"object stream cache   "};
+
+    DirIter di(dir, true);
+    for (const WCHAR* path = di.First(); path; path = di.Next()) {
+        if (GuessFileType(path, true) != kindFilePDF) {
+            continue;
+        }
+        logf(L"%s", path);
+        for (int k = 0; k < (int)dimof(names); k++) {
+            pdf_set_obj_stm_cache(k > 0);
+            double timeMs = 0;
+            for (int i = 0; i < nRuns && timeMs >= 0; i++) {
+                double runMs = BenchPdfRunPages(path);
+                timeMs = runMs < 0 ? runMs : timeMs + runMs;
+            }
+            if (timeMs < 0) {
+                logf(L"  Error: failed to load the file");
+                break;
+            }
+            logf(L"  %s: %8.2f ms", names[k], timeMs / nRuns);
+        }
+    }
+    pdf_set_obj_stm_cache(1);
+}
+
+// returns the time it takes to read the whole file (readMs) and to
+// rebuild its xref table by scanning it (repairMs)
+static bool BenchPdfRepairRun(const WCHAR* path, double* readMs, double* repairMs) {
+    fz_context* ctx = fz_new_context(nullptr, nullptr, FZ_STORE_DEFAULT);
+    if (!ctx) {
+        return false;
+    }
+    fz_set_warning_callback(ctx, nullptr, nullptr);
+    fz_stream* file = nullptr;
+    pdf_document* doc = nullptr;
+    bool ok = false;
+    fz_var(file);
+    fz_var(doc);
+
+    fz_try(ctx) {
+        static unsigned char buf[64 * 1024];
+        file = fz_open_file_w(ctx, path);
+        auto t = TimeGet();
+        while (fz_read(ctx, file, buf, sizeof(buf)) > 0) {
+            // the data isn't needed
+        }
+        *readMs = TimeSinceInMs(t);
+        fz_drop_stream(ctx, file);
+        file = nullptr;
+
+        // repairing works the same for intact and damaged files
+        file = fz_open_file_w(ctx, path);
+        doc = pdf_open_document_with_stream(ctx, file);
+        t = TimeGet();
+        pdf_repair_xref(ctx, doc);
+        *repairMs = TimeSinceInMs(t);
+        ok = true;
+    }
+    fz_always(ctx) {
+        pdf_drop_document(ctx, doc);
+        fz_drop_stream(ctx, file);
+    }
+    fz_catch(ctx) {
+        ok = false;
+    }
+    fz_drop_context(ctx);
+    return ok;
+}
+
+// compares the time it takes to scan the PDF files in dir (and its
+// sub-directories) for objects when repairing them with the time it
+// takes to merely read them (only the first run also includes reading
+// the file from disk instead of from the file cache)
+void BenchPdfRepair(const WCHAR* dir) {
+    const int nRuns = 3;
+
+    DirIter di(dir, true);
+    for (const WCHAR* path = di.First(); path; path = di.Next()) {
+        if (GuessFileType(path, true) != kindFilePDF) {
+            continue;
+        }
+        logf(L"%s", path);
+        AutoFreeStr pathA = strconv::WstrToUtf8(path);
+        double sizeMB = (double)file::GetSize(pathA.AsView()) / (1024 * 1024);
+        for (int i = 0; i < nRuns; i++) {
+            double readMs, repairMs;
+            if (!BenchPdfRepairRun(path, &readMs, &repairMs)) {
+                logf(L"  Error: failed to load the file");
+                break;
+            }
+            logf(L"  read: %8.2f ms (%6.0f MB/s), repair: %8.2f ms (%6.0f MB/s)", readMs, sizeMB * 1000 / readMs,
+                 repairMs, sizeMB * 1000 / repairMs);
+        }
+    }
+}
+
+// simulates the store usage of several threads rendering a document:
+// most items are keyed by something hashable (like tiles and images keyed
+// by indirect objects) and some can only be found by walking the store
+// (like colorspaces keyed by direct objects)
+struct BenchStoreItem {
+    fz_storable storable;
+};
+
+// the store partitions items by their drop function, so the two drop
+// functions must remain distinct (identical bodies would be folded into
+// a single function by the linker's /OPT:ICF)
+static LONG gBenchStoreHashedDrops = 0;
+static LONG gBenchStoreUnhashedDrops = 0;
+
+static __declspec(noinline) void BenchStoreDropHashed(fz_context* ctx, fz_storable* s) {
+    InterlockedIncrement(&gBenchStoreHashedDrops);
+    fz_free(ctx, s);
+}
+
+static __declspec(noinline) void BenchStoreDropUnhashed(fz_context* ctx, fz_storable* s) {
+    InterlockedIncrement(&gBenchStoreUnhashedDrops);
+    fz_free(ctx, s);
+}
+
+static int BenchStoreMakeHashKey(fz_context*, fz_store_hash* hash, void* key) {
+    intptr_t n = (intptr_t)key;
+    if (n % 16 == 0) {
+        return 0;
+    }
+    hash->u.pi.ptr = nullptr;
+    hash->u.pi.i = (int)n;
+    return 1;
+}
+
+static void* BenchStoreKeepKey(fz_context*, void* key) {
+    return key;
+}
+
+static void BenchStoreDropKey(fz_context*, void*) {
+}
+
+static int BenchStoreCmpKey(fz_context*, void* k1, void* k2) {
+    return k1 != k2;
+}
+
+static void BenchStoreFormatKey(fz_context*, char* buf, size_t size, void* key) {
+    fz_snprintf(buf, size, "(bench %d)", (int)(intptr_t)key);
+}
+
+static const fz_store_type gBenchStoreType = {"bench",          BenchStoreMakeHashKey, BenchStoreKeepKey,
+                                               BenchStoreDropKey, BenchStoreCmpKey,      BenchStoreFormatKey,
+                                               nullptr};
+
+static const int kBenchStoreKeys = 32 * 1024;
+static const int kBenchStoreOpsPerThread = 256 * 1024;
+
+static fz_store_drop_fn* BenchStoreDropFn(intptr_t key) {
+    return key % 16 == 0 ? BenchStoreDropUnhashed : BenchStoreDropHashed;
+}
+
+static void BenchStoreFindOrStore(fz_context* ctx, intptr_t key) {
+    fz_store_drop_fn* drop = BenchStoreDropFn(key);
+    BenchStoreItem* item = (BenchStoreItem*)fz_find_item(ctx, drop, (void*)key, &gBenchStoreType);
+    if (!item) {
+        item = fz_malloc_struct(ctx, BenchStoreItem);
+        FZ_INIT_STORABLE(item, 1, drop);
+        BenchStoreItem* existing = (BenchStoreItem*)fz_store_item(ctx, (void*)key, item, 1024, &gBenchStoreType);
+        if (existing) {
+            fz_drop_storable(ctx, &item->storable);
+            item = existing;
+        }
+    }
+    fz_drop_storable(ctx, &item->storable);
+}
+
+struct BenchStoreThreadData {
+    fz_context* ctx;
+    u32 seed;
+};
+
+static DWORD WINAPI BenchStoreThread(LPVOID data) {
+    BenchStoreThreadData* td = (BenchStoreThreadData*)data;
+    u32 seed = td->seed;
+    fz_try(td->ctx) {
+        for (int i = 0; i < kBenchStoreOpsPerThread; i++) {
+            // cheap LCG, so that the threads only contend inside the store
+            seed = seed * 1664525 + 1013904223;
+            BenchStoreFindOrStore(td->ctx, 1 + (seed >> 8) % kBenchStoreKeys);
+        }
+    }
+    fz_catch(td->ctx) {
+    }
+    return 0;
+}
+
+static CRITICAL_SECTION gBenchStoreLocks[FZ_LOCK_MAX];
+
+static void BenchStoreLock(void* user, int lock) {
+    EnterCriticalSection(&gBenchStoreLocks[lock]);
+}
+
+static void BenchStoreUnlock(void* user, int lock) {
+    LeaveCriticalSection(&gBenchStoreLocks[lock]);
+}
+
+// returns the number of store operations per ms
+static double BenchStoreRun(int nThreads, bool usePartitions) {
+    fz_locks_context locks = {nullptr, BenchStoreLock, BenchStoreUnlock};
+    // the store holds ~3/4 of the keys, so that lookups also cause evictions
+    fz_context* ctx = fz_new_context(nullptr, &locks, kBenchStoreKeys * 3 / 4 * 1024);
+    if (!ctx) {
+        return -1;
+    }
+    // threads storing the same key at the same time is expected
+    fz_set_warning_callback(ctx, nullptr, nullptr);
+    fz_set_store_partitions(ctx, usePartitions);
+    fz_try(ctx) {
+        for (int key = 1; key <= kBenchStoreKeys; key++) {
+            BenchStoreFindOrStore(ctx, key);
+        }
+    }
+    fz_catch(ctx) {
+        fz_drop_context(ctx);
+        return -1;
+    }
+
+    BenchStoreThreadData td[64];
+    HANDLE threads[64];
+    CrashIf(nThreads > (int)dimof(threads));
+    for (int i = 0; i < nThreads; i++) {
+        td[i].ctx = fz_clone_context(ctx);
+        td[i].seed = (u32)i * 7919 + 1;
+    }
+    auto t = TimeGet();
+    for (int i = 0; i < nThreads; i++) {
+        threads[i] = CreateThread(nullptr, 0, BenchStoreThread, &td[i], 0, nullptr);
+    }
+    WaitForMultipleObjects(nThreads, threads, TRUE, INFINITE);
+    double timeMs = TimeSinceInMs(t);
+    for (int i = 0; i < nThreads; i++) {
+        CloseHandle(threads[i]);
+        fz_drop_context(td[i].ctx);
+    }
+    fz_drop_context(ctx);
+    return (double)nThreads * kBenchStoreOpsPerThread / timeMs;
+}
+
+// compares the throughput of concurrent store lookups (and insertions)
+// with 1 to 2 * number of cores threads, with and without looking up
+// unhashable keys only in the store partition for their type
+void BenchStoreContention() {
+    const WCHAR* names[] = {L"whole store walks", L"partition walks  "};
+
+    for (int i = 0; i < FZ_LOCK_MAX; i++) {
+        InitializeCriticalSection(&gBenchStoreLocks[i]);
+    }
+    SYSTEM_INFO si;
+    GetSystemInfo(&si);
+    int maxThreads = std::clamp((int)si.dwNumberOfProcessors * 2, 1, 64);
+    for (int nThreads = 1; nThreads <= maxThreads; nThreads *= 2) {
+        logf(L"%d thread(s)", nThreads);
+        for (int k = 0; k < (int)dimof(names); k++) {
+            double opsPerMs = BenchStoreRun(nThreads, k > 0);
+            if (opsPerMs < 0) {
+                logf(L"  Error: failed to create the context");
+                break;
+            }
+            logf(L"  %s: %8.0f ops/ms", names[k], opsPerMs);
+        }
+    }
+    logf(L"dropped items: %d hashed, %d unhashed", (int)gBenchStoreHashedDrops, (int)gBenchStoreUnhashedDrops);
+    for (int i = 0; i < FZ_LOCK_MAX; i++) {
+        DeleteCriticalSection(&gBenchStoreLocks[i]);
+    }
+}
+
 static void BenchChmLoadOnly(const WCHAR* filePath) {
     auto total = TimeGet();
     logf(L"Starting: %s", filePath);
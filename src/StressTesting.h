@@ -6,6 +6,12 @@ bool IsBenchPagesInfo(const WCHAR* s);
 void BenchFileOrDir(WStrVec& pathsToBench);
 bool IsStressTesting();
 void BenchEbookLayout(WCHAR* filePath);
+void BenchTextSearch();
+void BenchImageSizes(const WCHAR* dir);
+void BenchMobiLoad(const WCHAR* dir);
+void BenchPdfObjStm(const WCHAR* dir);
+void BenchPdfRepair(const WCHAR* dir);
+void BenchStoreContention();
 
 struct Flags;
 struct WindowInfo;
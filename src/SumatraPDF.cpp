@@ -52,6 +52,7 @@
 #include "PdfSync.h"
 #include "RenderCache.h"
 #include "ProgressUpdateUI.h"
+#include "TextIndex.h"
 #include "TextSelection.h"
 #include "TextSearch.h"
 #include "AppColors.h"
@@ -707,6 +708,8 @@ struct ControllerCallbackHandler : ControllerCallback {
     void RequestRendering(int pageNo) override;
     void CleanUp(DisplayModel* dm) override;
     void RenderThumbnail(DisplayModel* dm, Size size, const onBitmapRenderedCb&) override;
+    void PageSizesChanged(DisplayModel* dm, int startPageNo, int endPageNo) override;
+    void PagesLaidOut(DisplayModel* dm) override;
     void GotoLink(PageDestination* dest) override {
         win->linkHandler->GotoLink(dest);
     }
@@ -793,6 +796,14 @@ void ControllerCallbackHandler::CleanUp(DisplayModel* dm) {
     gRenderCache.FreeForDisplayModel(dm);
 }
 
+void ControllerCallbackHandler::PageSizesChanged(DisplayModel* dm, int startPageNo, int endPageNo) {
+    uitask::Post([=] {
+        if (FindWindowInfoByController(dm)) {
+            dm->UpdatePageSizes(startPageNo, endPageNo);
+        }
+    });
+}
+
 void ControllerCallbackHandler::FocusFrame(bool always) {
     if (always || !FindWindowInfoByHwnd(GetFocus())) {
         SetFocus(win->hwndFrame);
@@ -1152,6 +1163,9 @@ static void LoadDocIntoCurrentTab(const LoadArgs& args, Controller* ctrl, Displa
     if (win->ctrl) {
         DisplayModel* dm = win->AsFixed();
         if (dm) {
+            // the text is only cached on disk for documents we'd also remember
+            bool canSaveToDisk = HasPermission(Perm_SavePreferences | Perm_DiskAccess);
+            dm->textCache->usePersistentIndex = canSaveToDisk && gGlobalPrefs->rememberOpenedFiles;
             int dpi = gGlobalPrefs->customScreenDPI;
             if (dpi == 0) {
                 dpi = DpiGetForHwnd(win->hwndFrame);
@@ -1373,6 +1387,59 @@ void ReloadDocument(WindowInfo* win, bool autoRefresh) {
     DeleteDisplayState(ds);
 }
 
+// the page count and ToC of documents whose pages are laid out in the background
+// are only final once all pages have been (cf. EngineBase::LayoutPagesAsync)
+void ControllerCallbackHandler::PagesLaidOut(DisplayModel* dm) {
+    uitask::Post([=] {
+        WindowInfo* win = FindWindowInfoByController(dm);
+        if (!win) {
+            return;
+        }
+        TabInfo* tab = nullptr;
+        for (TabInfo* t : win->tabs) {
+            if (t->ctrl == dm) {
+                tab = t;
+                break;
+            }
+        }
+        if (!tab) {
+            return;
+        }
+        bool isCurrentTab = win->ctrl == dm;
+        if (isCurrentTab) {
+            // a search in progress uses the estimated page count
+            AbortFinding(win, false);
+        }
+        // rendering threads must be done with the pages of the
+        // estimated page count before the engine's page count changes
+        gRenderCache.CancelRendering(dm);
+        // a selection might be on pages beyond the actual page count
+        delete tab->selectionOnPage;
+        tab->selectionOnPage = nullptr;
+        int prevPageCount = dm->PageCount();
+        dm->UpdatePageCount();
+        if (!isCurrentTab) {
+            return;
+        }
+
+        win->showSelection = false;
+        if (dm->PageCount() != prevPageCount) {
+            UpdateToolbarPageText(win, dm->PageCount());
+        }
+        // the ToC only becomes available now
+        if (dm->HacToc() && !win->presentation) {
+            bool showToc = showTocByDefault(tab->filePath);
+            DisplayState* state = gFileHistory.Find(tab->filePath, nullptr);
+            if (state && gGlobalPrefs->rememberStatePerDocument && !state->useDefaultState) {
+                showToc = state->showToc;
+            }
+            ClearTocBox(win);
+            SetSidebarVisibility(win, showToc, gGlobalPrefs->showFavorites);
+        }
+        win->RedrawAll(true);
+    });
+}
+
 static void CreateSidebar(WindowInfo* win) {
     win->sidebarSplitter = new SplitterCtrl(win->hwndFrame);
     win->sidebarSplitter->type = SplitterType::Vert;
@@ -2158,6 +2225,19 @@ static void RerenderFixedPage() {
     }
 }
 
+// page sizes and outlines of large PDF documents are only cached
+// on disk if we'd also remember the documents
+void UpdatePdfLoadCacheDir() {
+    bool canSaveToDisk = HasPermission(Perm_SavePreferences | Perm_DiskAccess);
+    if (!canSaveToDisk || !gGlobalPrefs->rememberOpenedFiles) {
+        SetPdfLoadCacheDir(nullptr);
+        return;
+    }
+    // same directory as thumbnails (see FileThumbnails.cpp)
+    AutoFreeWstr dir(AppGenDataFilename(L"sumatrapdfcache"));
+    SetPdfLoadCacheDir(dir);
+}
+
 void UpdateDocumentColors() {
     // TODO: only do this if colors have actually changed?
     for (auto* win : gWindows) {
@@ -3339,7 +3419,10 @@ static void OnMenuOptions(HWND hwnd) {
     if (!gGlobalPrefs->rememberOpenedFiles) {
         gFileHistory.Clear(true);
         CleanUpThumbnailCache(gFileHistory);
+        CleanUpTextIndexCache(true);
+        CleanUpPdfLoadCache(true);
     }
+    UpdatePdfLoadCacheDir();
     UpdateDocumentColors();
 
     // note: ideally we would also update state for useTabs changes but that's complicated since
@@ -35,6 +35,7 @@
 #include "Annotation.h"
 #include "EngineBase.h"
 #include "EngineCreate.h"
+#include "EnginePdf.h"
 #include "DisplayMode.h"
 #include "SettingsStructs.h"
 #include "Controller.h"
@@ -44,6 +45,7 @@
 #include "PdfSync.h"
 #include "RenderCache.h"
 #include "ProgressUpdateUI.h"
+#include "TextIndex.h"
 #include "TextSelection.h"
 #include "TextSearch.h"
 #include "Notifications.h"
@@ -901,6 +903,7 @@ int APIENTRY WinMain(HINSTANCE hInstance, [[maybe_unused]] HINSTANCE hPrevInstan
     prefs::Load();
     UpdateGlobalPrefs(i);
     SetCurrentLang(i.lang ? i.lang : gGlobalPrefs->uiLanguage);
+    UpdatePdfLoadCacheDir();
 
     // This allows ad-hoc comparison of gdi, gdi+ and gdi+ quick when used
     // in layout
@@ -911,6 +914,56 @@ int APIENTRY WinMain(HINSTANCE hInstance, [[maybe_unused]] HINSTANCE hPrevInstan
     goto Exit;
 #endif
 
+    // compares TextSearch's substring search with StrStrI
+#if 0
+    RedirectIOToConsole();
+    BenchTextSearch();
+    system("pause");
+    goto Exit;
+#endif
+
+    // compares determining image sizes from their headers with decoding them
+#if 0
+    RedirectIOToConsole();
+    BenchImageSizes(L"C:\\kjk\\downloads\\images");
+    system("pause");
+    goto Exit;
+#endif
+
+    // compares decompressing the text of Mobi files sequentially and in parallel
+    // (and HuffDic compressed ones with and without caching expanded symbols)
+#if 0
+    RedirectIOToConsole();
+    BenchMobiLoad(L"C:\\kjk\\downloads\\mobi");
+    system("pause");
+    goto Exit;
+#endif
+
+    // compares running all pages of PDF files with and without
+    // caching the decompressed content of object streams
+#if 0
+    RedirectIOToConsole();
+    BenchPdfObjStm(L"C:\\kjk\\downloads\\pdf");
+    system("pause");
+    goto Exit;
+#endif
+
+    // compares repairing (i.e. scanning) PDF files with merely reading them
+#if 0
+    RedirectIOToConsole();
+    BenchPdfRepair(L"C:\\kjk\\downloads\\pdf");
+    system("pause");
+    goto Exit;
+#endif
+
+    // compares the throughput of concurrent lookups in the mupdf store
+#if 0
+    RedirectIOToConsole();
+    BenchStoreContention();
+    system("pause");
+    goto Exit;
+#endif
+
     if (i.showConsole) {
         RedirectIOToConsole();
         // TODO(port)
@@ -1129,6 +1182,8 @@ int APIENTRY WinMain(HINSTANCE hInstance, [[maybe_unused]] HINSTANCE hPrevInstan
     retCode = RunMessageLoop();
     SafeCloseHandle(&hMutex);
     CleanUpThumbnailCache(gFileHistory);
+    CleanUpTextIndexCache();
+    CleanUpPdfLoadCache();
 
 Exit:
     prefs::UnregisterForFileChanges();
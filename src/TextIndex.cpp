@@ -0,0 +1,280 @@
+/* Copyright 2020 the SumatraPDF project authors (see AUTHORS file).
+   License: GPLv3 */
+
+#include "utils/BaseUtil.h"
+#include "utils/ScopedWin.h"
+#include "utils/CryptoUtil.h"
+#include "utils/FileUtil.h"
+#include "utils/ThreadUtil.h"
+
+#include "wingui/TreeModel.h"
+
+#include "Annotation.h"
+#include "EngineBase.h"
+
+#include "AppTools.h"
+#include "TextIndex.h"
+
+#include "utils/Log.h"
+
+// same directory as thumbnails (see FileThumbnails.cpp)
+#define TEXT_INDEX_DIR_NAME L"sumatrapdfcache"
+#define TEXT_INDEX_EXT L".txtidx"
+#define TEXT_INDEX_MAGIC 0x49585453 // 'STXI'
+#define TEXT_INDEX_VERSION 1
+// how much of the beginning and end of a file is part of its fingerprint
+#define FINGERPRINT_SAMPLE_SIZE (64 * 1024)
+// indexes are removed (least recently used first) above this total size
+#define MAX_TEXT_INDEX_CACHE_SIZE (256 * 1024 * 1024)
+// how long CleanUpTextIndexCache waits for saves still in progress
+#define MAX_SAVE_WAIT_MS (10 * 1000)
+
+// number of SaveTextIndexAsync calls which haven't completed yet
+static LONG gPendingSaves = 0;
+
+/* The file consists of a TextIndexHeader, a TextIndexPage for every page
+   and for every indexed page its text (len + 1 WCHARs, zero-terminated)
+   followed by its coords (len Rects, aligned to 4 bytes). */
+struct TextIndexHeader {
+    u32 magic;
+    u32 version;
+    u8 fingerprint[16];
+    u32 nPages;
+    u32 reserved;
+};
+
+struct TextIndexPage {
+    // 0 if the page isn't part of the index
+    u64 offset;
+    u32 len;
+    u32 reserved;
+};
+
+struct TextIndex {
+    MappedCacheFile file;
+    int nPages = 0;
+    const TextIndexPage* pages = nullptr;
+};
+
+static_assert(sizeof(TextIndexHeader) == 32, "unexpected TextIndexHeader size");
+static_assert(sizeof(TextIndexPage) == 16, "unexpected TextIndexPage size");
+static_assert(sizeof(Rect) == 4 * sizeof(int), "unexpected Rect size");
+
+static bool ReadAt(HANDLE h, i64 offset, u8* buf, DWORD size) {
+    LARGE_INTEGER off;
+    off.QuadPart = offset;
+    if (!SetFilePointerEx(h, off, nullptr, FILE_BEGIN)) {
+        return false;
+    }
+    DWORD nRead = 0;
+    return ReadFile(h, buf, size, &nRead, nullptr) && nRead == size;
+}
+
+// a fingerprint of the file's size, modification time and the beginning
+// and end of its content. Hashing the entire file would take longer
+// than extracting the text for large files on slow drives
+static bool GetFileFingerprint(const WCHAR* filePath, u8 digest[16]) {
+    if (!filePath) {
+        return false;
+    }
+    AutoCloseHandle h(file::OpenReadOnly(filePath));
+    if (!h.IsValid()) {
+        return false;
+    }
+    LARGE_INTEGER size;
+    FILETIME mtime;
+    if (!GetFileSizeEx(h, &size) || !GetFileTime(h, nullptr, nullptr, &mtime)) {
+        return false;
+    }
+
+    str::Str data;
+    data.Append((const u8*)&size, sizeof(size));
+    data.Append((const u8*)&mtime, sizeof(mtime));
+    i64 sampleSize = std::min(size.QuadPart, (i64)FINGERPRINT_SAMPLE_SIZE);
+    u8* buf = AllocArray<u8>((size_t)sampleSize + 1);
+    bool ok = ReadAt(h, 0, buf, (DWORD)sampleSize);
+    if (ok) {
+        data.Append(buf, (size_t)sampleSize);
+        ok = ReadAt(h, size.QuadPart - sampleSize, buf, (DWORD)sampleSize);
+    }
+    if (ok) {
+        data.Append(buf, (size_t)sampleSize);
+        CalcMD5Digest((const u8*)data.Get(), data.size(), digest);
+    }
+    free(buf);
+    return ok;
+}
+
+static WCHAR* GetTextIndexPath(const u8 fingerprint[16]) {
+    AutoFreeWstr dir(AppGenDataFilename(TEXT_INDEX_DIR_NAME));
+    if (!dir) {
+        return nullptr;
+    }
+    AutoFree hex(str::MemToHex(fingerprint, 16));
+    AutoFreeWstr fname(strconv::FromAnsi(hex.Get()));
+    return str::Format(L"%s\\%s%s", dir.Get(), fname.Get(), TEXT_INDEX_EXT);
+}
+
+static size_t GetCoordsOffset(size_t len) {
+    size_t textSize = (len + 1) * sizeof(WCHAR);
+    return (textSize + 3) & ~(size_t)3;
+}
+
+static size_t GetPageDataSize(size_t len) {
+    return GetCoordsOffset(len) + len * sizeof(Rect);
+}
+
+TextIndex* OpenTextIndex(const WCHAR* filePath, int nPages) {
+    u8 fingerprint[16];
+    if (nPages <= 0 || !GetFileFingerprint(filePath, fingerprint)) {
+        return nullptr;
+    }
+    AutoFreeWstr path(GetTextIndexPath(fingerprint));
+    if (!path || !file::Exists(path)) {
+        return nullptr;
+    }
+
+    auto index = new TextIndex();
+    u64 minSize = sizeof(TextIndexHeader) + (u64)nPages * sizeof(TextIndexPage);
+    if (!index->file.Open(path) || index->file.size < minSize) {
+        CloseTextIndex(index);
+        return nullptr;
+    }
+
+    const TextIndexHeader* hdr = (const TextIndexHeader*)index->file.data;
+    bool isValid = hdr->magic == TEXT_INDEX_MAGIC && hdr->version == TEXT_INDEX_VERSION &&
+                   hdr->nPages == (u32)nPages && memeq(hdr->fingerprint, fingerprint, sizeof(fingerprint));
+    if (!isValid) {
+        logf(L"OpenTextIndex: '%s' is out of date\n", path.Get());
+        CloseTextIndex(index);
+        file::Delete(path);
+        return nullptr;
+    }
+    index->nPages = nPages;
+    index->pages = (const TextIndexPage*)(index->file.data + sizeof(TextIndexHeader));
+    index->file.MarkUsed();
+    return index;
+}
+
+void CloseTextIndex(TextIndex* index) {
+    delete index;
+}
+
+static const TextIndexPage* GetIndexPage(TextIndex* index, int pageNo) {
+    if (!index || pageNo < 1 || pageNo > index->nPages) {
+        return nullptr;
+    }
+    const TextIndexPage* page = &index->pages[pageNo - 1];
+    if (page->offset == 0) {
+        return nullptr;
+    }
+    // don't trust the content of the file
+    u64 dataSize = GetPageDataSize(page->len);
+    u64 size = index->file.size;
+    if (page->offset % 4 != 0 || page->offset > size || dataSize > size - page->offset) {
+        return nullptr;
+    }
+    return page;
+}
+
+bool TextIndexHasPage(TextIndex* index, int pageNo) {
+    return GetIndexPage(index, pageNo) != nullptr;
+}
+
+bool TextIndexGetPage(TextIndex* index, int pageNo, PageText* pageTextOut) {
+    const TextIndexPage* page = GetIndexPage(index, pageNo);
+    if (!page) {
+        return false;
+    }
+    const u8* pageData = index->file.data + page->offset;
+    const WCHAR* text = (const WCHAR*)pageData;
+    if (text[page->len] != 0) {
+        return false;
+    }
+    pageTextOut->text = (WCHAR*)text;
+    pageTextOut->coords = page->len > 0 ? (Rect*)(pageData + GetCoordsOffset(page->len)) : nullptr;
+    pageTextOut->len = (int)page->len;
+    return true;
+}
+
+bool SaveTextIndex(const WCHAR* filePath, PageText* pagesText, int nPages, TextIndex* index) {
+    TextIndexHeader hdr{};
+    if (nPages <= 0 || !GetFileFingerprint(filePath, hdr.fingerprint)) {
+        CloseTextIndex(index);
+        return false;
+    }
+    AutoFreeWstr path(GetTextIndexPath(hdr.fingerprint));
+    AutoFreeWstr dir(path ? path::GetDir(path) : nullptr);
+    if (!dir || !dir::Create(dir)) {
+        CloseTextIndex(index);
+        return false;
+    }
+    hdr.magic = TEXT_INDEX_MAGIC;
+    hdr.version = TEXT_INDEX_VERSION;
+    hdr.nPages = (u32)nPages;
+
+    PageText* pages = AllocArray<PageText>(nPages);
+    TextIndexPage* indexPages = AllocArray<TextIndexPage>(nPages);
+    u64 offset = sizeof(TextIndexHeader) + (u64)nPages * sizeof(TextIndexPage);
+    for (int i = 0; i < nPages; i++) {
+        pages[i] = pagesText[i];
+        if (!pages[i].text && !TextIndexGetPage(index, i + 1, &pages[i])) {
+            continue;
+        }
+        if (pages[i].len < 0) {
+            continue;
+        }
+        indexPages[i].offset = offset;
+        indexPages[i].len = (u32)pages[i].len;
+        offset += GetPageDataSize(pages[i].len);
+    }
+
+    CacheFileWriter w(path);
+    bool ok = w.Write(&hdr, sizeof(hdr));
+    ok = ok && w.Write(indexPages, nPages * sizeof(TextIndexPage));
+    for (int i = 0; ok && i < nPages; i++) {
+        if (indexPages[i].offset == 0) {
+            continue;
+        }
+        size_t len = (size_t)pages[i].len;
+        size_t textSize = (len + 1) * sizeof(WCHAR);
+        ok = w.Write(pages[i].text, textSize);
+        u32 padding = 0;
+        ok = ok && w.Write(&padding, GetCoordsOffset(len) - textSize);
+        if (len > 0) {
+            ok = ok && pages[i].coords && w.Write(pages[i].coords, len * sizeof(Rect));
+        }
+    }
+    free(indexPages);
+    free(pages);
+    // a mapped index can't be replaced
+    CloseTextIndex(index);
+    ok = ok && w.Commit();
+    if (!ok) {
+        logf(L"SaveTextIndex: failed to save '%s'\n", path.Get());
+    }
+    return ok;
+}
+
+void SaveTextIndexAsync(const WCHAR* filePath, PageText* pagesText, int nPages, TextIndex* index,
+                        const std::function<void()>& onSaved) {
+    // counted before the thread starts so that CleanUpTextIndexCache can't miss it
+    InterlockedIncrement(&gPendingSaves);
+    WCHAR* path = str::Dup(filePath);
+    RunAsync([path, pagesText, nPages, index, onSaved] { // NOLINT
+        SaveTextIndex(path, pagesText, nPages, index);
+        free(path);
+        onSaved();
+        InterlockedDecrement(&gPendingSaves);
+    });
+}
+
+void CleanUpTextIndexCache(bool deleteAll) {
+    // called at exit, right after the last documents have been closed
+    // (an interrupted save leaves a .tmp file, which is removed below)
+    for (int waited = 0; InterlockedAdd(&gPendingSaves, 0) > 0 && waited < MAX_SAVE_WAIT_MS; waited += 50) {
+        Sleep(50);
+    }
+    AutoFreeWstr dir(AppGenDataFilename(TEXT_INDEX_DIR_NAME));
+    CleanUpCacheFiles(dir, TEXT_INDEX_EXT, MAX_TEXT_INDEX_CACHE_SIZE, deleteAll);
+}
@@ -0,0 +1,30 @@
+/* Copyright 2020 the SumatraPDF project authors (see AUTHORS file).
+   License: GPLv3 */
+
+// An on-disk cache of the text (and glyph coordinates) extracted from a
+// document, so that searching a document doesn't require extracting the
+// text of all pages again after it's been re-opened.
+// Indexes are identified by a fingerprint of the file's content and are
+// memory-mapped when opened.
+struct TextIndex;
+
+// returns nullptr if there's no index for filePath (or it's out of date)
+TextIndex* OpenTextIndex(const WCHAR* filePath, int nPages);
+void CloseTextIndex(TextIndex*);
+bool TextIndexHasPage(TextIndex*, int pageNo);
+// text and coords of the returned PageText point into the index and
+// remain valid until CloseTextIndex()
+bool TextIndexGetPage(TextIndex*, int pageNo, PageText* pageTextOut);
+
+// the text of pages without text (text == nullptr) is taken from index
+// (if it's part of it). index is closed in any case
+bool SaveTextIndex(const WCHAR* filePath, PageText* pagesText, int nPages, TextIndex* index);
+// does SaveTextIndex on a background thread and then calls onSaved (e.g. to
+// free pagesText). CleanUpTextIndexCache waits for such saves to complete
+void SaveTextIndexAsync(const WCHAR* filePath, PageText* pagesText, int nPages, TextIndex* index,
+                        const std::function<void()>& onSaved);
+
+// removes the least recently used indexes if the indexes take up too much
+// space on disk (or all of them if deleteAll is set). Also removes what's
+// left of interrupted saves
+void CleanUpTextIndexCache(bool deleteAll = false);
@@ -3,6 +3,7 @@
 
 #include "utils/BaseUtil.h"
 #include "utils/ScopedWin.h"
+#include "utils/FindSubstring.h"
 
 #include "wingui/TreeModel.h"
 
@@ -32,6 +33,14 @@ TextSearch::~TextSearch() {
     Clear();
 }
 
+// call after engine->PageCount() has changed (see DisplayModel::UpdatePageCount)
+void TextSearch::UpdatePageCount() {
+    Clear();
+    nPages = engine->PageCount();
+    pagesToSkip.SetSize(nPages);
+    markAllPagesNonSkip(pagesToSkip);
+}
+
 void TextSearch::Reset() {
     pageText = nullptr;
     TextSelection::Reset();
@@ -124,9 +133,7 @@ void TextSearch::SetLastResult(TextSelection* sel) {
 }
 
 static WCHAR CharToLower2(WCHAR c) {
-    WCHAR buf[1] = {c};
-    CharLowerBuffW(buf, 1);
-    return buf[0];
+    return GetLowerCaseTable()[c];
 }
 
 static inline WCHAR CharToLower(WCHAR c) {
@@ -143,6 +150,7 @@ static inline WCHAR CharToLower(WCHAR c) {
     return CharToLower2(c);
 }
 
+
 // try to match "findText" from "start" with whitespace tolerance
 // (ignore all whitespace except after alphanumeric characters)
 TextSearch::PageAndOffset TextSearch::MatchEnd(const WCHAR* start) const {
@@ -253,14 +261,9 @@ bool TextSearch::FindTextInPage(int pageNo, TextSearch::PageAndOffset* finalGlyp
         if (!anchor) {
             found = GetNextIndex(pageText, findIndex, forward);
         } else if (forward) {
-            const WCHAR* s = pageText + findIndex;
-            if (caseSensitive) {
-                found = StrStr(s, anchor);
-            } else {
-                found = StrStrI(s, anchor);
-            }
+            found = FindSubstring(pageText + findIndex, anchor, caseSensitive);
         } else {
-            found = StrRStrI(pageText, pageText + findIndex, anchor);
+            found = FindSubstringReverse(pageText, pageText + findIndex, anchor, caseSensitive);
         }
         if (!found) {
             return false;
@@ -291,6 +294,9 @@ bool TextSearch::FindStartingAtPage(int pageNo, ProgressUpdateUI* tracker) {
         return false;
     }
 
+    // have the text of the following pages extracted while we search
+    textCache->StartExtraction(pageNo, forward);
+
     int next = forward ? 1 : -1;
     while (1 <= pageNo && pageNo <= nPages && (!tracker || !tracker->WasCanceled())) {
         if (tracker) {
@@ -370,3 +376,72 @@ TextSel* TextSearch::FindNext(ProgressUpdateUI* tracker) {
     }
     return nullptr;
 }
+
+int TextSearch::FindAll(const WCHAR* text, const TextSearchHitCb& onHit, ProgressUpdateUI* tracker) {
+    SetText(text);
+    if (str::IsEmpty(findText)) {
+        return 0;
+    }
+
+    bool wasForward = forward;
+    forward = true;
+    textCache->StartExtraction(1, true);
+
+    int nHits = 0;
+    // offset at which to start searching the next page
+    // (after a match which continued on that page)
+    int nextPageStart = 0;
+    bool stop = false;
+    for (int pageNo = 1; pageNo <= nPages && !stop; pageNo++) {
+        if (tracker) {
+            if (tracker->WasCanceled()) {
+                break;
+            }
+            tracker->UpdateProgress(pageNo, nPages);
+        }
+
+        Reset();
+        int startAt = nextPageStart;
+        nextPageStart = 0;
+        pageText = textCache->GetTextForPage(pageNo);
+        if (!pageText) {
+            continue;
+        }
+        findIndex = startAt;
+
+        bool foundAny = false;
+        PageAndOffset fg;
+        while (FindTextInPage(pageNo, &fg)) {
+            foundAny = true;
+            nHits++;
+            TextSearchHit hit;
+            GetGlyphRange(&hit.startPage, &hit.startGlyph, &hit.endPage, &hit.endGlyph);
+            hit.sel = &result;
+            if (!onHit(&hit)) {
+                stop = true;
+                break;
+            }
+            if (fg.page != pageNo) {
+                // the match continued on the following page(s)
+                nextPageStart = fg.offset;
+                pageNo = fg.page - 1;
+                break;
+            }
+        }
+        // same as FindStartingAtPage, so that FindFirst/FindNext
+        // for the same text don't have to search this page again
+        if (!foundAny && startAt == 0) {
+            pagesToSkip[pageNo - 1] = true;
+        }
+    }
+
+    // don't keep extracting text once the search is done (or has been canceled)
+    textCache->StopExtraction();
+
+    // have the next FindFirst start from scratch
+    Reset();
+    findIndex = 0;
+    searchHitStartAt = findPage = nPages + 1;
+    forward = wasForward;
+    return nHits;
+}
@@ -3,6 +3,18 @@
 
 enum class TextSearchDirection : bool { Backward = false, Forward = true };
 
+// a single match as reported by TextSearch::FindAll
+struct TextSearchHit {
+    int startPage = 0;
+    int startGlyph = 0;
+    int endPage = 0;
+    int endGlyph = 0;
+    // the rectangles covering the match (only valid during the callback)
+    TextSel* sel = nullptr;
+};
+
+typedef std::function<bool(TextSearchHit*)> TextSearchHitCb;
+
 class TextSearch : public TextSelection {
   public:
     TextSearch(EngineBase* engine, DocumentTextCache* textCache);
@@ -13,6 +25,10 @@ class TextSearch : public TextSelection {
     void SetLastResult(TextSelection* sel);
     TextSel* FindFirst(int page, const WCHAR* text, ProgressUpdateUI* tracker = nullptr);
     TextSel* FindNext(ProgressUpdateUI* tracker = nullptr);
+    // reports all matches in document order to onHit as they're found
+    // (stops early if onHit returns false) and returns the number of matches.
+    // a single pass over all pages instead of one FindNext() per match
+    int FindAll(const WCHAR* text, const TextSearchHitCb& onHit, ProgressUpdateUI* tracker = nullptr);
 
     // note: the result might not be a valid page number!
     int GetCurrentPageNo() const {
@@ -48,6 +64,8 @@ class TextSearch : public TextSelection {
     bool FindStartingAtPage(int pageNo, ProgressUpdateUI* tracker);
     PageAndOffset MatchEnd(const WCHAR* start) const;
 
+    void UpdatePageCount();
+
     void Clear() {
         str::ReplacePtr(&findText, nullptr);
         str::ReplacePtr(&anchor, nullptr);
@@ -8,6 +8,7 @@
 
 #include "Annotation.h"
 #include "EngineBase.h"
+#include "TextIndex.h"
 #include "TextSelection.h"
 
 uint distSq(int x, int y) {
@@ -24,26 +25,228 @@ DocumentTextCache::DocumentTextCache(EngineBase* engine) : engine(engine) {
     debugSize = nPages * (sizeof(Rect*) + sizeof(WCHAR*) + sizeof(int));
 
     InitializeCriticalSection(&access);
+    InitializeCriticalSection(&stopAccess);
+    InitializeConditionVariable(&pageExtracted);
 }
 
-DocumentTextCache::~DocumentTextCache() {
-    EnterCriticalSection(&access);
+// don't bother for documents whose text is quickly extracted again
+#define MIN_PAGES_FOR_TEXT_INDEX 16
+#define MIN_PAGES_FOR_BACKGROUND_EXTRACTION 16
 
-    int nPages = engine->PageCount();
+static void FreePagesText(PageText* pagesText, int nPages) {
     for (int i = 0; i < nPages; i++) {
         PageText* pageText = &pagesText[i];
         free(pageText->coords);
         free(pageText->text);
     }
     free(pagesText);
+}
+
+DocumentTextCache::~DocumentTextCache() {
+    StopExtraction();
+    EnterCriticalSection(&access);
+
+    // note: engine->PageCount() might have changed since (see EngineBase::UpdatePageCount)
+    if (usePersistentIndex && wasSearched && nExtractedPages > 0) {
+        // writing the index can take a while for large documents, so
+        // it's done in the background (taking ownership of the text)
+        PageText* texts = pagesText;
+        int n = nPages;
+        SaveTextIndexAsync(engine->FileName(), texts, n, index, [texts, n] { FreePagesText(texts, n); });
+    } else {
+        CloseTextIndex(index);
+        FreePagesText(pagesText, nPages);
+    }
+    index = nullptr;
+    pagesText = nullptr;
+    free(isExtracting);
     LeaveCriticalSection(&access);
     DeleteCriticalSection(&access);
+    DeleteCriticalSection(&stopAccess);
+}
+
+// extracts the text of all pages in the background (starting at pageNo and
+// continuing in the given direction) so that TextSearch doesn't have to wait
+// for the text of each page to be extracted sequentially. Calling this again
+// only changes the page at which extraction continues
+void DocumentTextCache::StartExtraction(int pageNo, bool forward) {
+    ScopedCritSec scope(&access);
+    // only TextSearch asks for all pages, so only then is it worth
+    // persisting the text (see ~DocumentTextCache)
+    wasSearched = true;
+    extractFrom = std::clamp(pageNo, 1, nPages);
+    extractForward = forward;
+    if (nExtractionThreads > 0 || stopExtraction || nPages < MIN_PAGES_FOR_BACKGROUND_EXTRACTION) {
+        return;
+    }
+    // only engines which can be cloned (and render in parallel) profit from this
+    if (engine->kind != kindEnginePdf && engine->kind != kindEngineXps) {
+        return;
+    }
+
+    SYSTEM_INFO si{};
+    GetSystemInfo(&si);
+    // leave a core for the UI and rendering
+    int nThreads = std::clamp((int)si.dwNumberOfProcessors - 1, 1, MAX_TEXT_EXTRACTION_THREADS);
+    isExtracting = AllocArray<bool>(nPages);
+    for (int i = 0; i < nThreads; i++) {
+        HANDLE h = CreateThread(nullptr, 0, ExtractionThread, this, 0, nullptr);
+        if (h) {
+            extractionThreads[nExtractionThreads++] = h;
+        }
+    }
+}
+
+// blocks until all extraction threads have finished the page they're working on
+void DocumentTextCache::StopExtraction() {
+    // StopExtraction can be called from both the UI and the find thread
+    ScopedCritSec stopScope(&stopAccess);
+    EnterCriticalSection(&access);
+    stopExtraction = true;
+    LeaveCriticalSection(&access);
+
+    if (nExtractionThreads > 0) {
+        WaitForMultipleObjects(nExtractionThreads, extractionThreads, TRUE, INFINITE);
+    }
+    for (int i = 0; i < nExtractionThreads; i++) {
+        CloseHandle(extractionThreads[i]);
+        extractionThreads[i] = nullptr;
+    }
+    nExtractionThreads = 0;
+
+    // allow extraction to be started again
+    ScopedCritSec scope(&access);
+    stopExtraction = false;
+    free(isExtracting);
+    isExtracting = nullptr;
+}
+
+// adjusts the cache after engine->PageCount() has changed
+// (see EngineBase::UpdatePageCount). Extraction must have been stopped
+void DocumentTextCache::UpdatePageCount() {
+    ScopedCritSec scope(&access);
+    CrashIf(nExtractionThreads > 0);
+    int newPageCount = engine->PageCount();
+    for (int i = newPageCount; i < nPages; i++) {
+        FreePageText(&pagesText[i]);
+    }
+    PageText* newPagesText = AllocArray<PageText>(newPageCount);
+    memcpy(newPagesText, pagesText, std::min(nPages, newPageCount) * sizeof(PageText));
+    free(pagesText);
+    pagesText = newPagesText;
+    nPages = newPageCount;
+
+    // an index is only valid for the page count it's been opened for
+    CloseTextIndex(index);
+    index = nullptr;
+    triedOpeningIndex = false;
+}
+
+// returns the next page without text (0 if there's none) and marks it
+// as being extracted. Must be called within access
+int DocumentTextCache::GetNextPageToExtract() {
+    if (stopExtraction) {
+        return 0;
+    }
+    OpenIndex();
+    for (int i = 0; i < nPages; i++) {
+        int idx = extractFrom - 1 + (extractForward ? i : -i);
+        idx = (idx + nPages) % nPages;
+        if (pagesText[idx].text || isExtracting[idx] || TextIndexHasPage(index, idx + 1)) {
+            continue;
+        }
+        isExtracting[idx] = true;
+        // the pages before have all been handled already
+        extractFrom = idx + 1;
+        return idx + 1;
+    }
+    return 0;
+}
+
+DWORD WINAPI DocumentTextCache::ExtractionThread(LPVOID data) {
+    DocumentTextCache* tc = (DocumentTextCache*)data;
+    EngineBase* clone = nullptr;
+    int nClonePages = 0;
+
+    for (;;) {
+        // a clone keeps the pages it has loaded (and the resources they use)
+        // in memory, so it's replaced after a while to limit memory usage
+        if (nClonePages >= MAX_PAGES_PER_EXTRACTION_CLONE) {
+            delete clone;
+            clone = nullptr;
+        }
+        if (!clone) {
+            clone = tc->engine->Clone();
+            nClonePages = 0;
+        }
+        if (!clone) {
+            break;
+        }
+
+        int pageNo;
+        {
+            ScopedCritSec scope(&tc->access);
+            pageNo = tc->GetNextPageToExtract();
+        }
+        if (pageNo == 0) {
+            break;
+        }
+
+        PageText pageText = clone->ExtractPageText(pageNo);
+        nClonePages++;
+        if (!pageText.text) {
+            pageText.text = str::Dup(L"");
+            pageText.len = 0;
+        }
+
+        ScopedCritSec scope(&tc->access);
+        tc->isExtracting[pageNo - 1] = false;
+        PageText* cached = &tc->pagesText[pageNo - 1];
+        if (cached->text) {
+            FreePageText(&pageText);
+        } else {
+            *cached = pageText;
+            tc->debugSize += (pageText.len + 1) * (sizeof(WCHAR) + sizeof(Rect));
+            tc->nExtractedPages++;
+        }
+        WakeAllConditionVariable(&tc->pageExtracted);
+    }
+
+    delete clone;
+    return 0;
+}
+
+// must be called within access
+void DocumentTextCache::OpenIndex() {
+    if (triedOpeningIndex) {
+        return;
+    }
+    triedOpeningIndex = true;
+    // password protected documents shouldn't end up in plain text on disk
+    if (engine->IsPasswordProtected() || nPages < MIN_PAGES_FOR_TEXT_INDEX) {
+        usePersistentIndex = false;
+    }
+    // the index is only keyed by the file's fingerprint and page count, so
+    // the text of reflowed documents (EPUB, FB2, MOBI, ...) would go stale
+    // after a change of layout (e.g. of window size or font size)
+    bool isFixedLayout = engine->kind == kindEnginePdf || engine->kind == kindEngineXps || engine->kind == kindEngineDjVu;
+    if (!isFixedLayout) {
+        usePersistentIndex = false;
+    }
+    if (usePersistentIndex) {
+        index = OpenTextIndex(engine->FileName(), nPages);
+    }
 }
 
 bool DocumentTextCache::HasTextForPage(int pageNo) {
     CrashIf(pageNo < 1 || pageNo > nPages);
+    ScopedCritSec scope(&access);
     PageText* pageText = &pagesText[pageNo - 1];
-    return pageText->text != nullptr;
+    if (pageText->text != nullptr) {
+        return true;
+    }
+    OpenIndex();
+    return TextIndexHasPage(index, pageNo);
 }
 
 const WCHAR* DocumentTextCache::GetTextForPage(int pageNo, int* lenOut, Rect** coordsOut) {
@@ -52,13 +255,24 @@ const WCHAR* DocumentTextCache::GetTextForPage(int pageNo, int* lenOut, Rect** c
     ScopedCritSec scope(&access);
     PageText* pageText = &pagesText[pageNo - 1];
 
-    if (!pageText->text) {
+    // rather wait than extract the same page twice
+    while (!pageText->text && isExtracting && isExtracting[pageNo - 1]) {
+        SleepConditionVariableCS(&pageExtracted, &access, INFINITE);
+    }
+
+    OpenIndex();
+    PageText indexed;
+    if (!pageText->text && TextIndexGetPage(index, pageNo, &indexed)) {
+        // the index remains mapped as long as we exist
+        pageText = &indexed;
+    } else if (!pageText->text) {
         *pageText = engine->ExtractPageText(pageNo);
         if (!pageText->text) {
             pageText->text = str::Dup(L"");
             pageText->len = 0;
         }
         debugSize += (pageText->len + 1) * (sizeof(WCHAR) + sizeof(Rect));
+        nExtractedPages++;
     }
 
     if (lenOut) {
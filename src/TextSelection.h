@@ -1,17 +1,54 @@
 /* Copyright 2020 the SumatraPDF project authors (see AUTHORS file).
    License: GPLv3 */
 
+struct TextIndex;
+
+// maximum number of threads extracting text in the background
+// (each with its own clone of the engine)
+#define MAX_TEXT_EXTRACTION_THREADS 2
+// number of pages after which an extraction thread replaces its clone
+#define MAX_PAGES_PER_EXTRACTION_CLONE 64
+
 struct DocumentTextCache {
     EngineBase* engine{nullptr};
     int nPages{0};
     PageText* pagesText{nullptr};
     int debugSize{0};
 
+    // if set, the text is also cached on disk (see TextIndex.h)
+    bool usePersistentIndex{false};
+    TextIndex* index{nullptr};
+    bool triedOpeningIndex{false};
+    // number of pages extracted which weren't in index
+    int nExtractedPages{0};
+    // set once TextSearch has asked for the text of all pages
+    bool wasSearched{false};
+
+    // the text of all pages can be extracted in the background with
+    // clones of engine, starting at extractFrom (see StartExtraction)
+    HANDLE extractionThreads[MAX_TEXT_EXTRACTION_THREADS]{};
+    int nExtractionThreads{0};
+    int extractFrom{1};
+    bool extractForward{true};
+    bool stopExtraction{false};
+    // pages currently being extracted in the background
+    bool* isExtracting{nullptr};
+    CONDITION_VARIABLE pageExtracted;
+
     CRITICAL_SECTION access;
+    // serializes StopExtraction
+    CRITICAL_SECTION stopAccess;
 
     explicit DocumentTextCache(EngineBase* engine);
     ~DocumentTextCache();
 
+    void StartExtraction(int pageNo, bool forward);
+    void StopExtraction();
+    void UpdatePageCount();
+    int GetNextPageToExtract();
+    static DWORD WINAPI ExtractionThread(LPVOID data);
+
+    void OpenIndex();
     bool HasTextForPage(int pageNo);
     const WCHAR* GetTextForPage(int pageNo, int* lenOut = nullptr, Rect** coordsOut = nullptr);
 };
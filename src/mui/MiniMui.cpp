@@ -4,6 +4,7 @@
 // as little of mui as necessary to make ../EngineDump.cpp compile
 
 #include "utils/BaseUtil.h"
+#include "utils/ScopedWin.h"
 #include "MiniMui.h"
 #include "utils/WinUtil.h"
 
@@ -70,13 +71,17 @@ class CachedFontItem : public CachedFont {
         free(name);
         ::delete font;
         DeleteObject(hFont);
+        free(advances);
         delete _next;
     }
 };
 
 static CachedFontItem* gFontCache = nullptr;
+// protects gFontCache and gGraphicsHack (text can be measured on several threads)
+static CRITICAL_SECTION gMiniMuiCs;
 
 CachedFont* GetCachedFont(const WCHAR* name, float size, FontStyle style) {
+    ScopedCritSec scope(&gMiniMuiCs);
     CachedFontItem** item = &gFontCache;
     for (; *item; item = &(*item)->_next) {
         if ((*item)->SameAs(name, size, style)) {
@@ -114,30 +119,59 @@ class GlobalGraphicsHack {
 
   public:
     Graphics gfx;
+    // Graphics objects mustn't be used from several threads at once
+    DWORD threadId = 0;
+    int refCount = 0;
+    GlobalGraphicsHack* next = nullptr;
 
     GlobalGraphicsHack() : bmp(1, 1, PixelFormat32bppARGB), gfx(&bmp) {
         InitGraphicsMode(&gfx);
     }
 };
 
+// one per thread measuring text
 static GlobalGraphicsHack* gGraphicsHack = nullptr;
 
 Graphics* AllocGraphicsForMeasureText() {
-    if (!gGraphicsHack) {
-        gGraphicsHack = new GlobalGraphicsHack();
+    ScopedCritSec scope(&gMiniMuiCs);
+    DWORD threadId = GetCurrentThreadId();
+    GlobalGraphicsHack* gh = gGraphicsHack;
+    for (; gh && gh->threadId != threadId; gh = gh->next) {
+        // search
     }
-    return &gGraphicsHack->gfx;
+    if (!gh) {
+        gh = new GlobalGraphicsHack();
+        gh->threadId = threadId;
+        gh->next = gGraphicsHack;
+        gGraphicsHack = gh;
+    }
+    gh->refCount++;
+    return &gh->gfx;
 }
 
-void FreeGraphicsForMeasureText([[maybe_unused]] Graphics* g) {
-    /* deallocation happens in mui::Destroy */
+void FreeGraphicsForMeasureText(Graphics* g) {
+    ScopedCritSec scope(&gMiniMuiCs);
+    GlobalGraphicsHack** gh = &gGraphicsHack;
+    for (; *gh && &(*gh)->gfx != g; gh = &(*gh)->next) {
+        // search
+    }
+    // the Graphics of the thread which first measured text
+    // is only deallocated in mui::Destroy
+    if (!*gh || --(*gh)->refCount > 0 || !(*gh)->next) {
+        return;
+    }
+    GlobalGraphicsHack* toFree = *gh;
+    *gh = toFree->next;
+    delete toFree;
 }
 
 // allow for calls to mui::Initialize and mui::Destroy to be nested
 static LONG gMiniMuiRefCount = 0;
 
 void Initialize() {
-    InterlockedIncrement(&gMiniMuiRefCount);
+    if (InterlockedIncrement(&gMiniMuiRefCount) == 1) {
+        InitializeCriticalSection(&gMiniMuiCs);
+    }
 }
 
 void Destroy() {
@@ -147,7 +181,11 @@ void Destroy() {
 
     delete gFontCache;
     gFontCache = nullptr;
-    delete gGraphicsHack;
-    gGraphicsHack = nullptr;
+    while (gGraphicsHack) {
+        GlobalGraphicsHack* next = gGraphicsHack->next;
+        delete gGraphicsHack;
+        gGraphicsHack = next;
+    }
+    DeleteCriticalSection(&gMiniMuiCs);
 }
 } // namespace mui
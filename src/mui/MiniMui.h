@@ -6,6 +6,8 @@
 
 namespace mui {
 
+struct GlyphAdvances;
+
 void Initialize();
 void Destroy();
 
@@ -17,6 +19,8 @@ struct CachedFont {
     Gdiplus::Font* font;
     // hFont is created out of font
     HFONT hFont;
+    // created on demand by TextRenderGdi
+    GlyphAdvances* advances = nullptr;
 
     HFONT GetHFont();
     Gdiplus::FontStyle GetStyle() const {
@@ -35,6 +35,7 @@ class FontListItem {
         str::Free(cf.name);
         ::delete cf.font;
         DeleteObject(cf.hFont);
+        free(cf.advances);
         delete next;
     }
 
@@ -18,6 +18,8 @@ class ScopedMuiCritSec {
     }
 };
 
+struct GlyphAdvances;
+
 struct CachedFont {
     const WCHAR* name;
     float sizePt;
@@ -26,6 +28,8 @@ struct CachedFont {
     Gdiplus::Font* font;
     // hFont is created out of font
     HFONT hFont;
+    // created on demand by TextRenderGdi
+    GlyphAdvances* advances = nullptr;
 
     HFONT GetHFont();
     Gdiplus::FontStyle GetStyle() const {
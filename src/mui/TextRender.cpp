@@ -110,7 +110,78 @@ float TextRenderGdi::GetCurrFontLineSpacing() {
 #endif
 }
 
+static bool gUseGlyphAdvances = true;
+
+void SetUseGlyphAdvances(bool enable) {
+    gUseGlyphAdvances = enable;
+}
+
+// combining marks (below MAX_GLYPH_ADVANCE_CHAR) are positioned relative to
+// the preceding character, so their advance widths can't simply be summed up
+static bool IsCombiningMark(int c) {
+    return (c >= 0x300 && c <= 0x36F) || (c >= 0x483 && c <= 0x489);
+}
+
+// GetTextExtentPoint32W() returns the sum of the advance widths of the characters
+// (GDI doesn't apply kerning), so that the width of text consisting of characters
+// which don't need shaping can be summed up from a per-font cache
+GlyphAdvances* TextRenderGdi::GetGlyphAdvances() {
+    if (!gUseGlyphAdvances || !currFont || !hdcForTextMeasure) {
+        return nullptr;
+    }
+    // fonts are shared between threads and advances is only set once
+    void** advancesPtr = (void**)&currFont->advances;
+    GlyphAdvances* ga = (GlyphAdvances*)InterlockedCompareExchangePointer(advancesPtr, nullptr, nullptr);
+    if (ga) {
+        return ga;
+    }
+
+    ga = AllocStruct<GlyphAdvances>();
+    WCHAR chars[MAX_GLYPH_ADVANCE_CHAR];
+    for (int c = 0; c < MAX_GLYPH_ADVANCE_CHAR; c++) {
+        chars[c] = (WCHAR)c;
+    }
+    INT widths[MAX_GLYPH_ADVANCE_CHAR];
+    WORD glyphs[MAX_GLYPH_ADVANCE_CHAR];
+    TEXTMETRICW tm{};
+    BOOL ok = GetTextMetricsW(hdcForTextMeasure, &tm);
+    ok = ok && GetCharWidth32W(hdcForTextMeasure, 0, MAX_GLYPH_ADVANCE_CHAR - 1, widths);
+    ok = ok && GDI_ERROR != GetGlyphIndicesW(hdcForTextMeasure, chars, MAX_GLYPH_ADVANCE_CHAR, glyphs,
+                                             GGI_MARK_NONEXISTING_GLYPHS);
+    ga->dy = tm.tmHeight;
+    for (int c = 0; c < MAX_GLYPH_ADVANCE_CHAR; c++) {
+        // missing glyphs might be taken from a linked font
+        bool isCached = ok && c >= 0x20 && !IsCombiningMark(c) && glyphs[c] != 0xFFFF && widths[c] >= 0 &&
+                        widths[c] <= SHRT_MAX;
+        ga->dx[c] = isCached ? (short)widths[c] : -1;
+    }
+
+    GlyphAdvances* prev = (GlyphAdvances*)InterlockedCompareExchangePointer(advancesPtr, ga, nullptr);
+    if (prev) {
+        // another thread was faster
+        free(ga);
+        ga = prev;
+    }
+    return ga;
+}
+
 RectF TextRenderGdi::Measure(const WCHAR* s, size_t sLen) {
+    GlyphAdvances* ga = GetGlyphAdvances();
+    if (ga) {
+        int dx = 0;
+        size_t i = 0;
+        for (; i < sLen; i++) {
+            WCHAR c = s[i];
+            if (c >= MAX_GLYPH_ADVANCE_CHAR || ga->dx[c] < 0) {
+                break;
+            }
+            dx += ga->dx[c];
+        }
+        if (i == sLen) {
+            return RectF(0.0f, 0.0f, (float)dx, (float)ga->dy);
+        }
+    }
+
     SIZE txtSize;
     GetTextExtentPoint32W(hdcForTextMeasure, s, (int)sLen, &txtSize);
     RectF res(0.0f, 0.0f, (float)txtSize.cx, (float)txtSize.cy);
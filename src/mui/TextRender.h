@@ -10,6 +10,21 @@ enum TextRenderMethod {
     // TextRenderDirectDraw
 };
 
+// characters below this are measured by summing up their cached advance
+// widths (GDI doesn't shape them, unlike e.g. Hebrew, Arabic or Indic scripts)
+#define MAX_GLYPH_ADVANCE_CHAR 0x590
+
+// advance widths of the characters of a CachedFont in a measuring HDC,
+// -1 for characters which the font doesn't have (or which GDI treats specially,
+// such as combining marks)
+struct GlyphAdvances {
+    int dy;
+    short dx[MAX_GLYPH_ADVANCE_CHAR];
+};
+
+// for comparing the layout performance with and without GlyphAdvances
+void SetUseGlyphAdvances(bool enable);
+
 class ITextRender {
   public:
     virtual void SetFont(CachedFont* font) = 0;
@@ -64,6 +79,7 @@ class TextRenderGdi : public ITextRender {
 
     void FreeMemBmp();
     void CreateClearBmpOfSize(int dx, int dy);
+    GlyphAdvances* GetGlyphAdvances();
     void RestoreMemHdcPrevFont();
     void RestoreHdcForTextMeasurePrevFont();
     void RestoreMemHdcPrevBitmap();
@@ -20,6 +20,7 @@ extern void CryptoUtilTest();
 extern void CssParser_UnitTests();
 extern void DictTest();
 extern void FileUtilTest();
+extern void FindSubstringTest();
 extern void HtmlPrettyPrintTest();
 extern void HtmlPullParser_UnitTests();
 extern void JsonTest();
@@ -44,6 +45,7 @@ int main([[maybe_unused]] int argc, [[maybe_unused]] char** argv) {
     CssParser_UnitTests();
     DictTest();
     FileUtilTest();
+    FindSubstringTest();
     HtmlPrettyPrintTest();
     HtmlPullParser_UnitTests();
     JsonTest();
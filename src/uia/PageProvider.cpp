@@ -154,10 +154,11 @@ HRESULT STDMETHODCALLTYPE SumatraUIAutomationPageProvider::get_BoundingRectangle
     RECT canvasRect;
     GetWindowRect(canvasHwnd, &canvasRect);
 
-    pRetVal->left = canvasRect.left + page->pageOnScreen.x;
-    pRetVal->top = canvasRect.top + page->pageOnScreen.y;
-    pRetVal->width = page->pageOnScreen.dx;
-    pRetVal->height = page->pageOnScreen.dy;
+    Rect pageOnScreen = dm->PageOnScreen(pageNum);
+    pRetVal->left = canvasRect.left + pageOnScreen.x;
+    pRetVal->top = canvasRect.top + pageOnScreen.y;
+    pRetVal->width = pageOnScreen.dx;
+    pRetVal->height = pageOnScreen.dy;
 
     return S_OK;
 }
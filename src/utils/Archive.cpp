@@ -105,6 +105,10 @@ std::span<u8> MultiFormatArchive::GetFileDataByName(const char* fileName) {
 }
 
 std::span<u8> MultiFormatArchive::GetFileDataById(size_t fileId) {
+    return GetFileDataPartById(fileId, (size_t)-1);
+}
+
+std::span<u8> MultiFormatArchive::GetFileDataPartById(size_t fileId, size_t maxSize) {
     if (fileId == (size_t)-1) {
         return {};
     }
@@ -125,7 +129,7 @@ std::span<u8> MultiFormatArchive::GetFileDataById(size_t fileId) {
     if (!ar_parse_entry_at(ar_, filePos)) {
         return {};
     }
-    size_t size = fileInfo->fileSizeUncompressed;
+    size_t size = std::min(fileInfo->fileSizeUncompressed, maxSize);
     if (addOverflows<size_t>(size, ZERO_PADDING_COUNT)) {
         return {};
     }
@@ -134,6 +138,7 @@ std::span<u8> MultiFormatArchive::GetFileDataById(size_t fileId) {
         return {};
     }
     if (!ar_entry_uncompress(ar_, data, size)) {
+        free(data);
         return {};
     }
 
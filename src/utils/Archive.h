@@ -42,6 +42,9 @@ class MultiFormatArchive {
 #endif
     std::span<u8> GetFileDataByName(const char* filename);
     std::span<u8> GetFileDataById(size_t fileId);
+    // extracts at most the first maxSize bytes of a file
+    // (the whole file if it's been loaded using unrar.dll)
+    std::span<u8> GetFileDataPartById(size_t fileId, size_t maxSize);
 
     std::string_view GetComment();
 
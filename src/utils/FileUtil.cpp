@@ -366,6 +366,45 @@ bool IsOnFixedDrive(const WCHAR* path) {
     return DRIVE_FIXED == type;
 }
 
+// USB and similar disks are reported as fixed drives by GetDriveType
+// but can be unplugged at any time
+bool IsOnRemovableBus(const WCHAR* path) {
+    WCHAR root[MAX_PATH];
+    WCHAR volume[MAX_PATH];
+    if (!GetVolumePathName(path, root, dimof(root)) || !GetVolumeNameForVolumeMountPoint(root, volume, dimof(volume))) {
+        return true;
+    }
+    // the volume can only be opened without the trailing backslash
+    size_t len = str::Len(volume);
+    if (len > 0 && volume[len - 1] == '\\') {
+        volume[len - 1] = '\0';
+    }
+    HANDLE h = CreateFile(volume, 0, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_EXISTING, 0, nullptr);
+    if (INVALID_HANDLE_VALUE == h) {
+        return true;
+    }
+    STORAGE_PROPERTY_QUERY query{};
+    query.PropertyId = StorageDeviceProperty;
+    query.QueryType = PropertyStandardQuery;
+    // only the fixed part of the descriptor is needed
+    STORAGE_DEVICE_DESCRIPTOR desc{};
+    DWORD size = 0;
+    BOOL ok =
+        DeviceIoControl(h, IOCTL_STORAGE_QUERY_PROPERTY, &query, sizeof(query), &desc, sizeof(desc), &size, nullptr);
+    CloseHandle(h);
+    if (!ok) {
+        return true;
+    }
+    switch (desc.BusType) {
+        case BusTypeUsb:
+        case BusType1394:
+        case BusTypeSd:
+        case BusTypeMmc:
+            return true;
+    }
+    return desc.RemovableMedia != FALSE;
+}
+
 static bool MatchWildcardsRec(const WCHAR* fileName, const WCHAR* filter) {
 #define AtEndOf(str) (*(str) == '\0')
     switch (*filter) {
@@ -737,4 +776,155 @@ bool RemoveAll(const WCHAR* dir) {
 bool FileTimeEq(const FILETIME& a, const FILETIME& b) {
     return a.dwLowDateTime == b.dwLowDateTime && a.dwHighDateTime == b.dwHighDateTime;
 }
+
+MappedCacheFile::~MappedCacheFile() {
+    Close();
+}
+
+bool MappedCacheFile::Open(const WCHAR* path) {
+    Close();
+    // FILE_WRITE_ATTRIBUTES for MarkUsed()
+    hFile = CreateFileW(path, GENERIC_READ | FILE_WRITE_ATTRIBUTES, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                        FILE_ATTRIBUTE_NORMAL, nullptr);
+    LARGE_INTEGER fileSize;
+    if (hFile == INVALID_HANDLE_VALUE || !GetFileSizeEx(hFile, &fileSize) || fileSize.QuadPart == 0) {
+        Close();
+        return false;
+    }
+    hMap = CreateFileMappingW(hFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (hMap) {
+        data = (const u8*)MapViewOfFile(hMap, FILE_MAP_READ, 0, 0, 0);
+    }
+    if (!data) {
+        Close();
+        return false;
+    }
+    size = (u64)fileSize.QuadPart;
+    return true;
+}
+
+void MappedCacheFile::Close() {
+    if (data) {
+        UnmapViewOfFile(data);
+    }
+    if (hMap) {
+        CloseHandle(hMap);
+    }
+    if (hFile != INVALID_HANDLE_VALUE) {
+        CloseHandle(hFile);
+    }
+    hFile = INVALID_HANDLE_VALUE;
+    hMap = nullptr;
+    data = nullptr;
+    size = 0;
+}
+
+void MappedCacheFile::MarkUsed() {
+    FILETIME now;
+    GetSystemTimeAsFileTime(&now);
+    SetFileTime(hFile, nullptr, nullptr, &now);
+}
+
+CacheFileWriter::CacheFileWriter(const WCHAR* path) {
+    this->path = str::Dup(path);
+    tmpPath = str::Join(path, L".tmp");
+    h = CreateFileW(tmpPath, GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    ok = h != INVALID_HANDLE_VALUE;
+}
+
+CacheFileWriter::~CacheFileWriter() {
+    if (h != INVALID_HANDLE_VALUE) {
+        CloseHandle(h);
+        file::Delete(tmpPath);
+    }
+    free(tmpPath);
+    free(path);
+}
+
+bool CacheFileWriter::Write(const void* data, size_t size) {
+    DWORD nWritten = 0;
+    ok = ok && ::WriteFile(h, data, (DWORD)size, &nWritten, nullptr) && nWritten == size;
+    return ok;
+}
+
+bool CacheFileWriter::Commit() {
+    if (h != INVALID_HANDLE_VALUE) {
+        CloseHandle(h);
+        h = INVALID_HANDLE_VALUE;
+    }
+    ok = ok && MoveFileExW(tmpPath, path, MOVEFILE_REPLACE_EXISTING);
+    if (!ok) {
+        file::Delete(tmpPath);
+    }
+    return ok;
+}
+
+struct CacheFileInfo {
+    WCHAR* name;
+    u64 size;
+    u64 lastUsed;
+};
+
+static int cmpCacheFileInfoLastUsed(const void* a, const void* b) {
+    const CacheFileInfo* fa = (const CacheFileInfo*)a;
+    const CacheFileInfo* fb = (const CacheFileInfo*)b;
+    return fa->lastUsed < fb->lastUsed ? -1 : fa->lastUsed > fb->lastUsed ? 1 : 0;
+}
+
+// removes the temporary files CacheFileWriter leaves behind if the
+// process is terminated while writing. Files still being written can't
+// be deleted, as CacheFileWriter doesn't share them
+static void DeleteLeftoverTmpFiles(const WCHAR* dir, const WCHAR* ext) {
+    AutoFreeWstr pattern(str::Format(L"%s\\*%s.tmp", dir, ext));
+    WIN32_FIND_DATA fdata;
+    HANDLE hfind = FindFirstFile(pattern, &fdata);
+    if (INVALID_HANDLE_VALUE == hfind) {
+        return;
+    }
+    do {
+        if (!(fdata.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)) {
+            AutoFreeWstr path(path::Join(dir, fdata.cFileName));
+            file::Delete(path);
+        }
+    } while (FindNextFile(hfind, &fdata));
+    FindClose(hfind);
+}
+
+void CleanUpCacheFiles(const WCHAR* dir, const WCHAR* ext, u64 maxTotalSize, bool deleteAll) {
+    if (!dir) {
+        return;
+    }
+    DeleteLeftoverTmpFiles(dir, ext);
+    AutoFreeWstr pattern(str::Format(L"%s\\*%s", dir, ext));
+
+    Vec<CacheFileInfo> files;
+    u64 totalSize = 0;
+    WIN32_FIND_DATA fdata;
+    HANDLE hfind = FindFirstFile(pattern, &fdata);
+    if (INVALID_HANDLE_VALUE == hfind) {
+        return;
+    }
+    do {
+        if (fdata.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) {
+            continue;
+        }
+        CacheFileInfo f;
+        f.name = str::Dup(fdata.cFileName);
+        f.size = ((u64)fdata.nFileSizeHigh << 32) | fdata.nFileSizeLow;
+        f.lastUsed = ((u64)fdata.ftLastWriteTime.dwHighDateTime << 32) | fdata.ftLastWriteTime.dwLowDateTime;
+        files.Append(f);
+        totalSize += f.size;
+    } while (FindNextFile(hfind, &fdata));
+    FindClose(hfind);
+
+    files.Sort(cmpCacheFileInfoLastUsed);
+    for (CacheFileInfo& f : files) {
+        if (deleteAll || totalSize > maxTotalSize) {
+            AutoFreeWstr path(path::Join(dir, f.name));
+            file::Delete(path);
+            totalSize -= f.size;
+        }
+        free(f.name);
+    }
+}
 #endif
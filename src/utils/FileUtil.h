@@ -26,6 +26,7 @@ WCHAR* ShortPath(const WCHAR* path);
 bool IsSame(const WCHAR* path1, const WCHAR* path2);
 bool HasVariableDriveLetter(const WCHAR* path);
 bool IsOnFixedDrive(const WCHAR* path);
+bool IsOnRemovableBus(const WCHAR* path);
 bool Match(const WCHAR* path, const WCHAR* filter);
 bool IsAbsolute(const WCHAR* path);
 
@@ -81,4 +82,40 @@ bool RemoveAll(const WCHAR* dir);
 
 #if OS_WIN
 bool FileTimeEq(const FILETIME& a, const FILETIME& b);
+
+// a file of an on-disk cache, mapped into memory (read-only)
+struct MappedCacheFile {
+    HANDLE hFile = INVALID_HANDLE_VALUE;
+    HANDLE hMap = nullptr;
+    const u8* data = nullptr;
+    u64 size = 0;
+
+    MappedCacheFile() = default;
+    ~MappedCacheFile();
+    bool Open(const WCHAR* path);
+    void Close();
+    // to be called once the content turned out to be valid
+    // (CleanUpCacheFiles removes the least recently used files first)
+    void MarkUsed();
+};
+
+// writes a file of an on-disk cache under a temporary name and only
+// replaces path with it in Commit(), so that a concurrently opened cache
+// file is never seen half-written. Without Commit() nothing is replaced
+struct CacheFileWriter {
+    WCHAR* path = nullptr;
+    WCHAR* tmpPath = nullptr;
+    HANDLE h = INVALID_HANDLE_VALUE;
+    bool ok = false;
+
+    explicit CacheFileWriter(const WCHAR* path);
+    ~CacheFileWriter();
+    bool Write(const void* data, size_t size);
+    bool Commit();
+};
+
+// removes the least recently used files with extension ext from dir while
+// they take up more than maxTotalSize bytes (or all of them if deleteAll is set)
+// and the *<ext>.tmp files of interrupted CacheFileWriters
+void CleanUpCacheFiles(const WCHAR* dir, const WCHAR* ext, u64 maxTotalSize, bool deleteAll);
 #endif
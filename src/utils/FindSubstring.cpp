@@ -0,0 +1,344 @@
+/* Copyright 2020 the SumatraPDF project authors (see AUTHORS file).
+   License: Simplified BSD (see COPYING.BSD) */
+
+#include "BaseUtil.h"
+#include "FindSubstring.h"
+
+#include <intrin.h>
+#include <immintrin.h>
+
+#if defined(__clang__)
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define TARGET_AVX2
+#endif
+
+// the SIMD kernels below read whole aligned blocks, which may start before
+// the text and end after its terminating zero (resp. at or after end)
+#if defined(__clang__)
+#define NO_SANITIZE_ADDRESS __attribute__((no_sanitize_address))
+#elif defined(_MSC_VER)
+#define NO_SANITIZE_ADDRESS __declspec(no_sanitize_address)
+#else
+#define NO_SANITIZE_ADDRESS
+#endif
+
+// lower case of every UTF-16 code unit (as returned by CharLowerBuffW)
+static const WCHAR* BuildLowerCaseTable() {
+    WCHAR* table = AllocArray<WCHAR>(0x10000);
+    for (int i = 0; i < 0x10000; i++) {
+        table[i] = (WCHAR)i;
+    }
+    CharLowerBuffW(table, 0x10000);
+    return table;
+}
+
+const WCHAR* GetLowerCaseTable() {
+    static const WCHAR* table = BuildLowerCaseTable();
+    return table;
+}
+
+static bool CanUseAvx2() {
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7) {
+        return false;
+    }
+    __cpuid(info, 1);
+    // the OS must also save the AVX registers (OSXSAVE and XCR0)
+    bool hasOsAvx = (info[2] & (1 << 27)) && (info[2] & (1 << 28)) && (_xgetbv(0) & 6) == 6;
+    __cpuidex(info, 7, 0);
+    return hasOsAvx && (info[1] & (1 << 5));
+}
+
+TextSearchKernel GetBestTextSearchKernel() {
+    static TextSearchKernel best = CanUseAvx2() ? TextSearchKernel::AVX2 : TextSearchKernel::SSE2;
+    return best;
+}
+
+// the code units that have the same lower case as the first character
+// of the search text (e.g. 'k', 'K' and KELVIN SIGN for 'k').
+// n is -1 if there are too many of them
+struct FirstCharVariants {
+    WCHAR first;
+    bool caseSensitive;
+    WCHAR c[4];
+    int n;
+};
+
+static void GetFirstCharVariants(WCHAR first, bool caseSensitive, FirstCharVariants* v) {
+    // the same search text is looked for in every page, so remember
+    // the variants instead of going through all code units every time
+    static thread_local FirstCharVariants last{};
+    if (last.n != 0 && last.first == first && last.caseSensitive == caseSensitive) {
+        *v = last;
+        return;
+    }
+    v->first = first;
+    v->caseSensitive = caseSensitive;
+    v->n = 0;
+    if (caseSensitive) {
+        v->c[v->n++] = first;
+        last = *v;
+        return;
+    }
+    const WCHAR* lower = GetLowerCaseTable();
+    WCHAR folded = lower[first];
+    for (int i = 1; i < 0x10000; i++) {
+        if (lower[i] != folded) {
+            continue;
+        }
+        if (v->n == dimof(v->c)) {
+            v->n = -1;
+            break;
+        }
+        v->c[v->n++] = (WCHAR)i;
+    }
+    last = *v;
+}
+
+// compares s (apart from the first character) with text at pos
+static inline bool MatchesAt(const WCHAR* pos, const WCHAR* s, bool caseSensitive) {
+    if (caseSensitive) {
+        for (s++, pos++; *s; s++, pos++) {
+            if (*s != *pos) {
+                return false;
+            }
+        }
+        return true;
+    }
+    const WCHAR* lower = GetLowerCaseTable();
+    for (s++, pos++; *s; s++, pos++) {
+        if (lower[*s] != lower[*pos]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static const WCHAR* FindSubstringScalar(const WCHAR* text, const WCHAR* s, bool caseSensitive) {
+    const WCHAR* lower = GetLowerCaseTable();
+    WCHAR first = caseSensitive ? s[0] : lower[s[0]];
+    for (const WCHAR* pos = text; *pos; pos++) {
+        WCHAR c = caseSensitive ? *pos : lower[*pos];
+        if (c == first && MatchesAt(pos, s, caseSensitive)) {
+            return pos;
+        }
+    }
+    return nullptr;
+}
+
+static const WCHAR* FindSubstringReverseScalar(const WCHAR* text, const WCHAR* end, const WCHAR* s,
+                                               bool caseSensitive) {
+    const WCHAR* lower = GetLowerCaseTable();
+    WCHAR first = caseSensitive ? s[0] : lower[s[0]];
+    for (const WCHAR* pos = end - 1; pos >= text; pos--) {
+        WCHAR c = caseSensitive ? *pos : lower[*pos];
+        if (c == first && MatchesAt(pos, s, caseSensitive)) {
+            return pos;
+        }
+    }
+    return nullptr;
+}
+
+// The SIMD versions look for the first character of s 8 (SSE2) resp. 16 (AVX2)
+// code units at a time and only compare the rest at candidate positions.
+// Loads are aligned so that reading past the string's end (or before its
+// start) never crosses into another (possibly unmapped) memory page. The
+// bytes read outside of the string are masked out, but AddressSanitizer
+// would still report them, so it must not instrument these functions.
+// movemask yields 2 bits per code unit, so bit indexes are halved
+
+NO_SANITIZE_ADDRESS
+static const WCHAR* FindSubstringSSE2(const WCHAR* text, const WCHAR* s, bool caseSensitive,
+                                      const FirstCharVariants& v) {
+    __m128i needles[4];
+    for (int i = 0; i < v.n; i++) {
+        needles[i] = _mm_set1_epi16((short)v.c[i]);
+    }
+    const __m128i zero = _mm_setzero_si128();
+    const WCHAR* p = (const WCHAR*)((UINT_PTR)text & ~(UINT_PTR)15);
+    // ignore code units before text in the first block
+    unsigned skipMask = ~0u << (unsigned)((text - p) * 2);
+    for (;; p += 8) {
+        __m128i block = _mm_load_si128((const __m128i*)p);
+        __m128i eq = _mm_cmpeq_epi16(block, needles[0]);
+        for (int i = 1; i < v.n; i++) {
+            eq = _mm_or_si128(eq, _mm_cmpeq_epi16(block, needles[i]));
+        }
+        unsigned candidates = (unsigned)_mm_movemask_epi8(eq) & skipMask;
+        unsigned zeros = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi16(block, zero)) & skipMask;
+        skipMask = ~0u;
+        if (zeros) {
+            // only consider code units before the terminating zero
+            candidates &= (zeros & (0u - zeros)) - 1;
+        }
+        while (candidates) {
+            unsigned long bit;
+            _BitScanForward(&bit, candidates);
+            const WCHAR* pos = p + bit / 2;
+            if (MatchesAt(pos, s, caseSensitive)) {
+                return pos;
+            }
+            candidates &= ~(3u << bit);
+        }
+        if (zeros) {
+            return nullptr;
+        }
+    }
+}
+
+TARGET_AVX2 NO_SANITIZE_ADDRESS
+static const WCHAR* FindSubstringAVX2(const WCHAR* text, const WCHAR* s, bool caseSensitive,
+                                      const FirstCharVariants& v) {
+    __m256i needles[4];
+    for (int i = 0; i < v.n; i++) {
+        needles[i] = _mm256_set1_epi16((short)v.c[i]);
+    }
+    const __m256i zero = _mm256_setzero_si256();
+    const WCHAR* p = (const WCHAR*)((UINT_PTR)text & ~(UINT_PTR)31);
+    unsigned skipMask = ~0u << (unsigned)((text - p) * 2);
+    for (;; p += 16) {
+        __m256i block = _mm256_load_si256((const __m256i*)p);
+        __m256i eq = _mm256_cmpeq_epi16(block, needles[0]);
+        for (int i = 1; i < v.n; i++) {
+            eq = _mm256_or_si256(eq, _mm256_cmpeq_epi16(block, needles[i]));
+        }
+        unsigned candidates = (unsigned)_mm256_movemask_epi8(eq) & skipMask;
+        unsigned zeros = (unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi16(block, zero)) & skipMask;
+        skipMask = ~0u;
+        if (zeros) {
+            candidates &= (zeros & (0u - zeros)) - 1;
+        }
+        while (candidates) {
+            unsigned long bit;
+            _BitScanForward(&bit, candidates);
+            const WCHAR* pos = p + bit / 2;
+            if (MatchesAt(pos, s, caseSensitive)) {
+                return pos;
+            }
+            candidates &= ~(3u << bit);
+        }
+        if (zeros) {
+            return nullptr;
+        }
+    }
+}
+
+NO_SANITIZE_ADDRESS
+static const WCHAR* FindSubstringReverseSSE2(const WCHAR* text, const WCHAR* end, const WCHAR* s,
+                                             bool caseSensitive, const FirstCharVariants& v) {
+    __m128i needles[4];
+    for (int i = 0; i < v.n; i++) {
+        needles[i] = _mm_set1_epi16((short)v.c[i]);
+    }
+    const WCHAR* first = (const WCHAR*)((UINT_PTR)text & ~(UINT_PTR)15);
+    const WCHAR* p = (const WCHAR*)((UINT_PTR)(end - 1) & ~(UINT_PTR)15);
+    // ignore code units at or after end in the first block
+    unsigned keepMask = 0xFFFFu >> (unsigned)(16 - (end - p) * 2);
+    for (;; p -= 8) {
+        if (p == first) {
+            // ignore code units before text in the last block
+            keepMask &= 0xFFFFu << (unsigned)((text - p) * 2);
+        }
+        __m128i block = _mm_load_si128((const __m128i*)p);
+        __m128i eq = _mm_cmpeq_epi16(block, needles[0]);
+        for (int i = 1; i < v.n; i++) {
+            eq = _mm_or_si128(eq, _mm_cmpeq_epi16(block, needles[i]));
+        }
+        unsigned candidates = (unsigned)_mm_movemask_epi8(eq) & keepMask;
+        keepMask = 0xFFFFu;
+        while (candidates) {
+            unsigned long bit;
+            _BitScanReverse(&bit, candidates);
+            // bit is the upper bit of the code unit's pair
+            const WCHAR* pos = p + bit / 2;
+            if (MatchesAt(pos, s, caseSensitive)) {
+                return pos;
+            }
+            candidates &= ~(3u << (bit - 1));
+        }
+        if (p == first) {
+            return nullptr;
+        }
+    }
+}
+
+TARGET_AVX2 NO_SANITIZE_ADDRESS
+static const WCHAR* FindSubstringReverseAVX2(const WCHAR* text, const WCHAR* end, const WCHAR* s,
+                                             bool caseSensitive, const FirstCharVariants& v) {
+    __m256i needles[4];
+    for (int i = 0; i < v.n; i++) {
+        needles[i] = _mm256_set1_epi16((short)v.c[i]);
+    }
+    const WCHAR* first = (const WCHAR*)((UINT_PTR)text & ~(UINT_PTR)31);
+    const WCHAR* p = (const WCHAR*)((UINT_PTR)(end - 1) & ~(UINT_PTR)31);
+    unsigned keepMask = 0xFFFFFFFFu >> (unsigned)(32 - (end - p) * 2);
+    for (;; p -= 16) {
+        if (p == first) {
+            keepMask &= 0xFFFFFFFFu << (unsigned)((text - p) * 2);
+        }
+        __m256i block = _mm256_load_si256((const __m256i*)p);
+        __m256i eq = _mm256_cmpeq_epi16(block, needles[0]);
+        for (int i = 1; i < v.n; i++) {
+            eq = _mm256_or_si256(eq, _mm256_cmpeq_epi16(block, needles[i]));
+        }
+        unsigned candidates = (unsigned)_mm256_movemask_epi8(eq) & keepMask;
+        keepMask = 0xFFFFFFFFu;
+        while (candidates) {
+            unsigned long bit;
+            _BitScanReverse(&bit, candidates);
+            const WCHAR* pos = p + bit / 2;
+            if (MatchesAt(pos, s, caseSensitive)) {
+                return pos;
+            }
+            candidates &= ~(3u << (bit - 1));
+        }
+        if (p == first) {
+            return nullptr;
+        }
+    }
+}
+
+// finds the first occurrence of s in text (ignoring case unless caseSensitive)
+const WCHAR* FindSubstring(const WCHAR* text, const WCHAR* s, bool caseSensitive, TextSearchKernel kernel) {
+    if (!text || str::IsEmpty(s)) {
+        return nullptr;
+    }
+    if (kernel == TextSearchKernel::Auto) {
+        kernel = GetBestTextSearchKernel();
+    }
+    FirstCharVariants v{};
+    if (kernel != TextSearchKernel::Scalar) {
+        GetFirstCharVariants(s[0], caseSensitive, &v);
+    }
+    if (kernel == TextSearchKernel::Scalar || v.n <= 0) {
+        return FindSubstringScalar(text, s, caseSensitive);
+    }
+    if (kernel == TextSearchKernel::AVX2) {
+        return FindSubstringAVX2(text, s, caseSensitive, v);
+    }
+    return FindSubstringSSE2(text, s, caseSensitive, v);
+}
+
+// finds the last occurrence of s in text which starts before end
+const WCHAR* FindSubstringReverse(const WCHAR* text, const WCHAR* end, const WCHAR* s, bool caseSensitive,
+                                  TextSearchKernel kernel) {
+    if (!text || str::IsEmpty(s) || end <= text) {
+        return nullptr;
+    }
+    if (kernel == TextSearchKernel::Auto) {
+        kernel = GetBestTextSearchKernel();
+    }
+    FirstCharVariants v{};
+    if (kernel != TextSearchKernel::Scalar) {
+        GetFirstCharVariants(s[0], caseSensitive, &v);
+    }
+    if (kernel == TextSearchKernel::Scalar || v.n <= 0) {
+        return FindSubstringReverseScalar(text, end, s, caseSensitive);
+    }
+    if (kernel == TextSearchKernel::AVX2) {
+        return FindSubstringReverseAVX2(text, end, s, caseSensitive, v);
+    }
+    return FindSubstringReverseSSE2(text, end, s, caseSensitive, v);
+}
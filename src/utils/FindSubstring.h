@@ -0,0 +1,15 @@
+/* Copyright 2020 the SumatraPDF project authors (see AUTHORS file).
+   License: Simplified BSD (see COPYING.BSD) */
+
+// implementation used by FindSubstring (Auto picks the fastest one available)
+enum class TextSearchKernel { Auto, Scalar, SSE2, AVX2 };
+
+TextSearchKernel GetBestTextSearchKernel();
+
+// lower case of every UTF-16 code unit (as returned by CharLowerBuffW)
+const WCHAR* GetLowerCaseTable();
+
+const WCHAR* FindSubstring(const WCHAR* text, const WCHAR* s, bool caseSensitive,
+                           TextSearchKernel kernel = TextSearchKernel::Auto);
+const WCHAR* FindSubstringReverse(const WCHAR* text, const WCHAR* end, const WCHAR* s, bool caseSensitive,
+                                  TextSearchKernel kernel = TextSearchKernel::Auto);
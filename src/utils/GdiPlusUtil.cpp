@@ -463,90 +463,170 @@ Bitmap* BitmapFromData(std::span<u8> bmpData) {
 }
 
 // adapted from http://cpansearch.perl.org/src/RJRAY/Image-Size-3.230/lib/Image/Size.pm
-Size BitmapSizeFromData(std::span<u8> d) {
+static Size GifSizeFromHeader(ByteReader& r, size_t len) {
+    // find the first image's actual size instead of using the
+    // "logical screen" size which is sometimes too large
+    size_t ix = 13;
+    // skip the global color table
+    if ((r.Byte(10) & 0x80)) {
+        ix += 3 * (1 << ((r.Byte(10) & 0x07) + 1));
+    }
+    while (ix + 8 < len) {
+        if (r.Byte(ix) == 0x2C) {
+            return Size(r.WordLE(ix + 5), r.WordLE(ix + 7));
+        }
+        if (r.Byte(ix) != 0x21) {
+            break;
+        }
+        // skip the extension's sub-blocks (which may contain zero bytes,
+        // e.g. the loop count of animated GIFs)
+        ix += 2;
+        while (ix < len && r.Byte(ix) != 0) {
+            ix += r.Byte(ix) + 1;
+        }
+        ix++;
+    }
+    return Size();
+}
+
+static Size JpegSizeFromHeader(ByteReader& r, size_t len) {
+    Size result;
+    // find the last start of frame marker for non-differential Huffman/arithmetic coding
+    for (size_t ix = 2; ix + 9 < len && r.Byte(ix) == 0xFF;) {
+        u8 marker = r.Byte(ix + 1);
+        if (0xFF == marker) {
+            // fill byte
+            ix++;
+            continue;
+        }
+        if (0xD0 <= marker && marker <= 0xD7 || 0x01 == marker) {
+            // markers without a length
+            ix += 2;
+            continue;
+        }
+        if (0xC0 <= marker && marker <= 0xC3 || 0xC9 <= marker && marker <= 0xCB) {
+            result.dx = r.WordBE(ix + 7);
+            result.dy = r.WordBE(ix + 5);
+        } else if (0xDA == marker) {
+            // the entropy coded data follows the start of scan
+            break;
+        }
+        ix += r.WordBE(ix + 2) + 2;
+    }
+    return result;
+}
+
+static Size TiffSizeFromHeader(ByteReader& r, size_t len) {
+    Size result;
+    if (len < 10) {
+        return result;
+    }
+    bool isBE = r.Byte(0) == 'M', isJXR = r.Byte(2) == 0xBC;
+    CrashIf(!isBE && r.Byte(0) != 'I' || isJXR && isBE);
+    const WORD WIDTH = isJXR ? 0xBC80 : 0x0100, HEIGHT = isJXR ? 0xBC81 : 0x0101;
+    size_t idx = r.DWord(4, isBE);
+    WORD count = idx <= len - 2 ? r.Word(idx, isBE) : 0;
+    for (idx += 2; count > 0 && idx <= len - 12; count--, idx += 12) {
+        WORD tag = r.Word(idx, isBE), type = r.Word(idx + 2, isBE);
+        if (r.DWord(idx + 4, isBE) != 1) {
+            continue;
+        } else if (WIDTH == tag && 4 == type) {
+            result.dx = r.DWord(idx + 8, isBE);
+        } else if (WIDTH == tag && 3 == type) {
+            result.dx = r.Word(idx + 8, isBE);
+        } else if (WIDTH == tag && 1 == type) {
+            result.dx = r.Byte(idx + 8);
+        } else if (HEIGHT == tag && 4 == type) {
+            result.dy = r.DWord(idx + 8, isBE);
+        } else if (HEIGHT == tag && 3 == type) {
+            result.dy = r.Word(idx + 8, isBE);
+        } else if (HEIGHT == tag && 1 == type) {
+            result.dy = r.Byte(idx + 8);
+        }
+    }
+    return result;
+}
+
+static Size WebpSizeFromHeader(ByteReader& r, size_t len) {
+    const char* data = (const char*)r.d;
+    if (len >= 30 && str::StartsWith(data + 12, "VP8 ")) {
+        // lossy
+        return Size(r.WordLE(26) & 0x3fff, r.WordLE(28) & 0x3fff);
+    }
+    if (len >= 25 && str::StartsWith(data + 12, "VP8L") && r.Byte(20) == 0x2F) {
+        // lossless: 14 bits each for width - 1 and height - 1
+        u32 bits = r.DWordLE(21);
+        return Size((bits & 0x3fff) + 1, ((bits >> 14) & 0x3fff) + 1);
+    }
+    if (len >= 30 && str::StartsWith(data + 12, "VP8X")) {
+        // extended: 24 bits each for canvas width - 1 and height - 1
+        int dx = (r.Byte(24) | (r.Byte(25) << 8) | (r.Byte(26) << 16)) + 1;
+        int dy = (r.Byte(27) | (r.Byte(28) << 8) | (r.Byte(29) << 16)) + 1;
+        return Size(dx, dy);
+    }
+    return Size();
+}
+
+static Size Jp2SizeFromHeader(ByteReader& r, size_t len) {
+    Size result;
+    if (len < 32) {
+        return result;
+    }
+    size_t ix = 0;
+    while (ix < len - 32) {
+        u32 lbox = r.DWordBE(ix);
+        u32 tbox = r.DWordBE(ix + 4);
+        if (0x6A703268 /* jp2h */ == tbox) {
+            ix += 8;
+            if (r.DWordBE(ix) == 24 && r.DWordBE(ix + 4) == 0x69686472 /* ihdr */) {
+                result.dx = r.DWordBE(ix + 16);
+                result.dy = r.DWordBE(ix + 12);
+            }
+            break;
+        } else if (lbox != 0 && ix < UINT32_MAX - lbox) {
+            ix += lbox;
+        } else {
+            break;
+        }
+    }
+    return result;
+}
+
+// the size of most images can be determined from their first few KB
+// (JPEG and TIFF might need more, e.g. if they contain large metadata)
+Size ImageSizeFromHeader(std::span<u8> d) {
     Size result;
     ByteReader r(d);
     size_t len = d.size();
     u8* data = d.data();
     switch (GfxFormatFromData(d)) {
         case ImgFormat::BMP:
-            if (len >= sizeof(BITMAPFILEHEADER) + sizeof(BITMAPINFOHEADER)) {
-                BITMAPINFOHEADER bmi;
-                bool ok = r.UnpackLE(&bmi, sizeof(bmi), "3d2w6d", sizeof(BITMAPFILEHEADER));
-                CrashIf(!ok);
-                result.dx = bmi.biWidth;
-                result.dy = bmi.biHeight;
+            if (len >= sizeof(BITMAPFILEHEADER) + sizeof(BITMAPCOREHEADER)) {
+                size_t off = sizeof(BITMAPFILEHEADER);
+                if (r.DWordLE(off) == sizeof(BITMAPCOREHEADER)) {
+                    result.dx = r.WordLE(off + 4);
+                    result.dy = r.WordLE(off + 6);
+                } else if (len >= off + sizeof(BITMAPINFOHEADER)) {
+                    BITMAPINFOHEADER bmi;
+                    bool ok = r.UnpackLE(&bmi, sizeof(bmi), "3d2w6d", off);
+                    CrashIf(!ok);
+                    result.dx = bmi.biWidth;
+                    // top-down bitmaps have a negative height
+                    result.dy = abs(bmi.biHeight);
+                }
             }
             break;
         case ImgFormat::GIF:
             if (len >= 13) {
-                // find the first image's actual size instead of using the
-                // "logical screen" size which is sometimes too large
-                size_t ix = 13;
-                // skip the global color table
-                if ((r.Byte(10) & 0x80)) {
-                    ix += 3 * (1 << ((r.Byte(10) & 0x07) + 1));
-                }
-                while (ix + 8 < len) {
-                    if (r.Byte(ix) == 0x2C) {
-                        result.dx = r.WordLE(ix + 5);
-                        result.dy = r.WordLE(ix + 7);
-                        break;
-                    } else if (r.Byte(ix) == 0x21 && r.Byte(ix + 1) == 0xF9) {
-                        ix += 8;
-                    } else if (r.Byte(ix) == 0x21 && r.Byte(ix + 1) == 0xFE) {
-                        const u8* commentEnd = r.Find(ix + 2, 0x00);
-                        ix = commentEnd ? commentEnd - data + 1 : len;
-                    } else if (r.Byte(ix) == 0x21 && r.Byte(ix + 1) == 0x01 && ix + 15 < len) {
-                        const u8* textDataEnd = r.Find(ix + 15, 0x00);
-                        ix = textDataEnd ? textDataEnd - data + 1 : len;
-                    } else if (r.Byte(ix) == 0x21 && r.Byte(ix + 1) == 0xFF && ix + 14 < len) {
-                        const u8* applicationDataEnd = r.Find(ix + 14, 0x00);
-                        ix = applicationDataEnd ? applicationDataEnd - data + 1 : len;
-                    } else {
-                        break;
-                    }
-                }
+                result = GifSizeFromHeader(r, len);
             }
             break;
         case ImgFormat::JPEG:
-            // find the last start of frame marker for non-differential Huffman/arithmetic coding
-            for (size_t ix = 2; ix + 9 < len && r.Byte(ix) == 0xFF;) {
-                if (0xC0 <= r.Byte(ix + 1) && r.Byte(ix + 1) <= 0xC3 ||
-                    0xC9 <= r.Byte(ix + 1) && r.Byte(ix + 1) <= 0xCB) {
-                    result.dx = r.WordBE(ix + 7);
-                    result.dy = r.WordBE(ix + 5);
-                }
-                ix += r.WordBE(ix + 2) + 2;
-            }
+            result = JpegSizeFromHeader(r, len);
             break;
         case ImgFormat::JXR:
         case ImgFormat::TIFF:
-            if (len >= 10) {
-                bool isBE = r.Byte(0) == 'M', isJXR = r.Byte(2) == 0xBC;
-                CrashIf(!isBE && r.Byte(0) != 'I' || isJXR && isBE);
-                const WORD WIDTH = isJXR ? 0xBC80 : 0x0100, HEIGHT = isJXR ? 0xBC81 : 0x0101;
-                size_t idx = r.DWord(4, isBE);
-                WORD count = idx <= len - 2 ? r.Word(idx, isBE) : 0;
-                for (idx += 2; count > 0 && idx <= len - 12; count--, idx += 12) {
-                    WORD tag = r.Word(idx, isBE), type = r.Word(idx + 2, isBE);
-                    if (r.DWord(idx + 4, isBE) != 1) {
-                        continue;
-                    } else if (WIDTH == tag && 4 == type) {
-                        result.dx = r.DWord(idx + 8, isBE);
-                    } else if (WIDTH == tag && 3 == type) {
-                        result.dx = r.Word(idx + 8, isBE);
-                    } else if (WIDTH == tag && 1 == type) {
-                        result.dx = r.Byte(idx + 8);
-                    } else if (HEIGHT == tag && 4 == type) {
-                        result.dy = r.DWord(idx + 8, isBE);
-                    } else if (HEIGHT == tag && 3 == type) {
-                        result.dy = r.Word(idx + 8, isBE);
-                    } else if (HEIGHT == tag && 1 == type) {
-                        result.dy = r.Byte(idx + 8);
-                    }
-                }
-            }
+            result = TiffSizeFromHeader(r, len);
             break;
         case ImgFormat::PNG:
             if (len >= 24 && str::StartsWith(data + 12, "IHDR")) {
@@ -561,39 +641,22 @@ Size BitmapSizeFromData(std::span<u8> d) {
             }
             break;
         case ImgFormat::WebP:
-            if (len >= 30 && str::StartsWith(data + 12, "VP8 ")) {
-                result.dx = r.WordLE(26) & 0x3fff;
-                result.dy = r.WordLE(28) & 0x3fff;
-            } else {
+            result = WebpSizeFromHeader(r, len);
+            if (result.IsEmpty()) {
                 result = webp::SizeFromData(d);
             }
             break;
         case ImgFormat::JP2:
-            if (len >= 32) {
-                size_t ix = 0;
-                while (ix < len - 32) {
-                    u32 lbox = r.DWordBE(ix);
-                    u32 tbox = r.DWordBE(ix + 4);
-                    if (0x6A703268 /* jp2h */ == tbox) {
-                        ix += 8;
-                        if (r.DWordBE(ix) == 24 && r.DWordBE(ix + 4) == 0x69686472 /* ihdr */) {
-                            result.dx = r.DWordBE(ix + 16);
-                            result.dy = r.DWordBE(ix + 12);
-                        }
-                        break;
-                    } else if (lbox != 0 && ix < UINT32_MAX - lbox) {
-                        ix += lbox;
-                    } else {
-                        break;
-                    }
-                }
-            }
+            result = Jp2SizeFromHeader(r, len);
             break;
     }
+    return result;
+}
 
+Size BitmapSizeFromData(std::span<u8> d) {
+    Size result = ImageSizeFromHeader(d);
     if (result.IsEmpty()) {
         // let GDI+ extract the image size if we've failed
-        // (currently happens for animated GIF)
         Bitmap* bmp = BitmapFromData(d);
         if (bmp) {
             result = Size(bmp->GetWidth(), bmp->GetHeight());
@@ -35,6 +35,11 @@ void GetBaseTransform(Gdiplus::Matrix& m, Gdiplus::RectF pageRect, float zoom, i
 const WCHAR* GfxFileExtFromData(std::span<u8>);
 bool IsGdiPlusNativeFormat(std::span<u8>);
 Gdiplus::Bitmap* BitmapFromData(std::span<u8>);
+// determines the size of an image from its header without decoding it
+// (the data can be just the first few KB of the image), returns an
+// empty size if that isn't possible
+Size ImageSizeFromHeader(std::span<u8>);
+// same as ImageSizeFromHeader but falls back to decoding the image
 Size BitmapSizeFromData(std::span<u8>);
 CLSID GetEncoderClsid(const WCHAR* format);
 
@@ -0,0 +1,91 @@
+/* Copyright 2020 the SumatraPDF project authors (see AUTHORS file).
+   License: Simplified BSD (see COPYING.BSD) */
+
+#include "utils/BaseUtil.h"
+#include "utils/FindSubstring.h"
+
+// must be last due to assert() over-write
+#include "utils/UtAssert.h"
+
+#define KELVIN_SIGN L"\x212A"
+
+// the SIMD kernels must find the same matches as the scalar loop
+static void FindSubstringCompareKernels(const WCHAR* text, const WCHAR* end, const WCHAR* s, bool caseSensitive) {
+    const WCHAR* found = FindSubstring(text, s, caseSensitive, TextSearchKernel::Scalar);
+    const WCHAR* foundReverse = FindSubstringReverse(text, end, s, caseSensitive, TextSearchKernel::Scalar);
+    TextSearchKernel kernels[] = {TextSearchKernel::SSE2, TextSearchKernel::AVX2};
+    for (TextSearchKernel kernel : kernels) {
+        if (kernel > GetBestTextSearchKernel()) {
+            continue;
+        }
+        utassert(FindSubstring(text, s, caseSensitive, kernel) == found);
+        utassert(FindSubstringReverse(text, end, s, caseSensitive, kernel) == foundReverse);
+    }
+}
+
+// the SIMD kernels read whole 16 (SSE2) resp. 32 (AVX2) byte blocks, so
+// check texts starting and ending at every position within such a block.
+// The code units around the text are matches which must never be found
+static void FindSubstringAlignmentTest(const WCHAR* s, bool caseSensitive) {
+    const WCHAR* variants[] = {L"kb", L"KB", KELVIN_SIGN L"b", L"kc"};
+
+    alignas(32) WCHAR buf[128];
+    for (int start = 0; start < 32; start++) {
+        for (int len = 0; len < 48; len++) {
+            for (int pos = -1; pos < len; pos++) {
+                for (int i = 0; i < (int)dimof(buf); i++) {
+                    buf[i] = i % 2 == 0 ? 'k' : 'b';
+                }
+                WCHAR* text = buf + start;
+                for (int i = 0; i < len; i++) {
+                    text[i] = 'x';
+                }
+                if (pos >= 0) {
+                    const WCHAR* variant = variants[(start + pos) % dimof(variants)];
+                    text[pos] = variant[0];
+                    if (pos + 1 < len) {
+                        text[pos + 1] = variant[1];
+                    }
+                }
+                text[len] = '\0';
+                FindSubstringCompareKernels(text, text + len, s, caseSensitive);
+                // the kernels must also work (and be ignored by AddressSanitizer)
+                // when the text fills a whole allocation
+                AutoFreeWstr copy = str::DupN(text, len);
+                FindSubstringCompareKernels(copy, copy + len, s, caseSensitive);
+                if (pos >= 0) {
+                    // only matches starting before end count
+                    FindSubstringCompareKernels(text, text + pos, s, caseSensitive);
+                    FindSubstringCompareKernels(text, text + pos + 1, s, caseSensitive);
+                }
+            }
+        }
+    }
+}
+
+void FindSubstringTest() {
+    TextSearchKernel kernels[] = {TextSearchKernel::Scalar, TextSearchKernel::SSE2, TextSearchKernel::AVX2};
+    for (TextSearchKernel kernel : kernels) {
+        if (kernel > GetBestTextSearchKernel()) {
+            continue;
+        }
+        const WCHAR* text = L"a " KELVIN_SIGN L"B kb KB";
+        const WCHAR* end = text + str::Len(text);
+        utassert(FindSubstring(text, L"kb", false, kernel) == text + 2);
+        utassert(FindSubstring(text, L"kb", true, kernel) == text + 5);
+        utassert(FindSubstring(text, L"Kb", true, kernel) == nullptr);
+        utassert(FindSubstring(text, L"", false, kernel) == nullptr);
+        utassert(FindSubstringReverse(text, end, L"kb", false, kernel) == text + 8);
+        utassert(FindSubstringReverse(text, end, L"kb", true, kernel) == text + 5);
+        utassert(FindSubstringReverse(text, text + 5, L"kb", false, kernel) == text + 2);
+        utassert(FindSubstringReverse(text, text + 5, L"kb", true, kernel) == nullptr);
+        utassert(FindSubstringReverse(text, text, L"kb", false, kernel) == nullptr);
+    }
+
+    // KELVIN SIGN, 'K' and 'k' all have the lower case 'k'
+    const WCHAR* needles[] = {L"kb", L"KB", KELVIN_SIGN L"B", L"k", L"b"};
+    for (const WCHAR* s : needles) {
+        FindSubstringAlignmentTest(s, false);
+        FindSubstringAlignmentTest(s, true);
+    }
+}